@@ -66,9 +66,19 @@ public:
       return v;
    }
 
+   // message passing runs on the original factors until the tree decomposition begins (see LP_with_trees::ComputePass).
+   // Then factors are split evenly among trees, so that the bundle starts from the current reparametrization with zero multipliers.
    void Begin()
    {
-       LP_with_trees<FMC_TYPE, Lagrangean_factor_FWMAP, LP_tree_FWMAP<FMC_TYPE> >::construct_decomposition();
+       LP<FMC_TYPE>::Begin();
+       if(this->tree_decomposition_begin_arg_.getValue() == 0) {
+           LP_with_trees<FMC_TYPE, Lagrangean_factor_FWMAP, LP_tree_FWMAP<FMC_TYPE> >::construct_decomposition();
+       }
+   }
+
+   void construct_decomposition()
+   {
+       assert(bundle_solver == nullptr);
        bundle_solver = build_up_solver();
    }
 
@@ -19,6 +19,8 @@
 #include <memory>
 #include <iterator>
 #include "two_dimensional_variable_array.hxx"
+#include "packed_mask_array.hxx"
+#include "memory_report.hxx"
 #include "union_find.hxx"
 #include <thread>
 #include <future>
@@ -38,8 +40,8 @@ class MessageIterator;
 
 using weight_array = two_dim_variable_array<REAL>;
 using weight_slice = two_dim_variable_array<REAL>::ArrayAccessObject;
-using receive_array = two_dim_variable_array<unsigned char>;
-using receive_slice = two_dim_variable_array<unsigned char>::ArrayAccessObject;
+using receive_array = packed_mask_array;
+using receive_slice = packed_mask_array::slice;
 
 // pure virtual base class for factor container used by LP class
 class FactorTypeAdapter
@@ -52,6 +54,7 @@ public:
    virtual void update_factor_adaptive(const weight_slice omega, const receive_slice receive_mask) = 0;
    virtual void update_factor_residual(const weight_slice omega, const receive_slice receive_mask) = 0;
    virtual void UpdateFactorPrimal(const weight_slice& omega, const receive_slice& receive_mask, const INDEX iteration) = 0;
+   virtual void prefetch() = 0; // issue prefetches for the data read by the next update
 #ifdef LP_MP_PARALLEL
    virtual void UpdateFactorSynchronized(const weight_slice& omega) = 0;
    virtual void UpdateFactorPrimalSynchronized(const weight_slice& omega, const INDEX iteration) = 0;
@@ -71,6 +74,11 @@ public:
    virtual void propagate_primal_through_messages() = 0;
    virtual bool check_primal_consistency() = 0;
 
+   // for branch and bound: fix factor to current primal (left) or forbid current primal (right)
+   virtual bool can_branch() const = 0;
+   virtual void branch_left() = 0;
+   virtual void branch_right() = 0;
+
    // for use in tree decomposition:
    // for writing primal solution into subgradient
    // return value is size of subgradient
@@ -119,6 +127,10 @@ public:
 
    virtual std::vector<FactorTypeAdapter*> get_adjacent_factors() const = 0;
 
+   // position in the factor list of the LP the factor was added to, set by the LP
+   INDEX factor_index() const { return factor_index_; }
+   void set_factor_index(const INDEX i) { factor_index_ = i; }
+
    struct message_trait {
        FactorTypeAdapter* adjacent_factor;
        Chirality chirality; // is f on the left or on the right
@@ -141,6 +153,9 @@ public:
        }
    };
    virtual std::vector<message_trait> get_messages() const = 0;
+
+private:
+   INDEX factor_index_ = std::numeric_limits<INDEX>::max();
 };
 
 /*
@@ -196,12 +211,53 @@ inline MessageIterator FactorTypeAdapter::end()  { return MessageIterator(this,
 */
 
 
+// message as seen from one of its adjacent factors, entry of the factor adjacency held by the LP
+struct factor_adjacency_entry {
+   INDEX adjacent_factor; // factor index
+   Chirality chirality; // is the factor on the left or on the right
+   bool sends_to_adjacent_factor;
+   bool receives_from_adjacent_factor;
+   bool adjacent_factor_sends;
+   bool adjacent_factor_receives;
+};
+
+inline INDEX adjacent_factor_index(const INDEX i) { return i; }
+inline INDEX adjacent_factor_index(const factor_adjacency_entry& e) { return e.adjacent_factor; }
+
+// distinct neighbors of the frontier nodes for which pred holds, in increasing order.
+// Neighbors are gathered in parallel into slots given by prefix sums of frontier degrees.
+template<typename ADJACENCY_ENTRY, typename PRED>
+std::vector<INDEX> expand_frontier(const two_dim_variable_array<ADJACENCY_ENTRY>& adjacency, const std::vector<INDEX>& frontier, PRED pred)
+{
+  std::vector<INDEX> offsets(frontier.size()+1, 0);
+  for(INDEX k=0; k<frontier.size(); ++k) {
+    offsets[k+1] = offsets[k] + adjacency[frontier[k]].size();
+  }
+
+  std::vector<INDEX> candidates(offsets.back());
+#pragma omp parallel for schedule(guided)
+  for(INDEX k=0; k<frontier.size(); ++k) {
+    const auto neighbors = adjacency[frontier[k]];
+    for(INDEX l=0; l<neighbors.size(); ++l) {
+      const INDEX j = adjacent_factor_index(neighbors[l]);
+      candidates[offsets[k]+l] = pred(j) ? j : std::numeric_limits<INDEX>::max();
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+  if(candidates.size() > 0 && candidates.back() == std::numeric_limits<INDEX>::max()) {
+    candidates.pop_back();
+  }
+  return candidates;
+}
+
 template<typename FMC_TYPE>
 class LP {
    struct message_trait
    {
-       FactorTypeAdapter* left;
-       FactorTypeAdapter* right;
+       INDEX left; // factor indices
+       INDEX right;
        const bool sends_message_to_left, sends_message_to_right, receives_message_from_left, receives_message_from_right;
    };
 
@@ -239,20 +295,35 @@ public:
    {
        auto* f = new FACTOR_CONTAINER_TYPE(args...);
        set_flags_dirty();
-       assert(factor_address_to_index_.size() == f_.size());
-       f_.push_back(f);
-
-       assert(factor_address_to_index_.count(f) == 0);
-       factor_address_to_index_.insert(std::make_pair(f,f_.size()-1));
-       assert(factor_address_to_index_.find(f)->second == f_.size()-1);
-
-       constexpr auto factor_idx = factor_tuple_index<FACTOR_CONTAINER_TYPE>();
-       std::get<factor_idx>(factors_).push_back(f);
+       register_factor(f);
        return f;
    }
 
+   // bulk construction of large models: factors allocated elsewhere, e.g. constructed in parallel, are registered in one batch. The LP takes ownership.
+   template<typename ITERATOR>
+   void add_factors(ITERATOR factor_begin, ITERATOR factor_end)
+   {
+       using FACTOR_CONTAINER_TYPE = typename std::remove_pointer<typename std::iterator_traits<ITERATOR>::value_type>::type;
+       set_flags_dirty();
+       const std::size_t n = std::distance(factor_begin, factor_end);
+       reserve_factors(n);
+       auto& typed_factors = std::get<factor_tuple_index<FACTOR_CONTAINER_TYPE>()>(factors_);
+       typed_factors.reserve(typed_factors.size() + n);
+       for(; factor_begin!=factor_end; ++factor_begin) {
+          register_factor(*factor_begin);
+       }
+   }
+
+   void reserve_factors(const std::size_t n) { f_.reserve(f_.size() + n); }
+
    INDEX GetNumberOfFactors() const { return f_.size(); }
    FactorTypeAdapter* GetFactor(const INDEX i) const { return f_[i]; }
+   INDEX factor_index(const FactorTypeAdapter* f) const
+   {
+      const INDEX i = f->factor_index();
+      assert(i < f_.size() && f_[i] == f);
+      return i;
+   }
 
    template<typename MESSAGE_CONTAINER_TYPE>
    static constexpr std::size_t message_tuple_index()
@@ -266,7 +337,16 @@ public:
    MESSAGE_CONTAINER_TYPE* add_message(LEFT_FACTOR* l, RIGHT_FACTOR* r, ARGS... args)
    {
        set_flags_dirty();
+       auto* m = connect_message<MESSAGE_CONTAINER_TYPE>(l, r, args...);
+       register_message(m);
+       return m;
+   }
 
+   // create message in its adjacent factors without registering it in the LP.
+   // Only the two adjacent factors are modified, hence messages with pairwise distinct adjacent factors can be connected concurrently. They must be registered afterwards with add_messages.
+   template<typename MESSAGE_CONTAINER_TYPE, typename LEFT_FACTOR, typename RIGHT_FACTOR, typename... ARGS>
+   MESSAGE_CONTAINER_TYPE* connect_message(LEFT_FACTOR* l, RIGHT_FACTOR* r, ARGS... args)
+   {
        auto* m_l = l->template add_message<MESSAGE_CONTAINER_TYPE,Chirality::left>(r,args...);
        auto* m_r = r->template add_message<MESSAGE_CONTAINER_TYPE,Chirality::right>(l,args...);
        assert(m_l != nullptr || m_r != nullptr);
@@ -276,17 +356,56 @@ public:
 
        auto* m = (m_l != nullptr ? m_l : m_r);
        assert(m != nullptr && (m == m_l || m == m_r));
-       m_.push_back({l,r, m->SendsMessageToLeft(), m->SendsMessageToRight(), m->ReceivesMessageFromLeft(), m->ReceivesMessageFromRight()});
-
-       constexpr auto msg_idx = message_tuple_index<MESSAGE_CONTAINER_TYPE>();
-       std::get<msg_idx>(messages_).push_back(m);
        return m;
    }
+
+   // register messages created by connect_message in one batch
+   template<typename ITERATOR>
+   void add_messages(ITERATOR msg_begin, ITERATOR msg_end)
+   {
+       using MESSAGE_CONTAINER_TYPE = typename std::remove_pointer<typename std::iterator_traits<ITERATOR>::value_type>::type;
+       set_flags_dirty();
+       const std::size_t n = std::distance(msg_begin, msg_end);
+       reserve_messages(n);
+       auto& typed_messages = std::get<message_tuple_index<MESSAGE_CONTAINER_TYPE>()>(messages_);
+       typed_messages.reserve(typed_messages.size() + n);
+       for(; msg_begin!=msg_end; ++msg_begin) {
+          register_message(*msg_begin);
+       }
+   }
+
+   void reserve_messages(const std::size_t n) { m_.reserve(m_.size() + n); }
    //virtual INDEX AddMessage(MessageTypeAdapter* m);
    message_trait GetMessage(const INDEX i) const { return m_[i]; }
+
+   // factors adjacent via messages, in compressed sparse row format indexed by factor index.
+   // Entries of a factor are in the order of its get_messages(), hence position k among the sending (receiving) entries is slot k of its omega (receive mask).
+   // Built on first use and invalidated by set_flags_dirty.
+   const two_dim_variable_array<factor_adjacency_entry>& get_factor_adjacency();
+   // factors that are locally non-optimal or violate a message, fattened by their neighbors up to the given distance
+   std::vector<bool> get_inconsistent_mask(const std::size_t no_fatten_rounds = 1);
    INDEX GetNumberOfMessages() const { return m_.size(); }
 
+   // call func on typed pointers of all factors resp. messages, grouped by their type
+   template<typename FUNC>
+   void for_each_factor(FUNC&& func) const
+   {
+      for_each_tuple(factors_, [&func](auto& v) {
+            for(auto* f : v) { func(f); }
+      });
+   }
+
+   template<typename FUNC>
+   void for_each_message(FUNC&& func) const
+   {
+      for_each_tuple(messages_, [&func](auto& v) {
+            for(auto* m : v) { func(m); }
+      });
+   }
+
    void AddFactorRelation(FactorTypeAdapter* f1, FactorTypeAdapter* f2); // indicate that factor f1 comes before factor f2
+   template<typename ITERATOR>
+   void AddFactorRelations(ITERATOR relation_begin, ITERATOR relation_end); // pairs (f1,f2), f1 comes before f2
    void ForwardPassFactorRelation(FactorTypeAdapter* f1, FactorTypeAdapter* f2);
    void BackwardPassFactorRelation(FactorTypeAdapter* f1, FactorTypeAdapter* f2);
 
@@ -335,7 +454,7 @@ public:
    void ComputeAnisotropicWeights(FACTOR_ITERATOR factorIt, FACTOR_ITERATOR factorItEnd, weight_array& omega, receive_array& receive_mask); 
 
    template<typename FACTOR_ITERATOR>
-   std::unordered_map<FactorTypeAdapter*,std::size_t> get_factor_indices(FACTOR_ITERATOR f_begin, FACTOR_ITERATOR f_end);
+   std::vector<std::size_t> get_factor_indices(FACTOR_ITERATOR f_begin, FACTOR_ITERATOR f_end); // position in given range for each factor, max for factors not in range
 
    template<typename ITERATOR>
    weight_array allocate_omega(ITERATOR factor_begin, ITERATOR factor_end);
@@ -378,6 +497,22 @@ public:
 
    template<typename FACTOR_ITERATOR, typename OMEGA_ITERATOR, typename RECEIVE_MASK_ITERATOR>
    void ComputePass(FACTOR_ITERATOR factorIt, const FACTOR_ITERATOR factorItEnd, OMEGA_ITERATOR omegaIt, RECEIVE_MASK_ITERATOR receive_it);
+   template<typename FACTOR_ITERATOR>
+   void prefetch_ahead(FACTOR_ITERATOR factorIt, const INDEX i, const INDEX n) const;
+
+   // factors of the update ordering grouped into batches that are processed one after another, the factors of one batch concurrently.
+   // No two factors of a batch are equal or adjacent to a common factor. Conflicting factors are put into batches in the order of the update ordering, hence a wavefront pass computes the same as a sequential one.
+   // Batches are the levels of the DAG of conflicts between factors directed along the update ordering, not those of the factor relation DAG: relations between factors not in conflict,
+   // e.g. the chain of unary factors added by the MRF constructors, would otherwise make every level O(1) wide. For a grid MRF the batches are its anti-diagonals.
+   struct wavefront_schedule {
+      std::vector<INDEX> update_position; // positions in update ordering, grouped by batch
+      std::vector<INDEX> batch_offsets;
+      bool sequential = false; // batches are too small on average to gain from processing them concurrently, the sequential pass is used instead
+   };
+   wavefront_schedule compute_wavefront_schedule(const std::vector<FactorTypeAdapter*>& update_ordering);
+   void compute_wavefront_schedule();
+   const wavefront_schedule& get_wavefront_schedule(const Direction dir) const { assert(wavefront_valid_); return dir == Direction::forward ? wavefront_forward_ : wavefront_backward_; }
+   void ComputeWavefrontPass(const std::vector<FactorTypeAdapter*>& update_ordering, const wavefront_schedule& schedule, weight_array& omega, receive_array& receive_mask);
 
 #ifdef LP_MP_PARALLEL
    template<typename FACTOR_ITERATOR, typename OMEGA_ITERATOR, typename SYNCHRONIZATION_ITERATOR>
@@ -412,7 +547,10 @@ public:
 #ifdef LP_MP_PARALLEL
       compute_synchronization();
 #endif 
-      if(repamMode_ != LPReparametrizationMode::Anisotropic) {
+      if(compact_memory_) {
+         release_unused_omega();
+      }
+      if(repamMode_ != LPReparametrizationMode::Anisotropic && repamMode_ != LPReparametrizationMode::Anisotropic2) {
           if(!full_receive_mask_valid_) {
               compute_full_receive_mask();
               full_receive_mask_valid_ = true;
@@ -454,6 +592,42 @@ public:
       }
    }
 
+   // bytes held by factors and messages per type, weights and receive masks, and the data structures determining the order of updates
+   memory_report get_memory_report();
+
+   // In compact memory mode weights and receive masks of reparametrization modes other than the current one are freed instead of kept for later use.
+   // Chosen by the visitor when memory use is near the limit given by --maxMemory.
+   void set_compact_memory(const bool compact) { compact_memory_ = compact; }
+   bool compact_memory() const { return compact_memory_; }
+
+   // free weights and receive masks of modes other than the current one, they are recomputed when the mode is switched back
+   void release_unused_omega()
+   {
+      auto release = [](bool& valid, auto&... arrays) {
+         valid = false;
+         ((arrays = std::remove_reference_t<decltype(arrays)>()), ...);
+      };
+      const auto mode = repamMode_;
+      if(mode != LPReparametrizationMode::Anisotropic && omega_anisotropic_valid_) {
+         release(omega_anisotropic_valid_, omegaForwardAnisotropic_, omegaBackwardAnisotropic_, anisotropic_receive_mask_forward_, anisotropic_receive_mask_backward_);
+      }
+      if(mode != LPReparametrizationMode::Anisotropic2 && omega_anisotropic2_valid_) {
+         release(omega_anisotropic2_valid_, omegaForwardAnisotropic2_, omegaBackwardAnisotropic2_, receive_mask_anisotropic2_forward_, receive_mask_anisotropic2_backward_);
+      }
+      if(mode != LPReparametrizationMode::Uniform && omega_isotropic_valid_) {
+         release(omega_isotropic_valid_, omegaForwardIsotropic_, omegaBackwardIsotropic_);
+      }
+      if(mode != LPReparametrizationMode::DampedUniform && omega_isotropic_damped_valid_) {
+         release(omega_isotropic_damped_valid_, omegaForwardIsotropicDamped_, omegaBackwardIsotropicDamped_);
+      }
+      if(mode != LPReparametrizationMode::Mixed && omega_mixed_valid_) {
+         release(omega_mixed_valid_, omegaForwardMixed_, omegaBackwardMixed_);
+      }
+      if((mode == LPReparametrizationMode::Anisotropic || mode == LPReparametrizationMode::Anisotropic2) && full_receive_mask_valid_) {
+         release(full_receive_mask_valid_, full_receive_mask_forward_, full_receive_mask_backward_);
+      }
+   }
+
    void add_to_constant(const REAL x) { constant_ += x; }
 
    // methods for staged optimization
@@ -470,6 +644,25 @@ public:
    void compute_overlapping_partition_pass(const std::size_t no_passes);
 
 protected:
+   template<typename FACTOR_CONTAINER_TYPE>
+   void register_factor(FACTOR_CONTAINER_TYPE* f)
+   {
+       assert(f->factor_index() == std::numeric_limits<INDEX>::max()); // not yet added to an LP
+       f->set_factor_index(f_.size());
+       f_.push_back(f);
+
+       constexpr auto factor_idx = factor_tuple_index<FACTOR_CONTAINER_TYPE>();
+       std::get<factor_idx>(factors_).push_back(f);
+   }
+
+   template<typename MESSAGE_CONTAINER_TYPE>
+   void register_message(MESSAGE_CONTAINER_TYPE* m)
+   {
+       m_.push_back({factor_index(m->GetLeftFactor()), factor_index(m->GetRightFactor()), m->SendsMessageToLeft(), m->SendsMessageToRight(), m->ReceivesMessageFromLeft(), m->ReceivesMessageFromRight()});
+
+       constexpr auto msg_idx = message_tuple_index<MESSAGE_CONTAINER_TYPE>();
+       std::get<msg_idx>(messages_).push_back(m);
+   }
 
    // do zrobienia: possibly hold factors and messages in shared_ptr?
    std::vector<FactorTypeAdapter*> f_; // note that here the factors are stored in the original order they were given. They will be output in this order as well, e.g. by problemDecomposition
@@ -510,11 +703,11 @@ protected:
 
    bool full_receive_mask_valid_ = false;
    receive_array full_receive_mask_forward_, full_receive_mask_backward_;
+   bool compact_memory_ = false;
 
    std::vector<std::pair<FactorTypeAdapter*, FactorTypeAdapter*> > forward_pass_factor_rel_, backward_pass_factor_rel_; // factor ordering relations. First factor must come before second factor. factorRel_ must describe a DAG
 
    
-   std::unordered_map<FactorTypeAdapter*,INDEX> factor_address_to_index_;
    std::vector<INDEX> f_forward_sorted_, f_backward_sorted_; // sorted indices in factor vector f_ 
 
    LPReparametrizationMode repamMode_ = LPReparametrizationMode::Undefined;
@@ -523,6 +716,13 @@ protected:
    TCLAP::ValueArg<INDEX> inner_iteration_number_arg_;
    enum class reparametrization_type {shared,residual,partition,overlapping_partition,adaptive};
    reparametrization_type reparametrization_type_;
+   TCLAP::ValueArg<std::string> pass_schedule_arg_; // sequential|wavefront
+   enum class pass_schedule {sequential,wavefront};
+   pass_schedule pass_schedule_ = pass_schedule::sequential;
+   TCLAP::ValueArg<INDEX> prefetch_distance_arg_;
+   INDEX prefetch_distance_ = 0; // 0 disables prefetching
+   bool wavefront_valid_ = false;
+   wavefront_schedule wavefront_forward_, wavefront_backward_;
 #ifdef LP_MP_PARALLEL
    TCLAP::ValueArg<INDEX> num_lp_threads_arg_;
    bool synchronization_valid_ = false;
@@ -544,7 +744,9 @@ protected:
    }
 #endif
 
-   std::vector<bool> get_inconsistent_mask(const std::size_t no_fatten_rounds = 1);
+   bool factor_adjacency_valid_ = false;
+   two_dim_variable_array<factor_adjacency_entry> factor_adjacency_;
+
    template<typename FACTOR_ITERATOR, typename FACTOR_MASK_ITERATOR>
    std::vector<FactorTypeAdapter*> get_masked_factors( FACTOR_ITERATOR factor_begin, FACTOR_ITERATOR factor_end, FACTOR_MASK_ITERATOR factor_mask_begin, FACTOR_MASK_ITERATOR factor_mask_end);
    void reduce_optimization_factors();
@@ -583,6 +785,8 @@ template<typename FMC>
 LP<FMC>::LP(TCLAP::CmdLine& cmd)
 : reparametrization_type_arg_("","reparametrizationType","message sending type: ", false, "shared", "{shared|residual|partition|overlapping_partition|adaptive}", cmd)
 , inner_iteration_number_arg_("","innerIteration","number of iterations in inner loop in partition reparamtrization, default = 5",false,5,&positiveIntegerConstraint,cmd) 
+, pass_schedule_arg_("","passSchedule","order of factor updates in a pass: sequential, or in batches of factors not adjacent to a common factor with each batch processed in parallel", false, "sequential", "{sequential|wavefront}", cmd)
+, prefetch_distance_arg_("","prefetchDistance","number of factors ahead of the current one whose data is prefetched in a sequential pass, 0 disables prefetching, default = 2",false,2,"integer",cmd)
 #ifdef LP_MP_PARALLEL
 , num_lp_threads_arg_("","numLpThreads","number of threads for message passing, default = 1",false,1,&positiveIntegerConstraint,cmd)
 #endif
@@ -599,6 +803,8 @@ template<typename FMC>
 LP<FMC>::LP(LP& o) // no const because of o.num_lp_threads_arg_.getValue() not being const!
   : reparametrization_type_arg_("","reparametrizationType","message sending type: ", false, o.reparametrization_type_arg_.getValue(), "{shared|residual|partition|overlapping_partition|adaptive}" )
 , inner_iteration_number_arg_("","innerIteration","number of iterations in inner loop in partition reparamtrization, default = 5",false,o.inner_iteration_number_arg_.getValue(),&positiveIntegerConstraint) 
+, pass_schedule_arg_("","passSchedule","order of factor updates in a pass: sequential, or in batches of factors not adjacent to a common factor with each batch processed in parallel", false, o.pass_schedule_arg_.getValue(), "{sequential|wavefront}")
+, prefetch_distance_arg_("","prefetchDistance","number of factors ahead of the current one whose data is prefetched in a sequential pass, 0 disables prefetching, default = 2",false,o.prefetch_distance_arg_.getValue(),"integer")
 #ifdef LP_MP_PARALLEL
     , num_lp_threads_arg_("","numLpThreads","number of threads for message passing, default = 1",false,o.num_lp_threads_arg_.getValue(),&positiveIntegerConstraint)
 #endif
@@ -614,12 +820,8 @@ LP<FMC>::LP(LP& o) // no const because of o.num_lp_threads_arg_.getValue() not b
     factor_map.insert(std::make_pair(f, clone));
   }
   m_.reserve(o.m_.size());
-  for(auto m : o.m_) {
-    auto* left = m.left;
-    auto* right = m.right;
-    auto* left_clone = factor_map[left];
-    auto* right_clone = factor_map[right];
-    m_.push_back({left_clone, right_clone, m.sends_message_to_left, m.sends_message_to_right, m.receives_message_from_left, m.receives_message_from_right});
+  for(auto m : o.m_) { // factor indices stay the same
+    m_.push_back(m);
   }
 
   ordering_valid_ = o.ordering_valid_;
@@ -696,6 +898,23 @@ void LP<FMC>::AddFactorRelation(FactorTypeAdapter* f1, FactorTypeAdapter* f2)
   BackwardPassFactorRelation(f2,f1);
 }
 
+template<typename FMC>
+template<typename ITERATOR>
+void LP<FMC>::AddFactorRelations(ITERATOR relation_begin, ITERATOR relation_end)
+{
+  set_flags_dirty();
+  const std::size_t n = std::distance(relation_begin, relation_end);
+  forward_pass_factor_rel_.reserve(forward_pass_factor_rel_.size() + n);
+  backward_pass_factor_rel_.reserve(backward_pass_factor_rel_.size() + n);
+  for(; relation_begin!=relation_end; ++relation_begin) {
+    FactorTypeAdapter* f1 = std::get<0>(*relation_begin);
+    FactorTypeAdapter* f2 = std::get<1>(*relation_begin);
+    assert(f1 != f2);
+    forward_pass_factor_rel_.push_back({f1,f2});
+    backward_pass_factor_rel_.push_back({f2,f1});
+  }
+}
+
 template<typename FMC>
 inline void LP<FMC>::Begin()
 {
@@ -716,6 +935,15 @@ inline void LP<FMC>::Begin()
      assert(false);
    }
 
+   if(pass_schedule_arg_.getValue() == "sequential") {
+     pass_schedule_ = pass_schedule::sequential;
+   } else if(pass_schedule_arg_.getValue() == "wavefront") {
+     pass_schedule_ = pass_schedule::wavefront;
+   } else {
+     throw std::runtime_error("pass schedule must be sequential or wavefront");
+   }
+   prefetch_distance_ = prefetch_distance_arg_.getValue();
+
 #ifdef LP_MP_PARALLEL
    omp_set_num_threads(num_lp_threads_arg_.getValue());
    if(debug()) { std::cout << "number of threads = " << num_lp_threads_arg_.getValue() << "\n"; }
@@ -732,22 +960,19 @@ void LP<FMC>::SortFactors(
 {
   // assume that factorRel_ describe a DAG. Compute topological sorting
   Topological_Sort::Graph g(f_.size());
+  g.reserve_edges(factor_rel.size());
 
   //std::map<FactorTypeAdapter*,INDEX> factorToIndex; // possibly do it with a hash_map for speed
   //std::map<INDEX,FactorTypeAdapter*> indexToFactor; // do zrobienia: need not be map, oculd be vector!
   //BuildIndexMaps(f_.begin(), f_.end(),factorToIndex,indexToFactor);
 
   for(auto fRelIt=factor_rel.begin(); fRelIt!=factor_rel.end(); fRelIt++) {
-    // do zrobienia: why do these asserts fail?
-    assert(factor_address_to_index_.find(fRelIt->first ) != factor_address_to_index_.end());
-    assert(factor_address_to_index_.find(fRelIt->second) != factor_address_to_index_.end());
-    INDEX f1 = factor_address_to_index_[fRelIt->first];
-    INDEX f2 = factor_address_to_index_[fRelIt->second];
+    INDEX f1 = factor_index(fRelIt->first);
+    INDEX f2 = factor_index(fRelIt->second);
     g.addEdge(f1,f2);
   }
 
   f_sorted = g.topologicalSort();
-  //std::vector<INDEX> sortedIndices = g.topologicalSort();
   assert(f_sorted.size() == f_.size());
 
   std::vector<FactorTypeAdapter*> fSorted;
@@ -782,13 +1007,9 @@ void LP<FMC>::SortFactors()
   if(ordering_valid_) { return; }
   ordering_valid_ = true;
 
-#pragma omp parallel sections
-  {
-#pragma omp section
-    SortFactors(forward_pass_factor_rel_, forwardOrdering_, forwardUpdateOrdering_, f_forward_sorted_);
-#pragma omp section
-    SortFactors(backward_pass_factor_rel_, backwardOrdering_, backwardUpdateOrdering_, f_backward_sorted_);
-  }
+  // one after the other, so that each topological sort can use all threads for its levels instead of running in a nested parallel region
+  SortFactors(forward_pass_factor_rel_, forwardOrdering_, forwardUpdateOrdering_, f_forward_sorted_);
+  SortFactors(backward_pass_factor_rel_, backwardOrdering_, backwardUpdateOrdering_, f_backward_sorted_);
 }
 
 
@@ -812,20 +1033,19 @@ inline std::vector<bool> LP<FMC>::compute_synchronization(ITERATOR factor_begin,
     const int finish = ((ithread+1)*n)/nthreads;
 
     for(INDEX i=start; i<finish; ++i) {
-      const INDEX factor_number = factor_address_to_index_[*(factor_begin+i)];
+      const INDEX factor_number = factor_index(*(factor_begin+i));
       thread_number[factor_number] = ithread;
     }
   }
 
   // check for every factor all its neighbors and see whether more than two possible threads access it.
-  std::vector<bool> conflict_factor(this->f_.size(), false);
+  const auto& adjacency = get_factor_adjacency();
+  std::vector<char> conflict_factor(this->f_.size(), false); // char instead of bool, so that threads can write distinct entries concurrently
 #pragma omp parallel for
   for(INDEX i=0; i<this->f_.size(); ++i) {
-    auto *f = f_[i];
     INDEX prev_adjacent_thread_number = thread_number[i];
-    for(auto m_it=f->begin(); m_it!=f->end(); ++m_it) {
-      const INDEX adjacent_factor_number = factor_address_to_index_[m_it.GetConnectedFactor()];
-      const INDEX adjacent_thread_number = thread_number[adjacent_factor_number];
+    for(const auto& a : adjacency[i]) {
+      const INDEX adjacent_thread_number = thread_number[a.adjacent_factor];
       if(adjacent_thread_number != std::numeric_limits<INDEX>::max()) {
         if(prev_adjacent_thread_number != std::numeric_limits<INDEX>::max() && adjacent_thread_number != prev_adjacent_thread_number) {
           conflict_factor[i] = true;
@@ -837,14 +1057,12 @@ inline std::vector<bool> LP<FMC>::compute_synchronization(ITERATOR factor_begin,
   std::cout << "# conflict factors = " << std::count(conflict_factor.begin(), conflict_factor.end(), true) << "\n";
 
   // if a factor is adjacent to a conflict factor or is itself one, then it needs to be synchronized
-  std::vector<bool> synchronize(n);
+  std::vector<char> synchronize(n, false);
 #pragma omp parallel for
   for(INDEX i=0; i<n; ++i) {
-    auto* f = *(factor_begin+i);
-    const INDEX factor_number = factor_address_to_index_[f];
-    for(auto m_it=f->begin(); m_it!=f->end(); ++m_it) {
-      const INDEX adjacent_factor_number = factor_address_to_index_[m_it.GetConnectedFactor()];
-      if(conflict_factor[adjacent_factor_number]) {
+    const INDEX factor_number = factor_index(*(factor_begin+i));
+    for(const auto& a : adjacency[factor_number]) {
+      if(conflict_factor[a.adjacent_factor]) {
         synchronize[i] = true;
       }
     }
@@ -857,7 +1075,7 @@ inline std::vector<bool> LP<FMC>::compute_synchronization(ITERATOR factor_begin,
     std::cout << std::count(synchronize.begin(), synchronize.end(), true) << ";" << synchronize.size() << "\n";
     std::cout << "\%factors to synchronize = " << REAL(std::count(synchronize.begin(), synchronize.end(), true)) / REAL(synchronize.size()) << "\n";
   }
-  return std::move(synchronize);
+  return std::vector<bool>(synchronize.begin(), synchronize.end());
 }
 #endif
 
@@ -887,6 +1105,13 @@ void LP<FMC>::ComputeForwardPass()
   const auto omega = get_omega();
   assert(omega.forward.size() == omega.receive_mask_forward.size());
   assert(omega.backward.size() == omega.receive_mask_backward.size());
+  if(pass_schedule_ == pass_schedule::wavefront) {
+    compute_wavefront_schedule();
+    if(!wavefront_forward_.sequential) {
+      ComputeWavefrontPass(forwardUpdateOrdering_, wavefront_forward_, omega.forward, omega.receive_mask_forward);
+      return;
+    }
+  }
 #ifdef LP_MP_PARALLEL
   ComputePassSynchronized(forwardUpdateOrdering_.begin(), forwardUpdateOrdering_.end(), omega.forward.begin(), omega.forward.end(), synchronize_forward_.begin(), synchronize_forward_.end()); 
 #else
@@ -898,6 +1123,13 @@ template<typename FMC>
 void LP<FMC>::ComputeBackwardPass()
 {
   const auto omega = get_omega();
+  if(pass_schedule_ == pass_schedule::wavefront) {
+    compute_wavefront_schedule();
+    if(!wavefront_backward_.sequential) {
+      ComputeWavefrontPass(backwardUpdateOrdering_, wavefront_backward_, omega.backward, omega.receive_mask_backward);
+      return;
+    }
+  }
 #ifdef LP_MP_PARALLEL
   ComputePassSynchronized(backwardUpdateOrdering_.begin(), backwardUpdateOrdering_.end(), omega.backward.begin(), omega.backward.end(), synchronize_backward_.begin(), synchronize_backward_.end()); 
 #else
@@ -980,25 +1212,114 @@ void LP<FMC>::ComputePass(FACTOR_ITERATOR factorIt, const FACTOR_ITERATOR factor
     //assert(std::distance(factorItEnd, factorIt) == std::distance(omegaIt, omegaItEnd));
     const INDEX n = std::distance(factorIt, factorItEnd);
     //#pragma omp parallel for schedule(static)
-    if(reparametrization_type_ == reparametrization_type::shared || reparametrization_type_ == reparametrization_type::partition || reparametrization_type_ == reparametrization_type::overlapping_partition) {
+    auto pass = [&](auto update) {
         for(INDEX i=0; i<n; ++i) {
+            prefetch_ahead(factorIt, i, n);
             auto* f = *(factorIt + i);
-            f->UpdateFactor(*(omegaIt + i), *(receive_it + i));
+            update(f, *(omegaIt + i), *(receive_it + i));
         }
+    };
+    if(reparametrization_type_ == reparametrization_type::shared || reparametrization_type_ == reparametrization_type::partition || reparametrization_type_ == reparametrization_type::overlapping_partition) {
+        pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->UpdateFactor(o, r); });
     } else if(reparametrization_type_ == reparametrization_type::residual) {
-        for(INDEX i=0; i<n; ++i) {
-            auto* f = *(factorIt + i);
-            f->update_factor_residual(*(omegaIt + i), *(receive_it + i));
-        }
+        pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->update_factor_residual(o, r); });
     } else {
         assert(reparametrization_type_ == reparametrization_type::adaptive);
-        for(INDEX i=0; i<n; ++i) {
-            auto* f = *(factorIt + i);
-            f->update_factor_adaptive(*(omegaIt + i), *(receive_it + i));
-        }
+        pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->update_factor_adaptive(o, r); });
     }
 }
 
+// Two stage software prefetching with distance d: the container of factor i+2d is fetched first, so that its prefetch method, which reads the container, can be called at factor i+d.
+template<typename FMC>
+template<typename FACTOR_ITERATOR>
+void LP<FMC>::prefetch_ahead(FACTOR_ITERATOR factorIt, const INDEX i, const INDEX n) const
+{
+    const INDEX d = prefetch_distance_;
+    if(d == 0) { return; }
+    if(i + 2*d < n) { simdpp::prefetch_read(*(factorIt + i + 2*d)); }
+    if(i + d < n) { (*(factorIt + i + d))->prefetch(); }
+}
+
+template<typename FMC>
+typename LP<FMC>::wavefront_schedule LP<FMC>::compute_wavefront_schedule(const std::vector<FactorTypeAdapter*>& update_ordering)
+{
+  const auto& adjacency = get_factor_adjacency();
+  const INDEX n = update_ordering.size();
+
+  // a factor comes into the batch after the last one updating it or one of its neighbors
+  std::vector<INDEX> touched_batch(f_.size(), 0); // one more than the last batch updating a factor or one of its neighbors, 0 if there is none
+  std::vector<INDEX> batch(n);
+  INDEX no_batches = 0;
+  for(INDEX k=0; k<n; ++k) {
+    const INDEX i = factor_index(update_ordering[k]);
+    INDEX b = touched_batch[i];
+    for(const auto& a : adjacency[i]) { b = std::max(b, touched_batch[a.adjacent_factor]); }
+    touched_batch[i] = b+1;
+    for(const auto& a : adjacency[i]) { touched_batch[a.adjacent_factor] = b+1; }
+    batch[k] = b;
+    no_batches = std::max(no_batches, b+1);
+  }
+
+  // stable counting sort by batch
+  wavefront_schedule schedule;
+  schedule.batch_offsets.assign(no_batches+1, 0);
+  for(const INDEX b : batch) { schedule.batch_offsets[b+1]++; }
+  std::partial_sum(schedule.batch_offsets.begin(), schedule.batch_offsets.end(), schedule.batch_offsets.begin());
+  std::vector<INDEX> pos(schedule.batch_offsets.begin(), schedule.batch_offsets.end()-1);
+  schedule.update_position.resize(n);
+  for(INDEX k=0; k<n; ++k) {
+    schedule.update_position[ pos[batch[k]]++ ] = k;
+  }
+  assert(schedule.batch_offsets.back() == n);
+
+  // each batch ends with a barrier, which costs more than the concurrent updates gain for batches of a few factors
+  constexpr INDEX min_average_batch_size = 4;
+  schedule.sequential = std::size_t(no_batches) * min_average_batch_size > n;
+  if(schedule.sequential) {
+    std::cout << "wavefront schedule has " << no_batches << " batches for " << n << " factors, using sequential pass instead\n";
+  }
+  if(debug()) {
+    std::cout << "wavefront schedule: " << no_batches << " batches for " << n << " factors\n";
+  }
+  return schedule;
+}
+
+template<typename FMC>
+void LP<FMC>::compute_wavefront_schedule()
+{
+  assert(ordering_valid_);
+  if(wavefront_valid_) { return; }
+  wavefront_valid_ = true;
+  wavefront_forward_ = compute_wavefront_schedule(forwardUpdateOrdering_);
+  wavefront_backward_ = compute_wavefront_schedule(backwardUpdateOrdering_);
+}
+
+template<typename FMC>
+void LP<FMC>::ComputeWavefrontPass(const std::vector<FactorTypeAdapter*>& update_ordering, const wavefront_schedule& schedule, weight_array& omega, receive_array& receive_mask)
+{
+  assert(omega.size() == update_ordering.size() && receive_mask.size() == update_ordering.size());
+  // batches are separated by the barrier at the end of each worksharing loop
+  auto pass = [&](auto update) {
+#pragma omp parallel
+    for(INDEX b=0; b+1<schedule.batch_offsets.size(); ++b) {
+#pragma omp for schedule(static)
+      for(INDEX k=schedule.batch_offsets[b]; k<schedule.batch_offsets[b+1]; ++k) {
+        const INDEX i = schedule.update_position[k];
+        update(update_ordering[i], omega[i], receive_mask[i]);
+      }
+    }
+  };
+
+  if(reparametrization_type_ == reparametrization_type::shared || reparametrization_type_ == reparametrization_type::partition || reparametrization_type_ == reparametrization_type::overlapping_partition) {
+    pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->UpdateFactor(o, r); });
+  } else if(reparametrization_type_ == reparametrization_type::residual) {
+    pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->update_factor_residual(o, r); });
+  } else {
+    assert(reparametrization_type_ == reparametrization_type::adaptive);
+    pass([](FactorTypeAdapter* f, const weight_slice o, const receive_slice r) { f->update_factor_adaptive(o, r); });
+  }
+}
+
 template<typename FMC>
 bool LP<FMC>::omega_valid(const weight_array& omega) const
 {
@@ -1094,12 +1415,8 @@ void LP<FMC>::ComputeAnisotropicWeights2(
 
    std::vector<INDEX> no_send_messages_later(f_.size(), 0);
    for(INDEX i=0; i<m_.size(); ++i) {
-      auto* f_left = m_[i].left;
-      const INDEX f_index_left = factor_address_to_index_[f_left];
-      const INDEX index_left = f_sorted_inverse[f_index_left];
-      auto* f_right = m_[i].right;
-      const INDEX f_index_right = factor_address_to_index_[f_right];
-      const INDEX index_right = f_sorted_inverse[f_index_right];
+      const INDEX index_left = f_sorted_inverse[m_[i].left];
+      const INDEX index_right = f_sorted_inverse[m_[i].right];
       
       if(m_[i].sends_message_to_right && index_left < index_right) {
         no_send_messages_later[index_left]++;
@@ -1111,19 +1428,18 @@ void LP<FMC>::ComputeAnisotropicWeights2(
 
    omega = allocate_omega(factorIt, factorEndIt);
    receive_mask = allocate_receive_mask(factorIt, factorEndIt);
+   const auto& adjacency = get_factor_adjacency();
 
    {
       INDEX c=0;
       for(auto it=factorIt; it!=factorEndIt; ++it) {
          const INDEX i = std::distance(factorIt, it);
-         assert(i == f_sorted_inverse[ factor_address_to_index_[*it] ]);
+         assert(i == f_sorted_inverse[ factor_index(*it) ]);
          if((*it)->FactorUpdated()) {
             std::size_t k_send=0;
             std::size_t k_receive=0;
-            auto msgs = (*it)->get_messages();
-            for(auto msg_it : msgs) {
-                auto* f_connected = msg_it.adjacent_factor;
-                const INDEX j = f_sorted_inverse[ factor_address_to_index_[f_connected] ];
+            for(const auto& msg_it : adjacency[factor_index(*it)]) {
+                const INDEX j = f_sorted_inverse[ msg_it.adjacent_factor ];
                 if(msg_it.sends_to_adjacent_factor) {
                     assert(i != j);
                     if(i<j) {
@@ -1135,9 +1451,7 @@ void LP<FMC>::ComputeAnisotropicWeights2(
                 }
                 if(msg_it.receives_from_adjacent_factor) {
                     if(j<i) {
-                        receive_mask[c][k_receive] = 1;
-                    } else {
-                        receive_mask[c][k_receive] = 0;
+                        receive_mask.set(c, k_receive);
                     }
                     ++k_receive;
                }
@@ -1150,25 +1464,13 @@ void LP<FMC>::ComputeAnisotropicWeights2(
 
 template<typename FMC>
 template<typename FACTOR_ITERATOR>
-std::unordered_map<FactorTypeAdapter*, std::size_t> LP<FMC>::get_factor_indices(FACTOR_ITERATOR f_begin, FACTOR_ITERATOR f_end)
+std::vector<std::size_t> LP<FMC>::get_factor_indices(FACTOR_ITERATOR f_begin, FACTOR_ITERATOR f_end)
 {
-    std::unordered_map<FactorTypeAdapter*, std::size_t> indices;
-    indices.reserve( std::distance(f_begin, f_end) );
+    std::vector<std::size_t> indices(f_.size(), std::numeric_limits<std::size_t>::max());
     std::size_t i=0;
     for(auto f_it=f_begin; f_it!=f_end; ++f_it, ++i) {
-        indices.insert( {*f_it, i} );
+        indices[factor_index(*f_it)] = i;
     }
-
-/*
-    for(auto f_it=f_begin; f_it!=f_end; ++f_it, ++i) {
-        auto connected_factors = f->get_adjacent_factors();
-        for(auto* f : connected_factors()) {
-            if(indices.find(f) == indices.end()) {
-                indices.insert( {f, std::numeric_limits<std::size_t>::max()} );
-            } 
-        }
-    }
-    */
     return indices;
 }
 
@@ -1229,7 +1531,10 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
    const auto n = std::distance(factorIt,factorEndIt);
    assert(n <= f_.size());
 
-   auto factor_address_to_sorted_index = get_factor_indices(factorIt, factorEndIt); 
+   const auto factor_to_sorted_index = get_factor_indices(factorIt, factorEndIt); 
+   constexpr std::size_t not_iterated = std::numeric_limits<std::size_t>::max();
+   auto sorted_index = [&](const INDEX i) { return factor_to_sorted_index[i]; };
+   const auto& adjacency = get_factor_adjacency();
 
    // compute the following numbers: 
    // 1) #{factors after current one, to which messages are sent from current factor}
@@ -1240,12 +1545,11 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
 
 
    for(auto f_it=factorIt; f_it!=factorEndIt; ++f_it) {
-       assert(factor_address_to_sorted_index.count(*f_it) > 0);
-       const auto f_index = factor_address_to_sorted_index[*f_it];
-       const auto messages = (*f_it)->get_messages();
-       for(const auto m : messages) {
-           if(factor_address_to_sorted_index.count(m.adjacent_factor) > 0) {
-               const auto adjacent_index = factor_address_to_sorted_index[m.adjacent_factor]; 
+       assert(sorted_index(factor_index(*f_it)) != not_iterated);
+       const auto f_index = sorted_index(factor_index(*f_it));
+       for(const auto& m : adjacency[factor_index(*f_it)]) {
+           if(sorted_index(m.adjacent_factor) != not_iterated) {
+               const auto adjacent_index = sorted_index(m.adjacent_factor); 
                if(m.adjacent_factor_receives && adjacent_index > f_index) {
                    no_receiving_factors_later[f_index]++;
                    last_receiving_factor[f_index] = std::max(last_receiving_factor[f_index], adjacent_index);
@@ -1257,35 +1561,30 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
 
    // now take into account factors that are not iterated over, but from which a factor that is iterated over may send and another can receive.
    // It still makes sense to send and receive from such factors
-   std::unordered_map<FactorTypeAdapter*, std::size_t> min_adjacent_sending;
-   min_adjacent_sending.reserve(n);
-   std::unordered_map<FactorTypeAdapter*, std::size_t> max_adjacent_receiving;
-   max_adjacent_receiving.reserve(n);
+   std::vector<std::size_t> min_adjacent_sending(f_.size(), 0);
+   std::vector<std::size_t> max_adjacent_receiving(f_.size(), 0);
 
    if(n < f_.size()) {
 
        // get vector of factors that are (i) not in iteration list and (ii) are connected to two or more factors in iteration list.
-       std::unordered_map<FactorTypeAdapter*, std::size_t> adjacent_factors;
+       std::vector<std::size_t> no_adjacent_iterated(f_.size(), 0);
        for(auto f_it=factorIt; f_it!=factorEndIt; ++f_it) {
-           for(auto* f : (*f_it)->get_adjacent_factors()) {
-               if(factor_address_to_sorted_index.count(f) == 0) {
-                   // is adjacent_factors initialized with value 0?
-                   adjacent_factors[f]++;
+           for(const auto& m : adjacency[factor_index(*f_it)]) {
+               if(sorted_index(m.adjacent_factor) == not_iterated) {
+                   no_adjacent_iterated[m.adjacent_factor]++;
                }
            }
        }
 
-       for(auto e : adjacent_factors) {
-           if(e.second >= 2) {
-               FactorTypeAdapter* f = e.first;
-               auto& min_adjacent_sending_index = min_adjacent_sending[f];
-               auto& max_adjacent_receiving_index = max_adjacent_receiving[f] = 0;
+       for(std::size_t i=0; i<f_.size(); ++i) {
+           if(no_adjacent_iterated[i] >= 2) {
+               auto& min_adjacent_sending_index = min_adjacent_sending[i];
+               auto& max_adjacent_receiving_index = max_adjacent_receiving[i];
                min_adjacent_sending_index = std::numeric_limits<std::size_t>::max();
                max_adjacent_receiving_index = 0;
-               const auto adjacent_factors = e.first->get_messages();
-               for(const auto f : adjacent_factors) {
-                   if(factor_address_to_sorted_index.count(f.adjacent_factor)) {
-                       const auto adjacent_index = factor_address_to_sorted_index[f.adjacent_factor];
+               for(const auto& f : adjacency[i]) {
+                   if(sorted_index(f.adjacent_factor) != not_iterated) {
+                       const auto adjacent_index = sorted_index(f.adjacent_factor);
                        if(f.adjacent_factor_sends) {
                            min_adjacent_sending_index = std::min(adjacent_index, min_adjacent_sending_index);
                        }
@@ -1301,14 +1600,14 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
    omega = allocate_omega(factorIt, factorEndIt);
    receive_mask = allocate_receive_mask(factorIt, factorEndIt);
 
-   auto receives_msg = [&](FactorTypeAdapter* factor, const std::size_t factor_index, auto m) 
+   auto receives_msg = [&](const INDEX factor, const std::size_t factor_index, const factor_adjacency_entry& m) 
    { 
-       auto* adjacent_factor = m.adjacent_factor;
+       const INDEX adjacent_factor = m.adjacent_factor;
        assert(adjacent_factor != factor);
-       assert(factor_address_to_sorted_index.count(factor) > 0 && factor_address_to_sorted_index[factor] == factor_index);
+       assert(sorted_index(factor) != not_iterated && sorted_index(factor) == factor_index);
        assert(m.receives_from_adjacent_factor == true);
-       if(factor_address_to_sorted_index.count(adjacent_factor) > 0) {
-           const auto adjacent_factor_index = factor_address_to_sorted_index[adjacent_factor];
+       if(sorted_index(adjacent_factor) != not_iterated) {
+           const auto adjacent_factor_index = sorted_index(adjacent_factor);
            if(adjacent_factor_index < factor_index)  { return true; }
            if(first_receiving_factor[adjacent_factor_index] < factor_index) { return true; }
            return false;
@@ -1320,16 +1619,16 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
        } 
    };
 
-   auto sends_msg = [&](FactorTypeAdapter* factor, const std::size_t factor_index, auto m) 
+   auto sends_msg = [&](const INDEX factor, const std::size_t factor_index, const factor_adjacency_entry& m) 
    { 
-       auto* adjacent_factor = m.adjacent_factor;
+       const INDEX adjacent_factor = m.adjacent_factor;
        assert(adjacent_factor != factor);
-       assert(factor_address_to_sorted_index.count(factor) > 0 && factor_address_to_sorted_index[factor] == factor_index);
+       assert(sorted_index(factor) != not_iterated && sorted_index(factor) == factor_index);
        assert(m.sends_to_adjacent_factor == true);
-       if(factor_address_to_sorted_index.count(adjacent_factor) > 0) {
-           const auto adjacent_factor_index = factor_address_to_sorted_index[adjacent_factor];
+       if(sorted_index(adjacent_factor) != not_iterated) {
+           const auto adjacent_factor_index = sorted_index(adjacent_factor);
            //if(m.adjacent_factor_receives && receives_msg(adjacent_factor, adjacent_factor_index, m.reverse(factor))) { return false; }
-           if(factor_index < adjacent_factor_index && adjacent_factor->FactorUpdated()) { return true; }
+           if(factor_index < adjacent_factor_index && f_[adjacent_factor]->FactorUpdated()) { return true; }
            if(last_receiving_factor[adjacent_factor_index] > factor_index) { return true; }
            return false;
        } else {
@@ -1346,16 +1645,15 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
       for(auto f_it=factorIt; f_it!=factorEndIt; ++f_it) {
           auto* factor = *f_it;
           if(factor->FactorUpdated()) {
-              const auto factor_index = factor_address_to_sorted_index[factor];
-              const auto f_index = factor_address_to_index_[factor];
+              const INDEX f_index = factor->factor_index();
+              const auto factor_index = sorted_index(f_index);
               std::size_t k_send = 0;
               std::size_t k_receive = 0;
                
               // indicate which messages are sent and received
-              const auto msgs = factor->get_messages();
-              for(auto m : msgs) {
+              for(const auto& m : adjacency[f_index]) {
                   if(m.sends_to_adjacent_factor ) {
-                      if(sends_msg(factor, factor_index, m)) {
+                      if(sends_msg(f_index, factor_index, m)) {
                           omega[c][k_send] = 1.0;
                       } else {
                           omega[c][k_send] = 0.0;
@@ -1364,10 +1662,8 @@ void LP<FMC>::ComputeAnisotropicWeights( FACTOR_ITERATOR factorIt, FACTOR_ITERAT
                   }
 
                   if(m.receives_from_adjacent_factor) {
-                      if(receives_msg(factor, factor_index, m)) {
-                          receive_mask[c][k_receive] = 1; 
-                      } else {
-                          receive_mask[c][k_receive] = 0; 
+                      if(receives_msg(f_index, factor_index, m)) {
+                          receive_mask.set(c, k_receive);
                       }
                       ++k_receive; 
                   } 
@@ -1423,24 +1719,12 @@ void LP<FMC>::ComputeUniformWeights(
 
    omega = allocate_omega(factorIt, factorEndIt);
 
-   std::size_t c=0;
-   for(auto it=factorIt; it != factorEndIt; ++it) {
-     const auto f_index = factor_address_to_index_[ *it ];
-     if((*it)->FactorUpdated()) {
-       std::size_t k=0;
-       auto msgs = (*it)->get_messages();
-       const auto weight = 1.0/REAL(omega[c].size() + leave_weight);
-       for(auto msg_it : msgs) {
-           if(msg_it.sends_to_adjacent_factor) {
-               omega[c][k] = weight;
-               ++k;
-         }
-       }
-       assert(k == omega[c].size());
-       c++;
-     }
+   // every sending message gets the same weight, hence the adjacency need not be traversed
+#pragma omp parallel for
+   for(INDEX c=0; c<omega.size(); ++c) {
+     const auto weight = 1.0/REAL(omega[c].size() + leave_weight);
+     std::fill(omega[c].begin(), omega[c].end(), weight);
    }
-   assert(c == omega.size());
 }
 
 // compute anisotropic and damped uniform weights, then average them
@@ -1490,12 +1774,7 @@ void LP<FMC>::compute_full_receive_mask(FACTOR_ITERATOR factor_begin, FACTOR_ITE
             mask_size.push_back( (*it)->no_receive_messages() );
         } 
     }
-    receive_mask = receive_array(mask_size); 
-    for(std::size_t i=0; i<receive_mask.size(); ++i) {
-        for(std::size_t j=0; j<receive_mask[i].size(); ++j) {
-            receive_mask(i,j) = true;
-        }
-    }
+    receive_mask = receive_array(mask_size, true);
 
 }
 
@@ -1537,7 +1816,9 @@ void LP<FMC>::ComputePassAndPrimal(FACTOR_ITERATOR factorIt, const FACTOR_ITERAT
 {
    //possibly do not use parallelization here
 //#pragma omp parallel for schedule(static)
-   for(INDEX i=0; i<std::distance(factorIt, factorEndIt); ++i) {
+   const INDEX n = std::distance(factorIt, factorEndIt);
+   for(INDEX i=0; i<n; ++i) {
+      prefetch_ahead(factorIt, i, n);
       auto* f = *(factorIt+i);
       f->UpdateFactorPrimal(*(omegaIt + i), *(receive_mask_it + i), iteration);
    }
@@ -1561,6 +1842,67 @@ void LP<FMC>::ComputePassAndPrimalSynchronized(FACTOR_ITERATOR factorIt, const F
 }
 #endif
 
+template<typename FMC>
+memory_report LP<FMC>::get_memory_report()
+{
+  memory_report r;
+  for_each_tuple(factors_, [&r](auto& v) {
+      using container_type = std::remove_pointer_t<typename std::decay_t<decltype(v)>::value_type>;
+      std::size_t bytes = memory_in_bytes(v);
+      for(auto* f : v) { bytes += sizeof(container_type) + f->dual_size_in_bytes(); }
+      r.add("factors", "factor " + std::to_string(container_type::factorNumber), v.size(), bytes);
+  });
+  for_each_tuple(messages_, [&r](auto& v) {
+      using container_type = std::remove_pointer_t<typename std::decay_t<decltype(v)>::value_type>;
+      r.add("messages", "message " + std::to_string(container_type::messageNumber), v.size(), memory_in_bytes(v) + v.size()*sizeof(container_type));
+  });
+  r.add("lp", "factor and message lists", f_.size() + m_.size(), memory_in_bytes(f_) + memory_in_bytes(m_));
+
+  // materialized arrays and their bytes
+  std::size_t no_arrays = 0;
+  auto arrays = [&no_arrays](const auto&... a) {
+      no_arrays = (std::size_t(a.size() > 0) + ...);
+      return (a.memory() + ...);
+  };
+  auto array_vectors = [&no_arrays](const auto&... v) {
+      std::size_t bytes = (memory_in_bytes(v) + ...);
+      no_arrays = 0;
+      auto add = [&](const auto& vec) { for(const auto& a : vec) { bytes += a.memory(); no_arrays += a.size() > 0; } };
+      (add(v), ...);
+      return bytes;
+  };
+
+  const std::size_t weight_bytes = arrays(omegaForwardAnisotropic_, omegaBackwardAnisotropic_, omegaForwardAnisotropic2_, omegaBackwardAnisotropic2_, omegaForwardIsotropic_, omegaBackwardIsotropic_, omegaForwardIsotropicDamped_, omegaBackwardIsotropicDamped_, omegaForwardMixed_, omegaBackwardMixed_);
+  r.add("weights", "omega", no_arrays, weight_bytes);
+  const std::size_t mask_bytes = arrays(anisotropic_receive_mask_forward_, anisotropic_receive_mask_backward_, receive_mask_anisotropic2_forward_, receive_mask_anisotropic2_backward_, full_receive_mask_forward_, full_receive_mask_backward_);
+  r.add("weights", "receive masks", no_arrays, mask_bytes);
+  const std::size_t partition_weight_bytes = array_vectors(omega_partition_forward_, omega_partition_backward_, omega_partition_forward_pass_push_forward_, omega_partition_backward_pass_push_forward_, omega_partition_forward_pass_push_backward_, omega_partition_backward_pass_push_backward_, omega_partition_forward_pass_push_, omega_partition_backward_pass_push_, omega_overlapping_partition_forward_, omega_overlapping_partition_backward_);
+  r.add("weights", "partition omega", no_arrays, partition_weight_bytes);
+  const std::size_t partition_mask_bytes = array_vectors(receive_mask_partition_forward_, receive_mask_partition_backward_, receive_mask_partition_forward_pass_push_forward_, receive_mask_partition_backward_pass_push_forward_, receive_mask_partition_forward_pass_push_backward_, receive_mask_partition_backward_pass_push_backward_, receive_mask_partition_forward_pass_push_, receive_mask_partition_backward_pass_push_, receive_mask_overlapping_partition_forward_, receive_mask_overlapping_partition_backward_);
+  r.add("weights", "partition receive masks", no_arrays, partition_mask_bytes);
+
+  r.add("orderings", "factor orderings", forwardOrdering_.size() + backwardOrdering_.size() + forwardUpdateOrdering_.size() + backwardUpdateOrdering_.size(),
+        memory_in_bytes(forwardOrdering_) + memory_in_bytes(backwardOrdering_) + memory_in_bytes(forwardUpdateOrdering_) + memory_in_bytes(backwardUpdateOrdering_));
+  r.add("orderings", "factor relations", forward_pass_factor_rel_.size() + backward_pass_factor_rel_.size(), memory_in_bytes(forward_pass_factor_rel_) + memory_in_bytes(backward_pass_factor_rel_));
+  r.add("orderings", "sorted factors", f_forward_sorted_.size() + f_backward_sorted_.size(),
+        memory_in_bytes(f_forward_sorted_) + memory_in_bytes(f_backward_sorted_));
+  r.add("orderings", "wavefront schedules", wavefront_forward_.update_position.size() + wavefront_backward_.update_position.size(),
+        memory_in_bytes(wavefront_forward_.update_position) + memory_in_bytes(wavefront_forward_.batch_offsets) + memory_in_bytes(wavefront_backward_.update_position) + memory_in_bytes(wavefront_backward_.batch_offsets));
+  r.add("orderings", "factor adjacency", factor_adjacency_.size(), factor_adjacency_.memory());
+  r.add("orderings", "factor partition", factor_partition_.size(), factor_partition_.memory() + memory_in_bytes(partition_graph));
+
+  for(const auto& a : global_real_block_arena_array) {
+    r.arena_used += a.mem_used();
+    r.arena_reserved += a.mem_reserved();
+    r.arena_peak_reserved += a.mem_peak_reserved();
+  }
+  r.arena_used += global_real_block_arena.mem_used();
+  r.arena_reserved += global_real_block_arena.mem_reserved();
+  r.arena_peak_reserved += global_real_block_arena.mem_peak_reserved();
+
+  return r;
+}
+
 template<typename FMC>
 void LP<FMC>::set_flags_dirty()
 {
@@ -1572,57 +1914,70 @@ void LP<FMC>::set_flags_dirty()
   omega_mixed_valid_ = false;
   factor_partition_valid_ = false;
   full_receive_mask_valid_ = false;
+  factor_adjacency_valid_ = false;
+  wavefront_valid_ = false;
 #ifdef LP_MP_PARALLEL
   synchronization_valid_ = false;
 #endif
 }
 
+template<typename FMC>
+const two_dim_variable_array<factor_adjacency_entry>& LP<FMC>::get_factor_adjacency()
+{
+  if(factor_adjacency_valid_) { return factor_adjacency_; }
+  factor_adjacency_valid_ = true;
+
+  std::vector<INDEX> degree(f_.size());
+#pragma omp parallel for
+  for(INDEX i=0; i<f_.size(); ++i) {
+    degree[i] = f_[i]->no_messages();
+  }
+  factor_adjacency_.resize(degree.begin(), degree.end());
+
+#pragma omp parallel for schedule(guided)
+  for(INDEX i=0; i<f_.size(); ++i) {
+    const auto msgs = f_[i]->get_messages();
+    assert(msgs.size() == degree[i]);
+    for(INDEX k=0; k<msgs.size(); ++k) {
+      const auto& m = msgs[k];
+      factor_adjacency_(i,k) = {factor_index(m.adjacent_factor), m.chirality, m.sends_to_adjacent_factor, m.receives_from_adjacent_factor, m.adjacent_factor_sends, m.adjacent_factor_receives};
+    }
+  }
+  return factor_adjacency_;
+}
+
 template<typename FMC>
 std::vector<bool> LP<FMC>::get_inconsistent_mask(const std::size_t no_fatten_rounds)
 {
-  std::vector<bool> inconsistent_mask(f_.size(),false);
+  // char instead of bool, so that threads can write distinct entries concurrently
+  std::vector<char> inconsistent(f_.size(), false);
   
-  // check for locally non-optimal factors
+  // check for locally non-optimal factors and violated messages
+#pragma omp parallel for schedule(guided)
   for(std::size_t i=0; i<f_.size(); ++i) {
     auto* f = f_[i];
     assert(f->EvaluatePrimal() < std::numeric_limits<REAL>::infinity());
-    if(f->LowerBound() < f->EvaluatePrimal() - eps) {
-      inconsistent_mask[i] = true;
+    if(f->LowerBound() < f->EvaluatePrimal() - eps || !f->check_primal_consistency()) {
+      inconsistent[i] = true;
     }
   }
 
-  // check for violated messages
-  for(auto* f : f_) {
-      if(!f->check_primal_consistency()) {
-          auto f_index = factor_address_to_index_[f];
-          inconsistent_mask[f_index] = true;
-      }
+  // fatten the region by breadth first search from inconsistent factors
+  const auto& adjacency = get_factor_adjacency();
+  std::vector<INDEX> frontier;
+  for(INDEX i=0; i<f_.size(); ++i) {
+    if(inconsistent[i]) { frontier.push_back(i); }
   }
-
-  // fatten the region
-  auto fatten = [&]() {
-    for(auto m : m_) {
-      auto* l = m.left;
-      auto l_index = factor_address_to_index_[l];
-      auto* r = m.right;
-      auto r_index = factor_address_to_index_[r];
-
-      if(inconsistent_mask[l_index] == true || inconsistent_mask[r_index] == true) {
-        inconsistent_mask[l_index] = true;
-        inconsistent_mask[r_index] = true;
-      }
-    }
-  };
-
-  for(std::size_t iter=0; iter<no_fatten_rounds; ++iter) {
-    fatten();
+  for(std::size_t iter=0; iter<no_fatten_rounds && frontier.size() > 0; ++iter) {
+    frontier = expand_frontier(adjacency, frontier, [&](const INDEX j) { return !inconsistent[j]; });
+    for(const INDEX j : frontier) { inconsistent[j] = true; }
   }
 
   if(debug()) {
-    std::cout << "\% inconsistent factors = " << std::count(inconsistent_mask.begin(), inconsistent_mask.end(), true)/REAL(f_.size()) << "\n";
+    std::cout << "\% inconsistent factors = " << std::count(inconsistent.begin(), inconsistent.end(), true)/REAL(f_.size()) << "\n";
   }
 
-  return inconsistent_mask;
+  return std::vector<bool>(inconsistent.begin(), inconsistent.end());
 }
 
 template<typename FMC>
@@ -1635,7 +1990,7 @@ std::vector<FactorTypeAdapter*> LP<FMC>::get_masked_factors(
   
   std::vector<FactorTypeAdapter*> factors;
   for(auto f_it=factor_begin; f_it!=factor_end; ++f_it) {
-    const auto f_index = factor_address_to_index_[*f_it];
+    const auto f_index = factor_index(*f_it);
     if(factor_mask_begin[f_index]) {
       factors.push_back(*f_it);
     }
@@ -1665,8 +2020,8 @@ inline void LP<FMC>::construct_factor_partition()
 
     UnionFind uf(f_.size());
     for(auto p : partition_graph) {
-        const auto i = factor_address_to_index_[p[0]];
-        const auto j = factor_address_to_index_[p[1]];
+        const auto i = factor_index(p[0]);
+        const auto j = factor_index(p[1]);
         uf.merge(i,j);
     }
     auto contiguous_ids = uf.get_contiguous_ids();
@@ -1701,17 +2056,17 @@ inline void LP<FMC>::construct_factor_partition()
     }
 
     // sort factor_partition.
-    std::unordered_map<FactorTypeAdapter*, std::size_t> factor_address_to_sorted_position;
+    std::vector<std::size_t> sorted_position(f_.size(), std::numeric_limits<std::size_t>::max());
     for(std::size_t i=0; i<forwardOrdering_.size(); ++i) {
-        factor_address_to_sorted_position.insert( {forwardOrdering_[i], i} );
+        sorted_position[ forwardOrdering_[i]->factor_index() ] = i;
     }
     for(std::size_t i=0; i<factor_partition_.size(); ++i) {
         std::vector<std::pair<std::size_t,FactorTypeAdapter*>> sorted_indices; // sorted index, number in partition
         sorted_indices.reserve(factor_partition_[i].size());
         for(std::size_t j=0; j<factor_partition_[i].size(); ++j) {
             auto* f = factor_partition_[i][j];
-            assert(factor_address_to_sorted_position.find(f) != factor_address_to_sorted_position.end());
-            const std::size_t idx = factor_address_to_sorted_position[f];
+            assert(sorted_position[f->factor_index()] != std::numeric_limits<std::size_t>::max());
+            const std::size_t idx = sorted_position[f->factor_index()];
             sorted_indices.push_back( {idx, f} );
         }
         std::sort(sorted_indices.begin(), sorted_indices.end(), [](const auto a, const auto b) { return std::get<0>(a) < std::get<0>(a); });
@@ -1787,8 +2142,8 @@ template<typename FMC>
 template<typename PARTITION_ITERATOR, typename INTRA_PARTITION_FACTOR_ITERATOR>
 inline void LP<FMC>::construct_forward_pushing_weights(PARTITION_ITERATOR partition_begin, PARTITION_ITERATOR partition_end, std::vector<weight_array>& omega_partition, std::vector<receive_array>& receive_mask_partition, INTRA_PARTITION_FACTOR_ITERATOR factor_iterator_getter)
 {
-    std::unordered_map<FactorTypeAdapter*, std::size_t> factor_address_to_partition;
-    factor_address_to_partition.reserve(f_.size());
+    constexpr std::size_t no_partition = std::numeric_limits<std::size_t>::max();
+    std::vector<std::size_t> factor_partition_number(f_.size(), no_partition);
 
     for(auto partition_it=partition_begin; partition_it!=partition_end; ++partition_it) {
 
@@ -1796,11 +2151,12 @@ inline void LP<FMC>::construct_forward_pushing_weights(PARTITION_ITERATOR partit
 
         const auto partition_number = std::distance(partition_begin, partition_it);
         for(auto factor_it=factor_begin; factor_it!=factor_end; ++factor_it) {
-            assert(factor_address_to_partition.count(*factor_it) == 0);
-            factor_address_to_partition.insert( {*factor_it, partition_number} );
+            assert(factor_partition_number[(*factor_it)->factor_index()] == no_partition);
+            factor_partition_number[(*factor_it)->factor_index()] = partition_number;
         }
     }
 
+    const auto& adjacency = get_factor_adjacency();
     const auto no_partitions = std::distance(partition_begin, partition_end);
     omega_partition.reserve(no_partitions);
     receive_mask_partition.reserve(no_partitions);
@@ -1809,11 +2165,6 @@ inline void LP<FMC>::construct_forward_pushing_weights(PARTITION_ITERATOR partit
 
         auto [factor_begin, factor_end] = factor_iterator_getter(*partition_it);
 
-        std::unordered_map<FactorTypeAdapter*, std::size_t> factor_address_to_partition_position;
-        for(auto factor_it=factor_begin; factor_it!=factor_end; ++factor_it) {
-            factor_address_to_partition_position.insert( {*factor_it, factor_address_to_partition_position.size()} );
-        }
-
         const auto partition_number = std::distance(partition_begin, partition_it);
         omega_partition.push_back(allocate_omega(factor_begin, factor_end));
         auto& omega = omega_partition.back();
@@ -1825,11 +2176,11 @@ inline void LP<FMC>::construct_forward_pushing_weights(PARTITION_ITERATOR partit
             if((*factor_it)->FactorUpdated()) {
                 std::size_t k_send = 0;
                 std::size_t k_receive = 0;
-                for(auto m : (*factor_it)->get_messages()) {
+                for(const auto& m : adjacency[(*factor_it)->factor_index()]) {
                     if(m.sends_to_adjacent_factor) {
-                        if(factor_address_to_partition.count(m.adjacent_factor)) {
-                            const auto adjacent_factor_partition = factor_address_to_partition[m.adjacent_factor];
-                            if(adjacent_factor_partition >= partition_number) {
+                        const auto adjacent_factor_partition = factor_partition_number[m.adjacent_factor];
+                        if(adjacent_factor_partition != no_partition) {
+                            if(adjacent_factor_partition >= std::size_t(partition_number)) {
                                 omega[c][k_send] = 1.0;
                             } else {
                                 omega[c][k_send] = 0.0;
@@ -1844,11 +2195,9 @@ inline void LP<FMC>::construct_forward_pushing_weights(PARTITION_ITERATOR partit
                         ++k_send;
                     }
                     if(m.receives_from_adjacent_factor) {
-                        const auto adjacent_factor_partition = factor_address_to_partition[m.adjacent_factor];
-                        if(adjacent_factor_partition <= partition_number) {
-                            receive_mask[c][k_receive] = 1.0;
-                        } else {
-                            receive_mask[c][k_receive] = 0.0;
+                        const auto adjacent_factor_partition = factor_partition_number[m.adjacent_factor];
+                        if(adjacent_factor_partition == no_partition || adjacent_factor_partition <= std::size_t(partition_number)) {
+                            receive_mask.set(c, k_receive);
                         }
                         ++k_receive;
                     }
@@ -4,6 +4,7 @@
 #include "DD_ILP.hxx"
 #include "LP_MP.h"
 #include "external_solver_interface.hxx"
+#include "streaming_lp_export.hxx"
 
 // interface to DD_ILP object which builds up the given LP_MP problem for various other solvers.
 // there are two functions a factor must provide, so that the export can take place:
@@ -45,6 +46,11 @@ public:
     s_.write_to_file(filename);
   }
 
+  // write model in LP format without building it in the external solver first
+  void stream_to_file(const std::string& filename) {
+    streaming_lp_export::write(*this, filename);
+  }
+
   const external_solver& get_external_solver() const { return s_; }
 
 private:
@@ -55,18 +61,17 @@ private:
       return; // already constructed
 
     // Can't use `for_each_factor` here, as the order is different than `f_`
-    // and we rely on `factor_address_to_index_` which gets updated in
-    // `add_factor`.
+    // and we rely on the factor indices which are set in `add_factor`.
     for (auto* f : this->f_) {
       external_variable_counter_.push_back(s_.get_variable_counters());
       f->construct_constraints(s_);
     }
 
     this->for_each_message([&](auto* m) {
-      const INDEX left_factor_no = this->factor_address_to_index_[m->GetLeftFactor()];
+      const INDEX left_factor_no = m->GetLeftFactor()->factor_index();
       assert(left_factor_no < this->GetNumberOfFactors() && left_factor_no < external_variable_counter_.size());
 
-      const INDEX right_factor_no = this->factor_address_to_index_[m->GetRightFactor()];
+      const INDEX right_factor_no = m->GetRightFactor()->factor_index();
       assert(right_factor_no < this->GetNumberOfFactors() && right_factor_no < external_variable_counter_.size());
 
       m->construct_constraints(s_, external_variable_counter_[left_factor_no], external_variable_counter_[right_factor_no]);
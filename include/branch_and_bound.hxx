@@ -0,0 +1,411 @@
+#ifndef LP_MP_BRANCH_AND_BOUND_HXX
+#define LP_MP_BRANCH_AND_BOUND_HXX
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "LP_MP.h"
+#include "serialization.hxx"
+#include "partial_external_solver.hxx"
+
+// native best-first branch and bound on a subset of factors of an LP_MP problem and the messages between them.
+// Lower bounds come from a few rounds of message passing restricted to the subset.
+// Branching fixes a factor to its current primal (left) or forbids it (right), hence factors need to provide
+//   void branch_left()
+//   void branch_right()
+// which act on the current primal by setting costs to infinity.
+// Open nodes store the reparametrization of all factors in fixed size slots of one arena.
+
+namespace LP_MP {
+
+class branch_and_bound {
+public:
+  branch_and_bound(const INDEX max_nodes = 100000, const INDEX no_bounding_passes = 5)
+  : max_nodes_(max_nodes),
+  no_bounding_passes_(no_bounding_passes)
+  {}
+
+  template<typename FACTOR_CONTAINER_TYPE>
+  void add_factor(FACTOR_CONTAINER_TYPE* f)
+  {
+    if(!has_factor(f)) {
+      dirty_ = true;
+      factor_address_to_index_.insert(std::make_pair(f, f_.size()));
+      f_.push_back(f);
+    }
+  }
+
+  template<typename MESSAGE_CONTAINER_TYPE>
+  void add_message(MESSAGE_CONTAINER_TYPE* m)
+  {
+    if(!has_message(m)) {
+      dirty_ = true;
+      m_address_.insert(m);
+      auto* l = m->GetLeftFactor();
+      auto* r = m->GetRightFactor();
+      assert(has_factor(l) && has_factor(r));
+
+      using message_type = MESSAGE_CONTAINER_TYPE;
+      region_message rm;
+      rm.msg = m;
+      rm.left = factor_address_to_index_[l];
+      rm.right = factor_address_to_index_[r];
+      if constexpr(message_type::sends_message_to_left_constexpr()) {
+        rm.send_to_left = [](void* msg) { static_cast<message_type*>(msg)->send_message_to_left(); };
+      }
+      if constexpr(message_type::sends_message_to_right_constexpr()) {
+        rm.send_to_right = [](void* msg) { static_cast<message_type*>(msg)->send_message_to_right(); };
+      }
+      rm.check_primal_consistency = [](void* msg) { return static_cast<message_type*>(msg)->CheckPrimalConsistency(); };
+      m_.push_back(rm);
+    }
+  }
+
+  template<class LP_TYPE>
+  void add_messages(const LP_TYPE &LP)
+  {
+    LP.for_each_message([this](auto* m) {
+      if (has_factor(m->GetLeftFactor()) && has_factor(m->GetRightFactor()))
+        add_message(m);
+    });
+  }
+
+  // costs are read from the factors at the beginning of each solve
+  void update_costs(FactorTypeAdapter* f) {}
+
+  bool has_factor(FactorTypeAdapter* f) const { return factor_address_to_index_.find(f) != factor_address_to_index_.end(); }
+  bool has_message(const void* m) const { return m_address_.find(m) != m_address_.end(); }
+
+  INDEX GetNumberOfFactors() const { return f_.size(); }
+  FactorTypeAdapter* GetFactor(const INDEX i) const { assert(i < f_.size()); return f_[i]; } // in order of addition
+  INDEX GetNumberOfMessages() const { return m_.size(); }
+
+  bool dirty() const { return dirty_; }
+
+  REAL lower_bound() const { return lower_bound_; }
+  REAL upper_bound() const { return upper_bound_; }
+  INDEX no_nodes() const { return no_nodes_; }
+  // was the search completed, i.e. is the primal solution optimal?
+  bool optimal() const { return optimal_; }
+
+  // the reparametrization of the factors is left untouched, the best labeling found is written into the factors' primals.
+  bool solve()
+  {
+    if(!dirty_) {
+      return true;
+    }
+    dirty_ = false;
+    no_nodes_ = 0;
+    optimal_ = true;
+    lower_bound_ = -std::numeric_limits<REAL>::infinity();
+    upper_bound_ = std::numeric_limits<REAL>::infinity();
+    if(f_.size() == 0) {
+      lower_bound_ = upper_bound_ = 0.0;
+      return true;
+    }
+
+    dual_size_in_bytes_ = 0;
+    INDEX primal_size_in_bytes = 0;
+    for(auto* f : f_) {
+      dual_size_in_bytes_ += f->dual_size_in_bytes();
+      primal_size_in_bytes += f->primal_size_in_bytes();
+    }
+    const INDEX slot_size = (dual_size_in_bytes_ + f_.size() + sizeof(REAL) - 1) / sizeof(REAL) * sizeof(REAL);
+    arena_.init(slot_size);
+    incumbent_.resize(primal_size_in_bytes);
+    branched_.assign(f_.size(), branch_state::free);
+
+    const INDEX root = arena_.allocate();
+    save_node(root);
+
+    auto node_order = [](const node& a, const node& b) {
+      return a.lower_bound > b.lower_bound || (a.lower_bound == b.lower_bound && a.depth < b.depth);
+    };
+    std::vector<node> open;
+    open.push_back({-std::numeric_limits<REAL>::infinity(), 0, arena_.allocate()});
+    save_node(open.back().slot);
+
+    while(!open.empty()) {
+      if(open.front().lower_bound >= upper_bound_ - eps) {
+        break; // best-first: all remaining nodes are pruned
+      }
+      if(no_nodes_ >= max_nodes_) {
+        optimal_ = false;
+        break;
+      }
+
+      std::pop_heap(open.begin(), open.end(), node_order);
+      const node n = open.back();
+      open.pop_back();
+      ++no_nodes_;
+
+      load_node(n.slot);
+      arena_.release(n.slot);
+
+      const REAL lb = bound();
+      if(lb >= upper_bound_ - eps) {
+        continue; // also infeasible nodes with infinite bound
+      }
+
+      compute_primal();
+      INDEX i;
+      const node_status status = branching_factor(i);
+      if(status == node_status::infeasible) {
+        continue;
+      }
+      if(status == node_status::unbranchable) {
+        optimal_ = false;
+        continue;
+      }
+      if(status == node_status::consistent) {
+        const REAL cost = evaluate_primal();
+        if(cost < upper_bound_) {
+          upper_bound_ = cost;
+          save_incumbent();
+        }
+        continue;
+      }
+
+      const INDEX right = arena_.allocate();
+      save_node(right);
+      f_[i]->branch_left();
+      branched_[i] = branch_state::fixed;
+      const INDEX left = arena_.allocate();
+      save_node(left);
+
+      load_node(right);
+      f_[i]->branch_right();
+      branched_[i] = std::max(branched_[i], branch_state::restricted);
+      save_node(right);
+
+      open.push_back({lb, n.depth+1, left});
+      std::push_heap(open.begin(), open.end(), node_order);
+      open.push_back({lb, n.depth+1, right});
+      std::push_heap(open.begin(), open.end(), node_order);
+    }
+
+    lower_bound_ = open.empty() ? upper_bound_ : std::min(upper_bound_, open.front().lower_bound);
+    if(optimal_) {
+      lower_bound_ = upper_bound_;
+    }
+    for(const auto& n : open) {
+      arena_.release(n.slot);
+    }
+
+    load_node(root);
+    arena_.release(root);
+    if(upper_bound_ < std::numeric_limits<REAL>::infinity()) {
+      load_incumbent();
+    }
+
+    if(debug()) {
+      std::cout << "branch and bound: " << no_nodes_ << " nodes, lower bound = " << lower_bound_ << ", upper bound = " << upper_bound_ << "\n";
+    }
+
+    return upper_bound_ < std::numeric_limits<REAL>::infinity();
+  }
+
+private:
+  // message between two factors of the subset, message passing operations are dispatched through function pointers
+  struct region_message {
+    void* msg;
+    INDEX left, right; // indices into f_
+    void (*send_to_left)(void*) = nullptr;
+    void (*send_to_right)(void*) = nullptr;
+    bool (*check_primal_consistency)(void*) = nullptr;
+  };
+
+  // free: untouched, restricted: some labelings forbidden, fixed: only one labeling allowed
+  enum class branch_state : unsigned char { free = 0, restricted = 1, fixed = 2 };
+
+  struct node {
+    REAL lower_bound;
+    INDEX depth;
+    INDEX slot; // into arena_
+  };
+
+  // fixed size slots in one contiguous buffer, released slots are reused
+  class node_arena {
+  public:
+    void init(const INDEX slot_size)
+    {
+      slot_size_ = slot_size;
+      memory_.clear();
+      free_slots_.clear();
+    }
+
+    INDEX allocate()
+    {
+      if(free_slots_.size() > 0) {
+        const INDEX s = free_slots_.back();
+        free_slots_.pop_back();
+        return s;
+      }
+      const INDEX s = memory_.size() / slot_size_;
+      memory_.resize(memory_.size() + slot_size_);
+      return s;
+    }
+
+    void release(const INDEX s) { free_slots_.push_back(s); }
+
+    char* slot(const INDEX s)
+    {
+      assert(s < memory_.size() / slot_size_);
+      return memory_.data() + s*slot_size_;
+    }
+
+  private:
+    std::vector<char> memory_;
+    std::vector<INDEX> free_slots_;
+    INDEX slot_size_;
+  };
+
+  void save_node(const INDEX s)
+  {
+    char* mem = arena_.slot(s);
+    serialization_archive ar(mem, dual_size_in_bytes_);
+    save_archive s_ar(ar);
+    for(auto* f : f_) {
+      f->serialize_dual(s_ar);
+    }
+    ar.release_memory();
+    std::copy(branched_.begin(), branched_.end(), reinterpret_cast<branch_state*>(mem + dual_size_in_bytes_));
+  }
+
+  void load_node(const INDEX s)
+  {
+    char* mem = arena_.slot(s);
+    serialization_archive ar(mem, dual_size_in_bytes_);
+    load_archive l_ar(ar);
+    for(auto* f : f_) {
+      f->serialize_dual(l_ar);
+    }
+    ar.release_memory();
+    const auto* b = reinterpret_cast<const branch_state*>(mem + dual_size_in_bytes_);
+    std::copy(b, b + f_.size(), branched_.begin());
+  }
+
+  void save_incumbent()
+  {
+    serialization_archive ar(incumbent_.data(), incumbent_.size());
+    save_archive s_ar(ar);
+    for(auto* f : f_) {
+      f->serialize_primal(s_ar);
+    }
+    ar.release_memory();
+  }
+
+  void load_incumbent()
+  {
+    serialization_archive ar(incumbent_.data(), incumbent_.size());
+    load_archive l_ar(ar);
+    for(auto* f : f_) {
+      f->serialize_primal(l_ar);
+    }
+    ar.release_memory();
+  }
+
+  // Messages adjacent to branched factors are skipped: their infinite costs would turn message updates into NaNs.
+  REAL bound()
+  {
+    auto active = [this](const region_message& m) {
+      return branched_[m.left] == branch_state::free && branched_[m.right] == branch_state::free;
+    };
+    for(INDEX iter=0; iter<no_bounding_passes_; ++iter) {
+      for(auto& m : m_) {
+        if(m.send_to_right != nullptr && active(m)) { m.send_to_right(m.msg); }
+      }
+      for(auto it=m_.rbegin(); it!=m_.rend(); ++it) {
+        if(it->send_to_left != nullptr && active(*it)) { it->send_to_left(it->msg); }
+      }
+    }
+
+    REAL lb = 0.0;
+    for(auto* f : f_) {
+      lb += f->LowerBound();
+    }
+    return lb;
+  }
+
+  void compute_primal()
+  {
+    for(auto* f : f_) {
+      f->init_primal();
+      f->MaximizePotentialAndComputePrimal();
+    }
+  }
+
+  REAL evaluate_primal() const
+  {
+    REAL cost = 0.0;
+    for(auto* f : f_) {
+      cost += f->EvaluatePrimal();
+    }
+    return cost;
+  }
+
+  enum class node_status { consistent, infeasible, unbranchable, branch };
+
+  // find factor adjacent to an inconsistent message that is not yet fixed.
+  // If both factors of an inconsistent message are fixed, no consistent labeling exists below the current node.
+  node_status branching_factor(INDEX& branch_idx) const
+  {
+    node_status status = node_status::consistent;
+    for(const auto& m : m_) {
+      if(!m.check_primal_consistency(m.msg)) {
+        if(branched_[m.left] == branch_state::fixed && branched_[m.right] == branch_state::fixed) {
+          return node_status::infeasible;
+        }
+        for(const INDEX i : {m.left, m.right}) {
+          if(branched_[i] != branch_state::fixed) {
+            if(f_[i]->can_branch()) {
+              branch_idx = i;
+              return node_status::branch;
+            }
+            status = node_status::unbranchable;
+          }
+        }
+      }
+    }
+    return status;
+  }
+
+  std::vector<FactorTypeAdapter*> f_;
+  std::vector<region_message> m_;
+  std::unordered_set<const void*> m_address_;
+  std::unordered_map<FactorTypeAdapter*, INDEX> factor_address_to_index_;
+
+  node_arena arena_;
+  std::vector<branch_state> branched_; // of the current node
+  std::vector<char> incumbent_; // primal solutions of factors
+  INDEX dual_size_in_bytes_ = 0;
+
+  const INDEX max_nodes_;
+  const INDEX no_bounding_passes_;
+  INDEX no_nodes_ = 0;
+  REAL lower_bound_ = -std::numeric_limits<REAL>::infinity();
+  REAL upper_bound_ = std::numeric_limits<REAL>::infinity();
+  bool optimal_ = true;
+  bool dirty_ = false;
+};
+
+// allows using the native branch and bound as ILP solver in combiLP, i.e. combiLP<native_branch_and_bound, BASE_LP>
+struct native_branch_and_bound {};
+
+template<>
+class partial_external_solver<native_branch_and_bound> : public branch_and_bound {
+public:
+  void write_to_file(const std::string& filename)
+  {
+    throw std::runtime_error("native branch and bound cannot export its model");
+  }
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_BRANCH_AND_BOUND_HXX
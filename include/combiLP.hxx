@@ -54,7 +54,8 @@ public:
 
     using primals = factor_archive<serialization_functor::primal>;
     INDEX size_lp, size_active, size_ilp;
-    std::unordered_map<FactorTypeAdapter*, State> factor_states;
+    std::vector<State> factor_states(this->f_.size(), State::Active); // indexed by factor index
+    const auto& adjacency = this->get_factor_adjacency();
     partial_external_solver<EXTERNAL_SOLVER> external_solver;
     primals primals_lp(this->f_.begin(), this->f_.end());
     double lower_bound = -std::numeric_limits<double>::infinity();
@@ -69,12 +70,11 @@ public:
       // optimality checking by modifying the assignment and checking the
       // bounds.
       primals p(this->f_.begin(), this->f_.end());
-      this->for_each_factor([&](auto* f) {
-        assert(factor_states.find(f) != factor_states.end());
-        if (factor_states[f] == State::LP) {
-          assert(decltype(primals_lp)::check_factor_equality(primals_lp, p, f));
+      for (INDEX i = 0; i < this->f_.size(); ++i) {
+        if (factor_states[i] == State::LP) {
+          assert(decltype(primals_lp)::check_factor_equality(primals_lp, p, this->f_[i]));
         }
-      });
+      }
 
       // Messages inside LP (and ILP if ilp_must_be_consistent set) have to be
       // consistent (messages on borders are always excluded).
@@ -92,85 +92,66 @@ public:
     //   - moves non-optimal "active" factors into ILP
     //   - checks message consistency on boundary (and moves factors into ILP)
     auto update_partition = [&](primals* primals_ilp) {
-      this->for_each_factor([&](auto* f) {
+      // Restoring is done serially, as the archives are not thread safe.
+      for (INDEX i = 0; i < this->f_.size(); ++i) {
+        if (factor_states[i] == State::LP)
+          primals_lp.load_factor(this->f_[i]);
+        else if (factor_states[i] == State::ILP && primals_ilp)
+          primals_ilp->load_factor(this->f_[i]);
+      }
+
+      // An "active" factor moves into the ILP if it is not locally optimal or
+      // if one of its messages is violated. The checks only read factors and
+      // are done in parallel.
+      std::vector<char> move_to_ilp(this->f_.size(), false);
+#pragma omp parallel for schedule(guided)
+      for (INDEX i = 0; i < this->f_.size(); ++i) {
+        auto* f = this->f_[i];
         assert(f->LowerBound() <= f->EvaluatePrimal() + eps);
-        assert(factor_states.find(f) != factor_states.end());
-        switch (factor_states[f]) {
-        case State::LP:
-          primals_lp.load_factor(f);
-          break;
-        case State::Active:
-          if (f->LowerBound() < f->EvaluatePrimal() - eps) // not locally optimal
-            external_solver.add_factor(f);
-          break;
-        case State::ILP:
-          if (primals_ilp)
-            primals_ilp->load_factor(f);
-          break;
-        };
-      });
+        if (factor_states[i] == State::Active)
+          move_to_ilp[i] = f->LowerBound() < f->EvaluatePrimal() - eps || !f->check_primal_consistency();
+      }
 
-      this->for_each_message([&](auto* m) {
-        if (!m->CheckPrimalConsistency()) { // no factor agreement
-#ifndef NDEBUG
-          bool handled = false;
-#endif
-          std::array<FactorTypeAdapter*, 2> tmp = { m->GetLeftFactor(), m->GetRightFactor() };
-          for (auto* f : tmp) {
-            assert(factor_states.find(f) != factor_states.end());
-            if (factor_states[f] == State::Active) {
-              external_solver.add_factor(f);
-#ifndef NDEBUG
-              handled = true;
-#endif
-            }
-          }
-          assert(handled);
-        }
-      });
+      for (INDEX i = 0; i < this->f_.size(); ++i)
+        if (move_to_ilp[i])
+          external_solver.add_factor(this->f_[i]);
     };
 
-    // Updates the state of labeling. First LP and ILP parts are set and
-    // afterwards the "active" region is computed. Additionally
-    // size_{lp,active,ilp} are set.
+    // Updates the state of labeling. Factors that entered the ILP since the
+    // last call become ILP and their LP neighbors become "active". As the ILP
+    // only grows, this is a breadth first search step from the new ILP
+    // factors instead of a sweep over all factors and messages.
+    // Additionally size_{lp,active,ilp} are kept up to date.
+    INDEX no_ilp_factors_seen = 0;
     auto update_states = [&]() {
-      size_lp = 0; size_active = 0; size_ilp = 0;
-      for (auto* f : this->f_) {
-        assert(factor_states.find(f) != factor_states.end());
-        if (external_solver.has_factor(f)) {
-          factor_states[f] = State::ILP;
-          ++size_ilp;
-        } else {
-          factor_states[f] = State::LP;
-          ++size_lp;
-        }
+      std::vector<INDEX> new_ilp;
+      for (; no_ilp_factors_seen < external_solver.GetNumberOfFactors(); ++no_ilp_factors_seen)
+        new_ilp.push_back(this->factor_index(external_solver.GetFactor(no_ilp_factors_seen)));
+
+      for (const INDEX i : new_ilp) {
+        assert(factor_states[i] != State::ILP);
+        if (factor_states[i] == State::Active)
+          --size_active;
+        else
+          --size_lp;
+        factor_states[i] = State::ILP;
+        ++size_ilp;
       }
-      assert(size_lp + size_active + size_ilp == this->f_.size());
 
-      this->for_each_message([&](auto* m) {
-        auto* lf = m->GetLeftFactor();
-        auto* rf = m->GetRightFactor();
-        assert(factor_states.find(lf) != factor_states.end());
-        assert(factor_states.find(rf) != factor_states.end());
-        auto lfs = factor_states[lf];
-        auto rfs = factor_states[rf];
-        if (lfs == State::LP && rfs == State::ILP) {
-          factor_states[lf] = State::Active;
-          --size_lp;
-          ++size_active;
-        } else if (lfs == State::ILP && rfs == State::LP) {
-          factor_states[rf] = State::Active;
-          --size_lp;
-          ++size_active;
-        }
-      });
+      const auto new_active = expand_frontier(adjacency, new_ilp, [&](const INDEX j) { return factor_states[j] == State::LP; });
+      for (const INDEX j : new_active) {
+        factor_states[j] = State::Active;
+        --size_lp;
+        ++size_active;
+      }
       assert(size_lp + size_active + size_ilp == this->f_.size());
     };
 
-    // Initialize first ILP subproblem.
-    for (auto* f : this->f_)
-      factor_states[f] = State::Active;
+    // Initialize first ILP subproblem. All factors are checked, afterwards
+    // everything outside the ILP starts out as LP.
     update_partition(nullptr);
+    std::fill(factor_states.begin(), factor_states.end(), State::LP);
+    size_lp = this->f_.size(); size_active = 0; size_ilp = 0;
     update_states();
 
     // Iterate until convergence (dirty flag basically signals consistency).
@@ -186,12 +167,11 @@ public:
       // reduces the number of iterations.
       if (bridge_factor_optimization_arg_.getValue()) {
         INDEX bridge_count = external_solver.GetNumberOfFactors();
-        this->for_each_factor([&](auto* f) {
-        if (external_solver.has_factor(f))
-          if (f->no_messages() <= 2) // is bridging factor
-            for (auto& msg : f->get_messages())
-              external_solver.add_factor(msg.adjacent_factor);
-        });
+        for (INDEX i = 0; i < this->f_.size(); ++i)
+          if (factor_states[i] == State::ILP)
+            if (adjacency[i].size() <= 2) // is bridging factor
+              for (const auto& a : adjacency[i])
+                external_solver.add_factor(this->f_[a.adjacent_factor]);
         bridge_count = external_solver.GetNumberOfFactors() - bridge_count;
         std::cout << "CombiLP: Added " << bridge_count << " bridge factors." << std::endl;
         update_states();
@@ -203,10 +183,14 @@ public:
       this->for_each_message([&](auto* m) {
         auto* l = m->GetLeftFactor();
         auto* r = m->GetRightFactor();
-        if (external_solver.has_factor(l) && !external_solver.has_factor(r))
+        if (external_solver.has_factor(l) && !external_solver.has_factor(r)) {
           m->send_message_to_left();
-        if (!external_solver.has_factor(l) && external_solver.has_factor(r))
+          external_solver.update_costs(l);
+        }
+        if (!external_solver.has_factor(l) && external_solver.has_factor(r)) {
           m->send_message_to_right();
+          external_solver.update_costs(r);
+        }
       });
 #ifndef NDEBUG
       check_invariant();
@@ -283,10 +267,9 @@ public:
     // checked. Additionally to the normal `check_invariant` we just make sure
     // that the LP+Active region is really locally optimal.
     check_invariant(true);
-    for (auto* f : this->f_) {
-      assert(factor_states.find(f) != factor_states.end());
-      if (factor_states[f] != State::ILP)
-        assert(std::abs(f->LowerBound() - f->EvaluatePrimal()) <= eps);
+    for (INDEX i = 0; i < this->f_.size(); ++i) {
+      if (factor_states[i] != State::ILP)
+        assert(std::abs(this->f_[i]->LowerBound() - this->f_[i]->EvaluatePrimal()) <= eps);
     }
 #endif
   }
@@ -289,27 +289,28 @@ public:
 
    // return two possible variable states
    // branch on current primal vs. not current primal
-   void branch_left()
+   // With implicit origin the zero labeling has no explicit cost and cannot be forbidden, hence such factors do not support branching.
+   template<bool IO = IMPLICIT_ORIGIN>
+   std::enable_if_t<!IO> branch_left()
    {
-      // set cost of label associated not with primal to infinity, i.e. current label should always be taken
+      // set cost of labelings not associated with primal to infinity, i.e. current labeling should always be taken
       const INDEX labeling_no = LABELINGS::matching_labeling(primal_);
       assert(labeling_no < this->size());
       for(INDEX i=0; i<this->size(); ++i) {
-         (*this)[i] = std::numeric_limits<REAL>::infinity(); 
+         if(i != labeling_no) {
+            (*this)[i] = std::numeric_limits<REAL>::infinity(); 
+         }
       }
-      // also the zero labeling must be forbidden. How to do? IMPLICIT_ORIGIN must be dropped for this.
-      assert(false);
-      assert(!has_implicit_origin());
    }
 
-   void branch_right()
+   template<bool IO = IMPLICIT_ORIGIN>
+   std::enable_if_t<!IO> branch_right()
    {
       // set cost of primal label to infinity
       assert(EvaluatePrimal() < std::numeric_limits<REAL>::infinity());
       const INDEX labeling_no = LABELINGS::matching_labeling(primal_);
       assert(labeling_no < this->size());
       (*this)[labeling_no] = std::numeric_limits<REAL>::infinity();
-      assert(LowerBound() < std::numeric_limits<REAL>::infinity());
    }
 
    auto& primal() { return primal_; }
@@ -0,0 +1,471 @@
+#ifndef LP_MP_SHARED_PAIRWISE_FACTOR_HXX
+#define LP_MP_SHARED_PAIRWISE_FACTOR_HXX
+
+#include "config.hxx"
+#include "vector.hxx"
+#include "serialization.hxx"
+#include "message_arena.hxx"
+#include "min_convolution/min_convolution.hxx"
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <tuple>
+#include <vector>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+namespace LP_MP {
+
+// pairwise cost table that is shared by many pairwise factors, e.g. the Potts or truncated linear potentials of grid models.
+// Potts, (truncated) linear and (truncated) quadratic potentials are not stored explicitly; they are recognized by the factor to compute min-marginals with distance transforms.
+class pairwise_potential {
+public:
+   enum class type { general, potts, linear, truncated_linear, quadratic, truncated_quadratic };
+
+   // cost(x1,x2) = [x1 != x2]
+   static pairwise_potential potts(const INDEX dim1, const INDEX dim2)
+   {
+      return pairwise_potential(type::potts, dim1, dim2, 0.0);
+   }
+
+   // cost(x1,x2) = |x1 - x2|
+   static pairwise_potential linear(const INDEX dim1, const INDEX dim2)
+   {
+      return pairwise_potential(type::linear, dim1, dim2, 0.0);
+   }
+
+   // cost(x1,x2) = min(|x1 - x2|, truncation)
+   static pairwise_potential truncated_linear(const INDEX dim, const REAL truncation)
+   {
+      assert(truncation >= 0.0);
+      return pairwise_potential(type::truncated_linear, dim, dim, truncation);
+   }
+
+   // cost(x1,x2) = (x1 - x2)^2
+   static pairwise_potential quadratic(const INDEX dim1, const INDEX dim2)
+   {
+      return pairwise_potential(type::quadratic, dim1, dim2, 0.0);
+   }
+
+   // cost(x1,x2) = min((x1 - x2)^2, truncation)
+   static pairwise_potential truncated_quadratic(const INDEX dim, const REAL truncation)
+   {
+      assert(truncation >= 0.0);
+      return pairwise_potential(type::truncated_quadratic, dim, dim, truncation);
+   }
+
+   template<typename MATRIX>
+   static pairwise_potential general(const MATRIX& cost)
+   {
+      pairwise_potential p(type::general, cost.dim1(), cost.dim2(), 0.0);
+      p.cost_.resize(cost.dim1()*cost.dim2());
+      for(INDEX x1=0; x1<cost.dim1(); ++x1) {
+         for(INDEX x2=0; x2<cost.dim2(); ++x2) {
+            p.cost_[x1*cost.dim2() + x2] = cost(x1,x2);
+         }
+      }
+      return p;
+   }
+
+   REAL operator()(const INDEX x1, const INDEX x2) const
+   {
+      assert(x1 < dim1() && x2 < dim2());
+      const REAL d = x1 > x2 ? x1 - x2 : x2 - x1;
+      switch(type_) {
+         case type::potts: return x1 == x2 ? 0.0 : 1.0;
+         case type::linear: return d;
+         case type::truncated_linear: return std::min(d, truncation_);
+         case type::quadratic: return d*d;
+         case type::truncated_quadratic: return std::min(d*d, truncation_);
+         default: return cost_[x1*dim2_ + x2];
+      }
+   }
+
+   INDEX dim1() const { return dim1_; }
+   INDEX dim2() const { return dim2_; }
+   type potential_type() const { return type_; }
+   REAL truncation() const { return truncation_; }
+   const std::vector<REAL>& table() const { return cost_; }
+
+private:
+   pairwise_potential(const type t, const INDEX dim1, const INDEX dim2, const REAL truncation)
+      : type_(t), dim1_(dim1), dim2_(dim2), truncation_(truncation)
+   {
+      assert(dim1 > 0 && dim2 > 0);
+   }
+
+   type type_;
+   INDEX dim1_;
+   INDEX dim2_;
+   REAL truncation_;
+   std::vector<REAL> cost_; // only for general potentials, row-major
+};
+
+using shared_pairwise_potential = std::shared_ptr<const pairwise_potential>;
+
+// hands out reference counted potentials, identical potentials are created only once.
+// Not thread safe, meant to be used during problem construction.
+class pairwise_potential_pool {
+public:
+   shared_pairwise_potential potts(const INDEX dim1, const INDEX dim2)
+   {
+      return get(implicit_potentials_, std::make_tuple(pairwise_potential::type::potts, dim1, dim2, REAL(0.0)), [&]() { return pairwise_potential::potts(dim1, dim2); });
+   }
+
+   shared_pairwise_potential linear(const INDEX dim1, const INDEX dim2)
+   {
+      return get(implicit_potentials_, std::make_tuple(pairwise_potential::type::linear, dim1, dim2, REAL(0.0)), [&]() { return pairwise_potential::linear(dim1, dim2); });
+   }
+
+   shared_pairwise_potential truncated_linear(const INDEX dim, const REAL truncation)
+   {
+      return get(implicit_potentials_, std::make_tuple(pairwise_potential::type::truncated_linear, dim, dim, truncation), [&]() { return pairwise_potential::truncated_linear(dim, truncation); });
+   }
+
+   shared_pairwise_potential quadratic(const INDEX dim1, const INDEX dim2)
+   {
+      return get(implicit_potentials_, std::make_tuple(pairwise_potential::type::quadratic, dim1, dim2, REAL(0.0)), [&]() { return pairwise_potential::quadratic(dim1, dim2); });
+   }
+
+   shared_pairwise_potential truncated_quadratic(const INDEX dim, const REAL truncation)
+   {
+      return get(implicit_potentials_, std::make_tuple(pairwise_potential::type::truncated_quadratic, dim, dim, truncation), [&]() { return pairwise_potential::truncated_quadratic(dim, truncation); });
+   }
+
+   template<typename MATRIX>
+   shared_pairwise_potential general(const MATRIX& cost)
+   {
+      auto p = std::make_shared<const pairwise_potential>(pairwise_potential::general(cost));
+      std::size_t hash = std::hash<INDEX>()(p->dim1()) ^ (std::hash<INDEX>()(p->dim2()) << 1);
+      for(const REAL x : p->table()) {
+         hash ^= std::hash<REAL>()(x) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      }
+      auto& candidates = general_potentials_[hash];
+      for(const auto& c : candidates) {
+         if(c->dim1() == p->dim1() && c->dim2() == p->dim2() && c->table() == p->table()) { return c; }
+      }
+      candidates.push_back(p);
+      return p;
+   }
+
+   std::size_t size() const
+   {
+      std::size_t s = implicit_potentials_.size();
+      for(const auto& c : general_potentials_) { s += c.second.size(); }
+      return s;
+   }
+
+private:
+   using key_type = std::tuple<pairwise_potential::type, INDEX, INDEX, REAL>;
+
+   template<typename CONSTRUCTOR>
+   shared_pairwise_potential get(std::map<key_type, shared_pairwise_potential>& potentials, const key_type& key, CONSTRUCTOR construct)
+   {
+      auto it = potentials.find(key);
+      if(it == potentials.end()) {
+         it = potentials.insert({key, std::make_shared<const pairwise_potential>(construct())}).first;
+      }
+      return it->second;
+   }
+
+   std::map<key_type, shared_pairwise_potential> implicit_potentials_;
+   std::unordered_map<std::size_t, std::vector<shared_pairwise_potential>> general_potentials_;
+};
+
+// pairwise factor with cost scale*potential(x1,x2) + msg1(x1) + msg2(x2).
+// Only the reparametrization is held per factor, the cost table is shared. Memory per factor is O(dim1 + dim2) instead of O(dim1*dim2).
+// The reparametrization is either allocated per factor or, in arena mode, held in slots of two message arenas shared by all pairwise factors, one per variable resp. message type.
+// Copies always hold their own reparametrization.
+class shared_pairwise_factor {
+public:
+   shared_pairwise_factor(shared_pairwise_potential potential, const REAL scale = 1.0)
+      : potential_(std::move(potential)),
+      scale_(scale),
+      msg1_(potential_->dim1(), 0.0),
+      msg2_(potential_->dim2(), 0.0)
+   {
+      // distance transforms need convex cones/parabolas
+      assert(potential_->potential_type() == pairwise_potential::type::general || potential_->potential_type() == pairwise_potential::type::potts || scale_ >= 0.0);
+      init_primal();
+   }
+
+   shared_pairwise_factor(shared_pairwise_potential potential, const REAL scale, message_arena* arena1, message_arena* arena2)
+      : potential_(std::move(potential)),
+      scale_(scale),
+      arena_({arena1, arena2})
+   {
+      assert(arena1 != nullptr && arena2 != nullptr);
+      assert(potential_->potential_type() == pairwise_potential::type::general || potential_->potential_type() == pairwise_potential::type::potts || scale_ >= 0.0);
+      slot_[0] = arena1->add_slot(potential_->dim1());
+      slot_[1] = arena2->add_slot(potential_->dim2());
+      init_primal();
+   }
+
+   shared_pairwise_factor(const shared_pairwise_factor& o)
+      : potential_(o.potential_),
+      scale_(o.scale_),
+      msg1_(o.msg_values(0).begin(), o.msg_values(0).end()),
+      msg2_(o.msg_values(1).begin(), o.msg_values(1).end()),
+      primal_(o.primal_)
+   {}
+
+   shared_pairwise_factor& operator=(const shared_pairwise_factor& o)
+   {
+      assert(dim1() == o.dim1() && dim2() == o.dim2());
+      potential_ = o.potential_;
+      scale_ = o.scale_;
+      std::copy(o.msg_values(0).begin(), o.msg_values(0).end(), msg_values(0).begin());
+      std::copy(o.msg_values(1).begin(), o.msg_values(1).end(), msg_values(1).begin());
+      primal_ = o.primal_;
+      return *this;
+   }
+
+   INDEX dim1() const { return potential_->dim1(); }
+   INDEX dim2() const { return potential_->dim2(); }
+   INDEX size() const { return dim1()*dim2(); }
+
+   REAL scale() const { return scale_; }
+   const pairwise_potential& potential() const { return *potential_; }
+   bool arena_mode() const { return arena_[0] != nullptr; }
+
+   REAL& msg1(const INDEX x1) { assert(x1 < dim1()); return msg_values(0)[x1]; }
+   REAL msg1(const INDEX x1) const { assert(x1 < dim1()); return msg_values(0)[x1]; }
+   REAL& msg2(const INDEX x2) { assert(x2 < dim2()); return msg_values(1)[x2]; }
+   REAL msg2(const INDEX x2) const { assert(x2 < dim2()); return msg_values(1)[x2]; }
+
+   // contiguous reparametrization of first (i=0) resp. second (i=1) variable
+   message_arena::values msg_values(const INDEX i)
+   {
+      assert(i < 2);
+      if(arena_mode()) { return (*arena_[i])[slot_[i]]; }
+      auto& m = i == 0 ? msg1_ : msg2_;
+      return message_arena::values(m.begin(), m.end());
+   }
+   const message_arena::values msg_values(const INDEX i) const { return const_cast<shared_pairwise_factor*>(this)->msg_values(i); }
+
+   // the shared potential and the reparametrization are held outside the factor
+   void prefetch() const
+   {
+      simdpp::prefetch_read(potential_.get());
+      simdpp::prefetch_read(msg_values(0).begin());
+      simdpp::prefetch_read(msg_values(1).begin());
+   }
+
+   // reparametrized cost
+   REAL operator()(const INDEX x1, const INDEX x2) const { return scale_*(*potential_)(x1,x2) + msg1(x1) + msg2(x2); }
+
+   REAL LowerBound() const
+   {
+      const auto mm = min_marginal_1();
+      return mm.min();
+   }
+
+   // mm(x1) = min_x2 cost(x1,x2)
+   vector<REAL> min_marginal_1() const
+   {
+      vector<REAL> mm(dim1());
+      min_marginal(msg_values(0), msg_values(1), mm, false);
+      return mm;
+   }
+
+   // mm(x2) = min_x1 cost(x1,x2)
+   vector<REAL> min_marginal_2() const
+   {
+      vector<REAL> mm(dim2());
+      min_marginal(msg_values(1), msg_values(0), mm, true);
+      return mm;
+   }
+
+   REAL EvaluatePrimal() const
+   {
+      if(primal_[0] >= dim1() || primal_[1] >= dim2()) { return std::numeric_limits<REAL>::infinity(); }
+      return (*this)(primal_[0], primal_[1]);
+   }
+
+   void init_primal() { primal_ = {std::numeric_limits<INDEX>::max(), std::numeric_limits<INDEX>::max()}; }
+
+   void MaximizePotentialAndComputePrimal()
+   {
+      if(primal_[0] >= dim1() && primal_[1] >= dim2()) {
+         const auto mm = min_marginal_1();
+         primal_[0] = std::min_element(mm.begin(), mm.end()) - mm.begin();
+      }
+      if(primal_[0] < dim1() && primal_[1] >= dim2()) {
+         REAL min = std::numeric_limits<REAL>::infinity();
+         for(INDEX x2=0; x2<dim2(); ++x2) {
+            if((*this)(primal_[0],x2) < min) { min = (*this)(primal_[0],x2); primal_[1] = x2; }
+         }
+      } else if(primal_[0] >= dim1() && primal_[1] < dim2()) {
+         REAL min = std::numeric_limits<REAL>::infinity();
+         for(INDEX x1=0; x1<dim1(); ++x1) {
+            if((*this)(x1,primal_[1]) < min) { min = (*this)(x1,primal_[1]); primal_[0] = x1; }
+         }
+      }
+   }
+
+   std::array<INDEX,2>& primal() { return primal_; }
+   const std::array<INDEX,2>& primal() const { return primal_; }
+
+   template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(binary_data<REAL>(msg_values(0).begin(), dim1()), binary_data<REAL>(msg_values(1).begin(), dim2())); }
+   template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar(primal_[0], primal_[1]); }
+
+   // the external solver needs the full cost table, it is materialized on demand
+   auto export_variables() const
+   {
+      matrix<REAL> cost(dim1(), dim2());
+      for(INDEX x1=0; x1<dim1(); ++x1) {
+         for(INDEX x2=0; x2<dim2(); ++x2) {
+            cost(x1,x2) = (*this)(x1,x2);
+         }
+      }
+      return std::make_tuple(std::move(cost));
+   }
+
+   template<typename EXTERNAL_SOLVER, typename MATRIX>
+   void construct_constraints(EXTERNAL_SOLVER& s, MATRIX vars) const
+   {
+      s.add_simplex_constraint(vars.begin(), vars.end());
+   }
+
+   template<typename EXTERNAL_SOLVER, typename MATRIX>
+   void convert_primal(EXTERNAL_SOLVER& s, MATRIX vars)
+   {
+      for(INDEX x1=0; x1<dim1(); ++x1) {
+         for(INDEX x2=0; x2<dim2(); ++x2) {
+            if(s.solution(vars(x1,x2))) { primal_ = {x1,x2}; }
+         }
+      }
+   }
+
+private:
+   // mm(x) = own(x) + min_y scale*potential(x,y) + other(y), potential is accessed transposed if the marginalized variable is the second one.
+   // All implicit potentials are symmetric, their min-marginals are distance transforms of other.
+   template<typename VEC>
+   void min_marginal(const VEC& own, const VEC& other, vector<REAL>& mm, const bool transposed) const
+   {
+      switch(potential_->potential_type()) {
+         case pairwise_potential::type::potts:
+            min_convolution::potts_distance_transform(other, mm, scale_);
+            break;
+         case pairwise_potential::type::linear:
+            min_convolution::l1_distance_transform(other, mm, scale_);
+            break;
+         case pairwise_potential::type::truncated_linear:
+            min_convolution::truncated_l1_distance_transform(other, mm, scale_, potential_->truncation());
+            break;
+         case pairwise_potential::type::quadratic:
+            min_convolution::l2_distance_transform(other, mm, scale_);
+            break;
+         case pairwise_potential::type::truncated_quadratic:
+            min_convolution::truncated_l2_distance_transform(other, mm, scale_, potential_->truncation());
+            break;
+         default:
+            for(INDEX x=0; x<own.size(); ++x) {
+               REAL min = std::numeric_limits<REAL>::infinity();
+               for(INDEX y=0; y<other.size(); ++y) {
+                  const REAL c = transposed ? (*potential_)(y,x) : (*potential_)(x,y);
+                  min = std::min(min, scale_*c + other[y]);
+               }
+               mm[x] = min;
+            }
+      }
+      for(INDEX x=0; x<own.size(); ++x) { mm[x] += own[x]; }
+   }
+
+   shared_pairwise_potential potential_;
+   REAL scale_;
+   vector<REAL> msg1_; // empty in arena mode
+   vector<REAL> msg2_;
+   std::array<message_arena*,2> arena_ = {nullptr, nullptr};
+   std::array<INDEX,2> slot_;
+   std::array<INDEX,2> primal_;
+};
+
+// message between a unary factor (left) and a shared pairwise factor (right). VARIABLE_NO selects whether the unary corresponds to the first or second variable of the pairwise factor.
+// The unary factor must offer operator[], size() and primal() returning its label.
+template<INDEX VARIABLE_NO>
+class shared_pairwise_message {
+   static_assert(VARIABLE_NO == 0 || VARIABLE_NO == 1, "");
+public:
+   template<typename LEFT_FACTOR, typename MSG>
+   void RepamLeft(LEFT_FACTOR& l, const MSG& msg)
+   {
+      for(INDEX x=0; x<l.size(); ++x) { l[x] += msg[x]; }
+   }
+
+   template<typename RIGHT_FACTOR, typename MSG>
+   void RepamRight(RIGHT_FACTOR& r, const MSG& msg)
+   {
+      auto v = r.msg_values(VARIABLE_NO);
+      for(INDEX x=0; x<v.size(); ++x) { v[x] += msg[x]; }
+   }
+
+   template<typename RIGHT_FACTOR, typename MSG>
+   void send_message_to_left(const RIGHT_FACTOR& r, MSG& msg, const REAL omega)
+   {
+      auto mm = VARIABLE_NO == 0 ? r.min_marginal_1() : r.min_marginal_2();
+      const REAL min = mm.min();
+      for(INDEX x=0; x<mm.size(); ++x) { mm[x] -= min; }
+      msg -= omega*mm;
+   }
+
+   template<typename LEFT_FACTOR, typename MSG>
+   void send_message_to_right(const LEFT_FACTOR& l, MSG& msg, const REAL omega)
+   {
+      msg -= omega*l;
+   }
+
+   // all messages of a unary factor to its pairwise factors in one batch: the scaled unary is computed once and added to the contiguous reparametrizations of the pairwise factors.
+   template<typename LEFT_FACTOR, typename MSG_ITERATOR>
+   static void SendMessagesToRight(const LEFT_FACTOR& l, MSG_ITERATOR msg_begin, MSG_ITERATOR msg_end, const REAL omega)
+   {
+      INDEX no_messages = 0;
+      for(auto it=msg_begin; it!=msg_end; ++it) { ++no_messages; }
+      assert(no_messages > 0);
+      vector<REAL> delta(l.size());
+      const REAL w = omega/REAL(no_messages);
+      for(INDEX x=0; x<l.size(); ++x) { delta[x] = w*l[x]; }
+      for(auto it=msg_begin; it!=msg_end; ++it) { (*it) -= delta; }
+   }
+
+   template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+   void ComputeRightFromLeftPrimal(const LEFT_FACTOR& l, RIGHT_FACTOR& r)
+   {
+      r.primal()[VARIABLE_NO] = l.primal();
+   }
+
+   template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+   void ComputeLeftFromRightPrimal(LEFT_FACTOR& l, const RIGHT_FACTOR& r)
+   {
+      l.primal() = r.primal()[VARIABLE_NO];
+   }
+
+   template<typename LEFT_FACTOR, typename RIGHT_FACTOR>
+   bool CheckPrimalConsistency(const LEFT_FACTOR& l, const RIGHT_FACTOR& r) const
+   {
+      return l.primal() == r.primal()[VARIABLE_NO];
+   }
+
+   // unary label x is active iff one entry of the corresponding row (column) of the pairwise factor is active
+   template<typename EXTERNAL_SOLVER, typename LEFT_FACTOR, typename RIGHT_FACTOR, typename LEFT_VECTOR, typename RIGHT_MATRIX>
+   void construct_constraints(EXTERNAL_SOLVER& s, const LEFT_FACTOR& l, LEFT_VECTOR left_vars, const RIGHT_FACTOR& r, RIGHT_MATRIX right_vars) const
+   {
+      std::vector<typename EXTERNAL_SOLVER::variable> slice;
+      const INDEX n = VARIABLE_NO == 0 ? r.dim1() : r.dim2();
+      const INDEX m = VARIABLE_NO == 0 ? r.dim2() : r.dim1();
+      for(INDEX x=0; x<n; ++x) {
+         slice.clear();
+         for(INDEX y=0; y<m; ++y) {
+            slice.push_back(VARIABLE_NO == 0 ? right_vars(x,y) : right_vars(y,x));
+         }
+         auto one_active = s.add_at_most_one_constraint(slice.begin(), slice.end());
+         s.make_equal(left_vars[x], one_active);
+      }
+   }
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_SHARED_PAIRWISE_FACTOR_HXX
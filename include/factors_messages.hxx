@@ -25,6 +25,8 @@
 #include "MemoryPool.h"
 
 #include "memory_allocator.hxx"
+#include "spinlock.hxx"
+#include "profiling.hxx"
 
 #include "LP_MP.h"
 
@@ -74,8 +76,13 @@ LP_MP_FUNCTION_EXISTENCE_CLASS(HasMaximizePotentialAndComputePrimal, MaximizePot
 
 LP_MP_FUNCTION_EXISTENCE_CLASS(has_apply, apply)
 
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_branch_left, branch_left)
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_branch_right, branch_right)
+
 LP_MP_FUNCTION_EXISTENCE_CLASS(has_create_constraints, create_constraints)
 
+LP_MP_FUNCTION_EXISTENCE_CLASS(has_prefetch, prefetch)
+
 LP_MP_ASSIGNMENT_FUNCTION_EXISTENCE_CLASS(IsAssignable, operator[])
 }
 
@@ -215,6 +222,7 @@ struct MessageDispatcher
 
    static void ReceiveMessage(MSG_CONTAINER& t)
    {
+      LP_MP_PROFILE(receive_message, MSG_CONTAINER::messageNumber, sizeof(MSG_CONTAINER));
       auto staticMemberFunc = FuncGetter<MSG_CONTAINER>::GetReceiveFunc();
       (t.*staticMemberFunc)();
    }
@@ -229,6 +237,7 @@ struct MessageDispatcher
    constexpr static bool CanCallReceiveRestrictedMessage() { return FuncGetter<MSG_CONTAINER>::CanCallReceiveRestrictedMessage(); }
    static void ReceiveRestrictedMessage(MSG_CONTAINER& t)
    {
+      LP_MP_PROFILE(receive_message, MSG_CONTAINER::messageNumber, sizeof(MSG_CONTAINER));
       auto staticMemberFunc = FuncGetter<MSG_CONTAINER>::GetReceiveRestrictedFunc();
       (t.*staticMemberFunc)();
    }
@@ -241,6 +250,7 @@ struct MessageDispatcher
    template<typename FACTOR_TYPE>
    static void SendMessage(FACTOR_TYPE* f, MSG_CONTAINER& t, const REAL omega)
    {
+      LP_MP_PROFILE(send_message, MSG_CONTAINER::messageNumber, sizeof(MSG_CONTAINER));
       auto staticMemberFunc = FuncGetter<MSG_CONTAINER>::GetSendFunc();
       (t.*staticMemberFunc)(f, omega);
    }
@@ -273,6 +283,7 @@ struct MessageDispatcher
    template<typename FACTOR, typename MSG_ITERATOR>
    static void SendMessages(const FACTOR& f, MSG_ITERATOR msgs_begin, MSG_ITERATOR msgs_end, const REAL omega)
    {
+      LP_MP_PROFILE(send_messages, MSG_CONTAINER::messageNumber, std::distance(msgs_begin, msgs_end)*sizeof(MSG_CONTAINER));
       auto staticMemberFunc = FuncGetter<MSG_CONTAINER>::template GetSendMessagesFunc<FACTOR, MSG_ITERATOR>();
       (*staticMemberFunc)(f, msgs_begin, msgs_end, omega);
    }
@@ -407,6 +418,7 @@ public:
 
    static constexpr INDEX leftFactorNumber = LEFT_FACTOR_NO;
    static constexpr INDEX rightFactorNumber = RIGHT_FACTOR_NO;
+   static constexpr INDEX messageNumber = MESSAGE_NO;
 
    static constexpr INDEX no_left_factors() { return NO_OF_LEFT_FACTORS; }
    static constexpr INDEX no_right_factors() { return NO_OF_RIGHT_FACTORS; }
@@ -568,8 +580,8 @@ public:
    }
    void send_message_to_left_synchronized(RightFactorType* r, const REAL omega)
    {
-     auto& mtx = GetLeftFactor()->mutex_;
-     std::unique_lock<std::recursive_mutex> lck(mtx,std::defer_lock);
+     auto& mtx = GetLeftFactor()->mutex();
+     std::unique_lock<std::remove_reference_t<decltype(mtx)>> lck(mtx,std::defer_lock);
      if(lck.try_lock()) {
        msg_op_.send_message_to_left(*r, *static_cast<MessageContainerView<Chirality::right>*>(this), omega); 
      } else {
@@ -629,8 +641,8 @@ public:
    }
    void send_message_to_right_synchronized(LeftFactorType* l, const REAL omega)
    {
-     auto& mtx = GetRightFactor()->mutex_;
-     std::unique_lock<std::recursive_mutex> lck(mtx,std::defer_lock);
+     auto& mtx = GetRightFactor()->mutex();
+     std::unique_lock<std::remove_reference_t<decltype(mtx)>> lck(mtx,std::defer_lock);
      if(lck.try_lock()) {
        msg_op_.send_message_to_right(*l, *static_cast<MessageContainerView<Chirality::left>*>(this), omega); 
      } else {
@@ -960,7 +972,7 @@ public:
       // first lock as many adjacent factors as possible.
       auto lock_it = lock_rec.begin();
       for(auto it=msgs.begin(); it!=msgs.end(); ++it, ++lock_it) {
-        auto& mtx = (*it)->GetLeftFactor()->mutex_;
+        auto& mtx = (*it)->GetLeftFactor()->mutex();
         if(mtx.try_lock()) { // mark that factor was locked by this process
           *lock_it = true;
         } else {
@@ -983,7 +995,7 @@ public:
       lock_it = lock_rec.begin();
       for(auto it=msgs.begin(); it!=msgs.end(); ++it, ++lock_it) {
         if(*lock_it) {
-          (*it)->GetLeftFactor()->mutex_.unlock();
+          (*it)->GetLeftFactor()->mutex().unlock();
         }
       }
       assert(lock_it+1 == lock_rec.end());
@@ -1070,7 +1082,7 @@ public:
       // first lock as many adjacent factors as possible.
       auto lock_it = lock_rec.begin();
       for(auto it=msgs.begin(); it!=msgs.end(); ++it, ++lock_it) {
-        if((*it)->GetRightFactor()->mutex_.try_lock()) { // mark that factor was locked by this process
+        if((*it)->GetRightFactor()->mutex().try_lock()) { // mark that factor was locked by this process
           *lock_it = true;
         } else {
           *lock_it = false; 
@@ -1092,7 +1104,7 @@ public:
       lock_it = lock_rec.begin();
       for(auto it=msgs.begin(); it!=msgs.end(); ++it, ++lock_it) {
         if(*lock_it) {
-          (*it)->GetRightFactor()->mutex_.unlock();
+          (*it)->GetRightFactor()->mutex().unlock();
         }
       }
       assert(lock_it+1 == lock_rec.end());
@@ -2098,6 +2110,12 @@ struct message_container_selector {
 };
 
 
+// lock of a factor in parallel mode: a 4 byte recursive spinlock by default. Factor types may choose another one by declaring synchronization_type,
+// e.g. std::recursive_mutex, or striped_lock<N> for very many small factors, which then hold no lock at all.
+template<typename FACTOR, typename = void>
+struct factor_synchronization { using type = recursive_spinlock; };
+template<typename FACTOR>
+struct factor_synchronization<FACTOR, std::void_t<typename FACTOR::synchronization_type>> { using type = typename FACTOR::synchronization_type; };
 
 // container class for factors. Here we hold the factor, all connected messages, reparametrization storage and perform reparametrization and coordination for sending and receiving messages.
 // derives from REPAM_STORAGE_TYPE to mixin a class for storing the reparametrized potential
@@ -2114,7 +2132,9 @@ class FactorContainer : public FactorTypeAdapter
 public:
    using FactorContainerType = FactorContainer<FACTOR_TYPE, FACTOR_MESSAGE_TRAIT, FACTOR_NO, COMPUTE_PRIMAL_SOLUTION>;
    using FactorType = FACTOR_TYPE;
+   static constexpr INDEX factorNumber = FACTOR_NO;
    using FMC = FACTOR_MESSAGE_TRAIT;
+   using synchronization_type = typename factor_synchronization<FactorType>::type;
 
    // do zrobienia: templatize cosntructor to allow for more general initialization of reparametrization storage and factor
    template<typename ...ARGS>
@@ -2211,12 +2231,14 @@ public:
 
    void update_factor_uniform(const REAL leave_weight) final
    {
+       LP_MP_PROFILE(update_factor, FACTOR_NO, dual_size_in_bytes());
        receive_messages();
        MaximizePotential();
        send_messages(leave_weight);
    }
    void UpdateFactor(const weight_slice omega, const receive_slice receive_mask) final
    {
+      LP_MP_PROFILE(update_factor, FACTOR_NO, dual_size_in_bytes());
       ReceiveMessages(receive_mask);
       MaximizePotential();
       SendMessages(omega);
@@ -2224,13 +2246,30 @@ public:
 
    void update_factor_adaptive(const weight_slice omega, const receive_slice receive_mask) final
    {
+      LP_MP_PROFILE(update_factor, FACTOR_NO, dual_size_in_bytes());
       ReceiveMessages(receive_mask);
       MaximizePotential();
       send_messages_with_adaptive_weights(omega); 
    }
 
+   // prefetch data read by the next update: the factor's own data if it offers prefetch, all attached messages and the adjacent factor containers. The container itself should already be in cache.
+   void prefetch() final
+   {
+      if constexpr(FunctionExistence::has_prefetch<FactorType, void>()) {
+         factor_.prefetch();
+      }
+      meta::for_each(MESSAGE_DISPATCHER_TYPELIST{}, [this](auto l) {
+            constexpr INDEX n = FactorContainerType::FindMessageDispatcherTypeIndex<decltype(l)>();
+            for(auto it = std::get<n>(msg_).begin(); it != std::get<n>(msg_).end(); ++it) {
+               simdpp::prefetch_read(&*it);
+               simdpp::prefetch_read(l.get_adjacent_factor(*it));
+            }
+      });
+   }
+
    void update_factor_residual(const weight_slice omega, const receive_slice receive_mask) final
    {
+      LP_MP_PROFILE(update_factor, FACTOR_NO, dual_size_in_bytes());
       assert(*std::min_element(omega.begin(), omega.end()) >= 0.0);
       assert(*std::max_element(omega.begin(), omega.end()) <= 1.0+eps);
       assert(std::distance(omega.begin(), omega.end()) == no_send_messages());
@@ -2246,7 +2285,7 @@ public:
       assert(*std::min_element(omega.begin(), omega.end()) >= 0.0);
       assert(std::accumulate(omega.begin(), omega.end(), 0.0) <= 1.0 + eps);
       assert(std::distance(omega.begin(), omega.end()) == no_send_messages());
-      std::lock_guard<std::recursive_mutex> lock(mutex_); // only here do we wait for the mutex. In all other places try_lock is allowed only
+      std::lock_guard<std::remove_reference_t<decltype(mutex())>> lock(mutex()); // only here do we wait for the mutex. In all other places try_lock is allowed only
       ReceiveMessagesSynchronized(omega);
       MaximizePotential();
       SendMessagesSynchronized(omega);
@@ -2294,8 +2333,9 @@ public:
 
    void UpdateFactorPrimal(const weight_slice& omega, const receive_slice& receive_mask, INDEX primal_access) final
    {
+     LP_MP_PROFILE(update_factor_primal, FACTOR_NO, dual_size_in_bytes());
 #ifdef LP_MP_PARALLEL
-     std::lock_guard<std::recursive_mutex> lock(mutex_); // only here do we wait for the mutex. In all other places try_lock is allowed only
+     std::lock_guard<std::remove_reference_t<decltype(mutex())>> lock(mutex()); // only here do we wait for the mutex. In all other places try_lock is allowed only
 #endif
       assert(primal_access > 0); // otherwise primal is not initialized in first iteration
       conditionally_init_primal(primal_access);
@@ -2337,6 +2377,7 @@ public:
 
    void MaximizePotential()
    {
+       LP_MP_PROFILE(maximize_potential, FACTOR_NO, dual_size_in_bytes());
        if constexpr(CanMaximizePotential()) {
            factor_.MaximizePotential();
        }
@@ -3119,6 +3160,31 @@ public:
       return d.dot_product(); 
    }
 
+   // branching splits the factor's feasible set into the current primal (left) and everything else (right)
+   constexpr static bool can_branch_constexpr()
+   {
+      return FunctionExistence::has_branch_left<FactorType, void>() && FunctionExistence::has_branch_right<FactorType, void>();
+   }
+   virtual bool can_branch() const final { return can_branch_constexpr(); }
+
+   virtual void branch_left() final
+   {
+      if constexpr(can_branch_constexpr()) {
+         factor_.branch_left();
+      } else {
+         assert(false);
+      }
+   }
+
+   virtual void branch_right() final
+   {
+      if constexpr(can_branch_constexpr()) {
+         factor_.branch_right();
+      } else {
+         assert(false);
+      }
+   }
+
    virtual void serialize_dual(load_archive& ar) final
    { factor_.serialize_dual(ar); }
    virtual void serialize_primal(load_archive& ar) final
@@ -3365,12 +3431,15 @@ private:
    msg_storage_type msg_;
 
 #ifdef LP_MP_PARALLEL
-   // a recursive mutex is required only for SendMessagesTo{Left|Right}, as multiple messages may be have the same endpoints. Then the corresponding lock is acquired multiple times.
+   // a recursive lock is required only for SendMessagesTo{Left|Right}, as multiple messages may be have the same endpoints. Then the corresponding lock is acquired multiple times.
    // if no two messages have the same endpoints, an ordinary mutex is enough.
-   std::recursive_mutex mutex_;
+   lock_holder<synchronization_type> mutex_;
 #endif
 
 public:
+#ifdef LP_MP_PARALLEL
+   auto& mutex() { return mutex_.get(factor_index()); }
+#endif
 
    // functions for interfacing with external solver interface DD_ILP
 
@@ -0,0 +1,56 @@
+#ifndef LP_MP_MAPPED_FILE_HXX
+#define LP_MP_MAPPED_FILE_HXX
+
+#include <string>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace LP_MP {
+
+// read-only memory mapping of a whole file. Pages are loaded lazily by the kernel, hence large inputs can be processed without copying them into user space first.
+class mapped_file {
+public:
+   mapped_file(const std::string& filename)
+   {
+      fd_ = ::open(filename.c_str(), O_RDONLY);
+      if(fd_ == -1) { throw std::runtime_error("could not open " + filename); }
+      struct stat st;
+      if(::fstat(fd_, &st) == -1) {
+         ::close(fd_);
+         throw std::runtime_error("could not determine size of " + filename);
+      }
+      size_ = st.st_size;
+      if(size_ > 0) {
+         void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+         if(p == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("could not memory map " + filename);
+         }
+         ::madvise(p, size_, MADV_SEQUENTIAL);
+         data_ = static_cast<const char*>(p);
+      }
+   }
+   ~mapped_file()
+   {
+      if(data_ != nullptr) { ::munmap(const_cast<char*>(data_), size_); }
+      if(fd_ != -1) { ::close(fd_); }
+   }
+   mapped_file(const mapped_file&) = delete;
+   mapped_file& operator=(const mapped_file&) = delete;
+
+   const char* begin() const { return data_; }
+   const char* end() const { return data_ + size_; }
+   std::size_t size() const { return size_; }
+
+private:
+   int fd_ = -1;
+   const char* data_ = nullptr;
+   std::size_t size_ = 0;
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_MAPPED_FILE_HXX
@@ -8,6 +8,9 @@
 #include <mutex>
 #include "config.hxx"
 #include "spinlock.hxx"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* 
    allocators using a stack and a more general one using a variable size list of stacks for allocating memory for factors and messages.
@@ -570,10 +573,13 @@ template<typename T>
 		//check the signature
 		int sign = stack_arena::block_sign(P);
 		if (sign == sign_block_used){//allocated by stack_arena
-			assert(!buffers.empty());
 			size_t cap = stack_arena::block_size(P)*sizeof(int);
 			current_used -= cap;
 			assert(current_used >= 0);
+			if (buffers.empty()){//block comes from another allocator
+				stack_arena::block_sign(P) = sign_block_unused;
+				return;
+         }
 			//does not matter if cP is not from the top buffer (or even from other allocator) -- in that case it will only be marked for deallocation
 			buffers.back().deallocate((int*) vP, 1000000000000);
 			//if (buffers.back().deallocate((T*) vP, 1000000000000)){//returns 1 when need to clean
@@ -701,6 +707,28 @@ std::array<block_allocator<REAL>, no_stack_allocators> make_block_allocator_arra
 static std::array<block_allocator<REAL>, no_stack_allocators> global_real_block_allocator_array ( make_block_allocator_array(global_real_block_arena_array, std::make_integer_sequence<size_t,no_stack_allocators>{} ) ) ;
 
 static thread_local INDEX stack_allocator_index = 0;
+
+// number of the calling thread in the current OpenMP team, 0 when compiled without OpenMP
+inline INDEX thread_index()
+{
+#ifdef _OPENMP
+   return omp_get_thread_num();
+#else
+   return 0;
+#endif
+}
+
+// let the current thread allocate from arena i (modulo the number of arenas) until the end of the scope, e.g. with i = thread_index() in parallel construction loops.
+// Blocks may be deallocated from another arena afterwards, they are then only marked unused.
+class stack_allocator_scope {
+public:
+   stack_allocator_scope(const INDEX i) : prev_index_(stack_allocator_index) { stack_allocator_index = i % no_stack_allocators; }
+   ~stack_allocator_scope() { stack_allocator_index = prev_index_; }
+   stack_allocator_scope(const stack_allocator_scope&) = delete;
+   stack_allocator_scope& operator=(const stack_allocator_scope&) = delete;
+private:
+   const INDEX prev_index_;
+};
 // do zrobienia: both above allocators do not destroy their arenas
 } // end namespace LP_MP
 
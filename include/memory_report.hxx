@@ -0,0 +1,82 @@
+#ifndef LP_MP_MEMORY_REPORT_HXX
+#define LP_MP_MEMORY_REPORT_HXX
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstddef>
+
+namespace LP_MP {
+
+// bytes attributed to parts of the solver: factors and messages per type, weights and receive masks, orderings, tree decompositions and tightening structures.
+// Entries are grouped by subsystem; adding an entry with existing subsystem and name accumulates.
+// Sizes of objects count their own size plus the heap memory they hold directly, allocator overhead is not counted.
+class memory_report {
+public:
+   struct entry {
+      std::string subsystem;
+      std::string name;
+      std::size_t count;
+      std::size_t bytes;
+   };
+
+   void add(const std::string& subsystem, const std::string& name, const std::size_t count, const std::size_t bytes)
+   {
+      auto it = std::find_if(entries_.begin(), entries_.end(), [&](const entry& e) { return e.subsystem == subsystem && e.name == name; });
+      if(it != entries_.end()) {
+         it->count += count;
+         it->bytes += bytes;
+      } else {
+         entries_.push_back({subsystem, name, count, bytes});
+      }
+   }
+
+   const std::vector<entry>& entries() const { return entries_; }
+
+   std::size_t total() const
+   {
+      std::size_t t = 0;
+      for(const auto& e : entries_) { t += e.bytes; }
+      return t;
+   }
+
+   std::size_t subsystem_total(const std::string& subsystem) const
+   {
+      std::size_t t = 0;
+      for(const auto& e : entries_) { if(e.subsystem == subsystem) { t += e.bytes; } }
+      return t;
+   }
+
+   // global block arenas holding factors and their vectors, reported separately as their memory is already attributed above
+   std::size_t arena_used = 0;
+   std::size_t arena_reserved = 0;
+   std::size_t arena_peak_reserved = 0;
+
+   void print(std::ostream& s) const
+   {
+      const double MB = 1024.0*1024.0;
+      const auto flags = s.flags();
+      const auto precision = s.precision();
+      s << std::left << std::setw(20) << "subsystem" << std::setw(24) << "name" << std::right << std::setw(12) << "count" << std::setw(12) << "MB" << "\n";
+      s << std::fixed << std::setprecision(2);
+      for(const auto& e : entries_) {
+         s << std::left << std::setw(20) << e.subsystem << std::setw(24) << e.name << std::right << std::setw(12) << e.count << std::setw(12) << e.bytes/MB << "\n";
+      }
+      s << std::left << std::setw(44) << "total" << std::right << std::setw(24) << total()/MB << "\n";
+      s << "block arenas: used " << arena_used/MB << " MB, reserved " << arena_reserved/MB << " MB, peak reserved " << arena_peak_reserved/MB << " MB\n";
+      s.flags(flags);
+      s.precision(precision);
+   }
+
+private:
+   std::vector<entry> entries_;
+};
+
+template<typename T>
+std::size_t memory_in_bytes(const std::vector<T>& v) { return v.capacity()*sizeof(T); }
+
+} // end namespace LP_MP
+
+#endif // LP_MP_MEMORY_REPORT_HXX
@@ -0,0 +1,58 @@
+#ifndef LP_MP_MESSAGE_ARENA_HXX
+#define LP_MP_MESSAGE_ARENA_HXX
+
+#include "config.hxx"
+#include "two_dimensional_variable_array.hxx"
+#include <vector>
+#include <mutex>
+#include <cassert>
+
+namespace LP_MP {
+
+// dual values of all messages of one type held in one contiguous buffer (structure of arrays) instead of separately allocated per factor.
+// Message i occupies positions [offset(i), offset(i+1)) of the buffer, hence messages added consecutively are adjacent in memory and batched updates run over contiguous memory.
+// Slots are referred to by index: adding slots may reallocate the buffer, so factors must not keep pointers into it. The arena must outlive all factors holding slots in it.
+class message_arena {
+public:
+   using values = two_dim_variable_array<REAL>::ArrayAccessObject;
+
+   message_arena() : offsets_(1, 0) {}
+   message_arena(const message_arena&) = delete;
+   message_arena& operator=(const message_arena&) = delete;
+
+   void reserve(const INDEX no_slots, const std::size_t no_values)
+   {
+      offsets_.reserve(no_slots+1);
+      values_.reserve(no_values);
+   }
+
+   // add slot of given size initialized to zero and return its index. Slots may be added concurrently, e.g. when factors are constructed in parallel; their order is then not deterministic.
+   INDEX add_slot(const INDEX size)
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      const INDEX slot = no_slots();
+      values_.resize(values_.size() + size, 0.0);
+      offsets_.push_back(values_.size());
+      return slot;
+   }
+
+   INDEX no_slots() const { return offsets_.size()-1; }
+   std::size_t no_values() const { return values_.size(); }
+   std::size_t offset(const INDEX slot) const { assert(slot <= no_slots()); return offsets_[slot]; }
+   INDEX size(const INDEX slot) const { assert(slot < no_slots()); return offsets_[slot+1] - offsets_[slot]; }
+
+   REAL* data(const INDEX slot) { assert(slot < no_slots()); return values_.data() + offsets_[slot]; }
+   const REAL* data(const INDEX slot) const { assert(slot < no_slots()); return values_.data() + offsets_[slot]; }
+
+   values operator[](const INDEX slot) { return values(data(slot), data(slot) + size(slot)); }
+   const values operator[](const INDEX slot) const { return values(const_cast<REAL*>(data(slot)), const_cast<REAL*>(data(slot)) + size(slot)); }
+
+private:
+   std::vector<std::size_t> offsets_;
+   std::vector<REAL> values_;
+   std::mutex mutex_;
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_MESSAGE_ARENA_HXX
@@ -0,0 +1,218 @@
+#ifndef LP_MP_MIN_CONVOLUTION_HXX
+#define LP_MP_MIN_CONVOLUTION_HXX
+
+#include "config.hxx"
+#include <vector>
+#include <tuple>
+#include <queue>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// kernels for min-sum convolutions and distance transforms, used for computing min-marginals of structured pairwise potentials.
+//
+// Distance transforms: given f of size m, compute out[x] = min_y f[y] + d(x,y) for x < out.size() in time O(m + out.size()), see
+//    Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions", Theory of Computing 2012.
+// Min-sum convolution: c[k] = min_{i+j=k} a[i] + b[j], see
+//    Bussieck, Hassler, Woeginger and Zimmermann, "Fast algorithms for the maximum convolution problem", Operations Research Letters 1994.
+
+namespace LP_MP {
+namespace min_convolution {
+
+   // d(x,y) = w*[x != y], any sign of w
+   template<typename VEC_IN, typename VEC_OUT>
+   void potts_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w)
+   {
+      REAL min1 = std::numeric_limits<REAL>::infinity();
+      REAL min2 = std::numeric_limits<REAL>::infinity();
+      std::size_t argmin = 0;
+      for(std::size_t y=0; y<f.size(); ++y) {
+         if(f[y] < min1) {
+            min2 = min1;
+            min1 = f[y];
+            argmin = y;
+         } else if(f[y] < min2) {
+            min2 = f[y];
+         }
+      }
+      for(std::size_t x=0; x<out.size(); ++x) {
+         const REAL off_diagonal = (x == argmin ? min2 : min1) + w;
+         const REAL diagonal = x < f.size() ? f[x] : std::numeric_limits<REAL>::infinity();
+         out[x] = std::min(diagonal, off_diagonal);
+      }
+   }
+
+   // d(x,y) = w*|x-y|, w >= 0. Forward and backward pass, no scratch memory needed.
+   template<typename VEC_IN, typename VEC_OUT>
+   void l1_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w)
+   {
+      assert(w >= 0.0);
+      const std::size_t m = f.size();
+      const std::size_t n = out.size();
+      const std::size_t N = std::max(n,m);
+      REAL r = std::numeric_limits<REAL>::infinity();
+      for(std::size_t y=0; y<N; ++y) {
+         r = std::min(r + w, y < m ? REAL(f[y]) : std::numeric_limits<REAL>::infinity());
+         if(y < n) { out[y] = r; }
+      }
+      r = std::numeric_limits<REAL>::infinity();
+      for(std::size_t y=N; y-- > 0;) {
+         r = std::min(r + w, y < m ? REAL(f[y]) : std::numeric_limits<REAL>::infinity());
+         if(y < n) { out[y] = std::min(REAL(out[y]), r); }
+      }
+   }
+
+   // d(x,y) = w*(x-y)^2, w >= 0. Lower envelope of parabolas rooted at the finite entries of f.
+   template<typename VEC_IN, typename VEC_OUT>
+   void l2_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w)
+   {
+      assert(w >= 0.0);
+      if(w == 0.0) {
+         const REAL min = f.size() > 0 ? *std::min_element(f.begin(), f.end()) : std::numeric_limits<REAL>::infinity();
+         for(std::size_t x=0; x<out.size(); ++x) { out[x] = min; }
+         return;
+      }
+
+      std::vector<std::size_t> v; // roots of parabolas in lower envelope
+      std::vector<REAL> z; // boundaries between parabolas
+      v.reserve(f.size());
+      z.reserve(f.size()+1);
+      auto intersection = [&](const std::size_t q, const std::size_t p) {
+         return ((f[q] + w*REAL(q)*REAL(q)) - (f[p] + w*REAL(p)*REAL(p))) / (2.0*w*(REAL(q) - REAL(p)));
+      };
+      for(std::size_t q=0; q<f.size(); ++q) {
+         if(!std::isfinite(f[q])) { continue; }
+         if(v.empty()) {
+            v.push_back(q);
+            z.push_back(-std::numeric_limits<REAL>::infinity());
+            continue;
+         }
+         REAL s = intersection(q, v.back());
+         while(s <= z.back()) {
+            v.pop_back();
+            z.pop_back();
+            if(v.empty()) { break; }
+            s = intersection(q, v.back());
+         }
+         if(v.empty()) {
+            z.push_back(-std::numeric_limits<REAL>::infinity());
+         } else {
+            z.push_back(s);
+         }
+         v.push_back(q);
+      }
+
+      if(v.empty()) {
+         for(std::size_t x=0; x<out.size(); ++x) { out[x] = std::numeric_limits<REAL>::infinity(); }
+         return;
+      }
+      z.push_back(std::numeric_limits<REAL>::infinity());
+      std::size_t k = 0;
+      for(std::size_t x=0; x<out.size(); ++x) {
+         while(z[k+1] < REAL(x)) { ++k; }
+         const REAL d = REAL(x) - REAL(v[k]);
+         out[x] = w*d*d + f[v[k]];
+      }
+   }
+
+   // d(x,y) = min(d'(x,y), w*truncation) for a distance transform d' computed already in out
+   template<typename VEC_IN, typename VEC_OUT>
+   void truncate_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w, const REAL truncation)
+   {
+      const REAL min = f.size() > 0 ? *std::min_element(f.begin(), f.end()) : std::numeric_limits<REAL>::infinity();
+      const REAL truncated = min + w*truncation;
+      for(std::size_t x=0; x<out.size(); ++x) {
+         out[x] = std::min(REAL(out[x]), truncated);
+      }
+   }
+
+   // d(x,y) = w*min(|x-y|, truncation)
+   template<typename VEC_IN, typename VEC_OUT>
+   void truncated_l1_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w, const REAL truncation)
+   {
+      l1_distance_transform(f, out, w);
+      truncate_distance_transform(f, out, w, truncation);
+   }
+
+   // d(x,y) = w*min((x-y)^2, truncation)
+   template<typename VEC_IN, typename VEC_OUT>
+   void truncated_l2_distance_transform(const VEC_IN& f, VEC_OUT& out, const REAL w, const REAL truncation)
+   {
+      l2_distance_transform(f, out, w);
+      truncate_distance_transform(f, out, w, truncation);
+   }
+
+   // c[k] = min_{i+j=k} a[i] + b[j], O(|a|*|b|)
+   template<typename ITERATOR>
+   std::vector<REAL> min_conv_naive(ITERATOR a_begin, ITERATOR a_end, ITERATOR b_begin, ITERATOR b_end)
+   {
+      const std::size_t a_size = std::distance(a_begin, a_end);
+      const std::size_t b_size = std::distance(b_begin, b_end);
+      assert(a_size > 0 && b_size > 0);
+      std::vector<REAL> c(a_size + b_size - 1, std::numeric_limits<REAL>::infinity());
+      for(std::size_t i=0; i<a_size; ++i) {
+         for(std::size_t j=0; j<b_size; ++j) {
+            c[i+j] = std::min(c[i+j], REAL(a_begin[i] + b_begin[j]));
+         }
+      }
+      return c;
+   }
+
+   // Bussieck et al.: visit pairs (i,j) in order of increasing a[i] + b[j] by walking through the sorted sequences. The first pair reaching an entry k of the result is optimal for it.
+   // Only entries k < result_size are computed. Returns values and for each entry the indices of a and b attaining it.
+   template<typename ITERATOR>
+   std::tuple<std::vector<REAL>, std::vector<INDEX>, std::vector<INDEX>>
+   arg_min_conv_Bussieck_et_al(ITERATOR a_begin, ITERATOR a_end, ITERATOR b_begin, ITERATOR b_end, const std::size_t result_size)
+   {
+      const std::size_t a_size = std::distance(a_begin, a_end);
+      const std::size_t b_size = std::distance(b_begin, b_end);
+      assert(a_size > 0 && b_size > 0);
+
+      std::vector<REAL> c(result_size, std::numeric_limits<REAL>::infinity());
+      std::vector<INDEX> c_a(result_size, std::numeric_limits<INDEX>::max());
+      std::vector<INDEX> c_b(result_size, std::numeric_limits<INDEX>::max());
+      const std::size_t no_reachable = std::min(result_size, a_size + b_size - 1); // entries k with some i+j = k
+
+      std::vector<INDEX> a_sorted(a_size);
+      std::iota(a_sorted.begin(), a_sorted.end(), 0);
+      std::sort(a_sorted.begin(), a_sorted.end(), [&](const INDEX i, const INDEX j) { return a_begin[i] < a_begin[j]; });
+      std::vector<INDEX> b_sorted(b_size);
+      std::iota(b_sorted.begin(), b_sorted.end(), 0);
+      std::sort(b_sorted.begin(), b_sorted.end(), [&](const INDEX i, const INDEX j) { return b_begin[i] < b_begin[j]; });
+
+      // pairs of positions in sorted sequences, ordered by sum of values. Each pair (p,q) is generated once: from (p,q-1), or from (p-1,0) if q == 0.
+      using pair_type = std::tuple<REAL, INDEX, INDEX>;
+      std::priority_queue<pair_type, std::vector<pair_type>, std::greater<pair_type>> queue;
+      auto push = [&](const INDEX p, const INDEX q) { queue.push({REAL(a_begin[a_sorted[p]] + b_begin[b_sorted[q]]), p, q}); };
+      push(0,0);
+      std::size_t no_filled = 0;
+      while(no_filled < no_reachable && !queue.empty()) {
+         const auto [val, p, q] = queue.top();
+         queue.pop();
+         const INDEX i = a_sorted[p];
+         const INDEX j = b_sorted[q];
+         const std::size_t k = i + j;
+         if(k < result_size && c_a[k] == std::numeric_limits<INDEX>::max()) {
+            c[k] = val;
+            c_a[k] = i;
+            c_b[k] = j;
+            ++no_filled;
+         }
+         if(q+1 < b_size) { push(p, q+1); }
+         if(q == 0 && p+1 < a_size) { push(p+1, 0); }
+      }
+      return {c, c_a, c_b};
+   }
+
+   template<typename ITERATOR>
+   std::vector<REAL> min_conv_Bussieck_et_al(ITERATOR a_begin, ITERATOR a_end, ITERATOR b_begin, ITERATOR b_end)
+   {
+      const std::size_t result_size = std::distance(a_begin, a_end) + std::distance(b_begin, b_end) - 1;
+      return std::get<0>(arg_min_conv_Bussieck_et_al(a_begin, a_end, b_begin, b_end, result_size));
+   }
+
+} // end namespace min_convolution
+} // end namespace LP_MP
+
+#endif // LP_MP_MIN_CONVOLUTION_HXX
@@ -0,0 +1,115 @@
+#ifndef LP_MP_PACKED_MASK_ARRAY_HXX
+#define LP_MP_PACKED_MASK_ARRAY_HXX
+
+#include "config.hxx"
+#include <vector>
+#include <iterator>
+#include <cstdint>
+#include <cassert>
+
+namespace LP_MP {
+
+// two-dimensional array of booleans with variable second dimension, like two_dim_variable_array<unsigned char>, but holding one bit per entry.
+// Row i occupies bits [offset(i), offset(i+1)) of consecutive 64 bit words. All bits are initially zero.
+// An array constructed as full holds no bits at all and all its entries are one, this is the mask of modes in which every message is received.
+// Slices are read-only views; entries are written with set, which must not be called concurrently for rows sharing a word.
+class packed_mask_array {
+public:
+   static constexpr std::size_t word_bits = 64;
+
+   class slice {
+   public:
+      slice(const std::uint64_t* words, const std::size_t begin, const INDEX size) : words_(words), begin_(begin), size_(size) {}
+
+      unsigned char operator[](const INDEX i) const
+      {
+         assert(i < size());
+         if(words_ == nullptr) { return 1; }
+         const std::size_t b = begin_ + i;
+         return (words_[b / word_bits] >> (b % word_bits)) & 1;
+      }
+      INDEX size() const { return size_; }
+      bool full() const { return words_ == nullptr; }
+
+      struct iterator {
+         using iterator_category = std::forward_iterator_tag;
+         using value_type = unsigned char;
+         using difference_type = std::ptrdiff_t;
+         using pointer = const unsigned char*;
+         using reference = unsigned char;
+
+         iterator(const slice* s, const INDEX i) : s_(s), i_(i) {}
+         unsigned char operator*() const { return (*s_)[i_]; }
+         iterator& operator++() { ++i_; return *this; }
+         iterator operator++(int) { iterator it = *this; ++i_; return it; }
+         bool operator==(const iterator& o) const { return i_ == o.i_; }
+         bool operator!=(const iterator& o) const { return i_ != o.i_; }
+         const slice* s_;
+         INDEX i_;
+      };
+
+      iterator begin() const { return iterator(this, 0); }
+      iterator end() const { return iterator(this, size()); }
+
+   private:
+      const std::uint64_t* words_; // nullptr for full masks
+      std::size_t begin_;
+      INDEX size_;
+   };
+
+   packed_mask_array() : offsets_(1, 0) {}
+   packed_mask_array(const std::vector<INDEX>& dimensions, const bool full = false)
+   {
+      offsets_.reserve(dimensions.size()+1);
+      offsets_.push_back(0);
+      for(const INDEX d : dimensions) { offsets_.push_back(offsets_.back() + d); }
+      if(!full) {
+         words_.resize((offsets_.back() + word_bits - 1) / word_bits, 0);
+      }
+      full_ = full;
+   }
+
+   INDEX size() const { return offsets_.size()-1; }
+   bool full() const { return full_; }
+   std::size_t no_words() const { return words_.size(); }
+   std::size_t memory() const { return offsets_.capacity()*sizeof(std::size_t) + words_.capacity()*sizeof(std::uint64_t); }
+
+   slice operator[](const INDEX i) const
+   {
+      assert(i < size());
+      return slice(full_ ? nullptr : words_.data(), offsets_[i], offsets_[i+1] - offsets_[i]);
+   }
+   unsigned char operator()(const INDEX i, const INDEX j) const { return (*this)[i][j]; }
+
+   void set(const INDEX i, const INDEX j)
+   {
+      assert(!full_);
+      assert(i < size() && j < offsets_[i+1] - offsets_[i]);
+      const std::size_t b = offsets_[i] + j;
+      words_[b / word_bits] |= std::uint64_t(1) << (b % word_bits);
+   }
+
+   // random access to slices as needed by passes over factors
+   struct iterator {
+      iterator(const packed_mask_array* a, const INDEX i) : a_(a), i_(i) {}
+      iterator operator+(const INDEX i) const { return iterator(a_, i_ + i); }
+      iterator& operator++() { ++i_; return *this; }
+      slice operator*() const { return (*a_)[i_]; }
+      bool operator==(const iterator& o) const { return i_ == o.i_; }
+      bool operator!=(const iterator& o) const { return i_ != o.i_; }
+      const packed_mask_array* a_;
+      INDEX i_;
+   };
+
+   iterator begin() const { return iterator(this, 0); }
+   iterator end() const { return iterator(this, size()); }
+
+private:
+   std::vector<std::size_t> offsets_; // bit offsets of rows
+   std::vector<std::uint64_t> words_;
+   bool full_ = false;
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_PACKED_MASK_ARRAY_HXX
@@ -4,12 +4,19 @@
 #include "DD_ILP.hxx"
 #include "LP_MP.h"
 #include "external_solver_interface.hxx"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace LP_MP {
 
 // This class mimics an `LP_MP::LP` but does not inherit from it. This allows
 // reusing the very same factors and messages and computing their primal values
 // with an external solver.
+//
+// The external model is kept alive and only grows: factors and messages are
+// appended once, and before solving only the costs of new factors and of
+// factors marked by `update_costs` are (re)loaded at their variable offsets.
 template<typename EXTERNAL_SOLVER>
 class partial_external_solver {
 public:
@@ -18,6 +25,7 @@ public:
     if (!has_factor(f)) {
       dirty_ = true;
       factor_address_to_index_.insert(std::make_pair(f, f_.size()));
+      pending_cost_loads_.push_back(f_.size());
       f_.push_back(f);
       assert(factor_address_to_index_.size() == f_.size());
 
@@ -30,6 +38,7 @@ public:
   void add_message(MESSAGE_CONTAINER_TYPE* m) {
     if (!has_message(m)) {
       dirty_ = true;
+      m_.insert(m);
       auto* l = m->GetLeftFactor();
       auto* r = m->GetRightFactor();
       assert(has_factor(l) && has_factor(r));
@@ -47,29 +56,51 @@ public:
     });
   }
 
+  // Costs of `f` have changed (e.g. by reparametrization), reload them and
+  // solve again on the next call to `solve`.
+  void update_costs(FactorTypeAdapter* f) {
+    auto it = factor_address_to_index_.find(f);
+    if (it != factor_address_to_index_.end()) {
+      dirty_ = true;
+      pending_cost_loads_.push_back(it->second);
+    }
+  }
+
   bool has_factor(FactorTypeAdapter* f) {
     return factor_address_to_index_.find(f) != factor_address_to_index_.end();
   }
 
-  bool has_message(AbstractMessageContainer* m) {
+  bool has_message(const void* m) {
     return m_.find(m) != m_.end();
   }
 
   INDEX GetNumberOfFactors() const { return f_.size(); }
-  INDEX GetNumberOfMessages() const { return f_.size(); }
+  FactorTypeAdapter* GetFactor(const INDEX i) const { assert(i < f_.size()); return f_[i]; } // in order of addition
+  INDEX GetNumberOfMessages() const { return m_.size(); }
 
   bool solve() {
     bool result = true;
 
     if (dirty_) {
-      s_.init_variable_loading();
-      for (auto* f : f_)
-        f->load_costs(s_);
+      // Variables and constraints are only appended, hence the current
+      // variable counters mark the end of the model.
+      const auto end_variable_counters = s_.get_variable_counters();
+
+      std::sort(pending_cost_loads_.begin(), pending_cost_loads_.end());
+      pending_cost_loads_.erase(std::unique(pending_cost_loads_.begin(), pending_cost_loads_.end()), pending_cost_loads_.end());
+      for (const INDEX i : pending_cost_loads_) {
+        s_.set_variable_counters(external_variable_counter_[i]);
+        f_[i]->load_costs(s_);
+      }
+      pending_cost_loads_.clear();
+
+      s_.set_variable_counters(end_variable_counters);
       result = s_.solve();
 
       s_.init_variable_loading();
       for (auto* f : f_)
         f->convert_primal(s_);
+      s_.set_variable_counters(end_variable_counters);
 
       dirty_ = false;
     }
@@ -78,10 +109,13 @@ public:
   }
 
   void write_to_file(const std::string& filename) {
+    const auto end_variable_counters = s_.get_variable_counters();
     s_.init_variable_loading();
     for (auto* f : f_)
       f->load_costs(s_);
+    pending_cost_loads_.clear();
     s_.write_to_file(filename);
+    s_.set_variable_counters(end_variable_counters);
   }
 
   bool dirty () const { return dirty_; }
@@ -89,10 +123,11 @@ public:
 private:
   DD_ILP::external_solver_interface<EXTERNAL_SOLVER> s_;
   std::vector<FactorTypeAdapter*> f_;
-  std::unordered_set<AbstractMessageContainer*> m_;
+  std::unordered_set<const void*> m_;
   std::unordered_map<FactorTypeAdapter*, INDEX> factor_address_to_index_;
   std::vector<typename DD_ILP::variable_counters> external_variable_counter_;
-  bool dirty_;
+  std::vector<INDEX> pending_cost_loads_; // indices into f_ whose costs must be loaded before the next solve
+  bool dirty_ = false;
 };
 
 } // end namespace LP_MP
@@ -0,0 +1,276 @@
+#ifndef LP_MP_BINARY_MRF_INPUT_HXX
+#define LP_MP_BINARY_MRF_INPUT_HXX
+
+#include "config.hxx"
+#include "mapped_file.hxx"
+#include "uai_mmap_input.hxx"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <iostream>
+
+namespace LP_MP {
+
+// binary on-disk format for pairwise graphical models, loaded without any parsing through a memory mapping.
+// Layout (native endianness, every section begins at a multiple of binary_mrf_alignment bytes):
+//    header
+//    cardinality         uint32[no_variables]
+//    unary offsets       uint64[no_variables+1]   offsets of unary cost tables in cost section
+//    pairwise row begin  uint64[no_variables+1]   CSR: pairwise factors (i,j) with i<j are row_begin[i], ..., row_begin[i+1]-1
+//    pairwise column     uint32[no_pairwise]      second variable j of each pairwise factor
+//    pairwise offsets    uint64[no_pairwise+1]    offsets of row-major pairwise cost tables in cost section
+//    costs               REAL[...]                every cost table starts aligned to REAL_ALIGNMENT
+namespace BinaryMrfInput {
+
+   constexpr std::size_t binary_mrf_alignment = REAL_ALIGNMENT*sizeof(REAL);
+   constexpr char binary_mrf_magic[8] = {'L','P','_','M','P','M','R','F'};
+   constexpr std::uint32_t binary_mrf_version = 1;
+
+   struct header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t real_size;
+      std::uint64_t no_variables;
+      std::uint64_t no_pairwise;
+      std::uint64_t cardinality_offset;
+      std::uint64_t unary_offsets_offset;
+      std::uint64_t row_begin_offset;
+      std::uint64_t column_offset;
+      std::uint64_t pairwise_offsets_offset;
+      std::uint64_t cost_offset;
+      std::uint64_t file_size;
+   };
+
+   inline std::uint64_t align(const std::uint64_t x, const std::uint64_t a) { return ((x + a - 1) / a) * a; }
+
+   // row-major view onto a pairwise cost table inside the mapping. Offers the read interface of matrix<REAL> needed to construct pairwise factors.
+   class const_matrix_view {
+   public:
+      const_matrix_view(const REAL* data, const INDEX dim1, const INDEX dim2) : data_(data), dim1_(dim1), dim2_(dim2) {}
+      REAL operator()(const INDEX x1, const INDEX x2) const { assert(x1 < dim1() && x2 < dim2()); return data_[x1*dim2_ + x2]; }
+      REAL operator[](const INDEX i) const { assert(i < size()); return data_[i]; }
+      INDEX dim1() const { return dim1_; }
+      INDEX dim2() const { return dim2_; }
+      INDEX size() const { return dim1_*dim2_; }
+      const REAL* begin() const { return data_; }
+      const REAL* end() const { return data_ + size(); }
+   private:
+      const REAL* data_;
+      const INDEX dim1_;
+      const INDEX dim2_;
+   };
+
+   // write pairwise graphical model in binary format
+   inline void write(const std::string& filename, const UaiMrfMmapInput::mrf_input& input)
+   {
+      const std::size_t n = input.number_of_variables_;
+      const std::size_t m = input.pairwise_costs_.size();
+
+      // pairwise factors sorted by first variable for CSR storage
+      std::vector<std::size_t> pairwise_order(m);
+      std::iota(pairwise_order.begin(), pairwise_order.end(), 0);
+      std::sort(pairwise_order.begin(), pairwise_order.end(), [&](const std::size_t a, const std::size_t b) { return input.pairwise_variables_[a] < input.pairwise_variables_[b]; });
+
+      std::vector<std::uint32_t> cardinality(input.cardinality_.begin(), input.cardinality_.end());
+      std::vector<std::uint64_t> unary_offsets(n+1);
+      std::vector<std::uint64_t> row_begin(n+1, 0);
+      std::vector<std::uint32_t> column(m);
+      std::vector<std::uint64_t> pairwise_offsets(m+1);
+
+      std::uint64_t cost_size = 0;
+      for(std::size_t i=0; i<n; ++i) {
+         unary_offsets[i] = cost_size;
+         cost_size += align(cardinality[i], REAL_ALIGNMENT);
+      }
+      unary_offsets[n] = cost_size;
+      for(std::size_t k=0; k<m; ++k) {
+         const auto& vars = input.pairwise_variables_[pairwise_order[k]];
+         assert(vars[0] < vars[1]);
+         ++row_begin[vars[0]+1];
+         column[k] = vars[1];
+         pairwise_offsets[k] = cost_size;
+         cost_size += align(std::uint64_t(cardinality[vars[0]]) * cardinality[vars[1]], REAL_ALIGNMENT);
+      }
+      pairwise_offsets[m] = cost_size;
+      std::partial_sum(row_begin.begin(), row_begin.end(), row_begin.begin());
+
+      header h;
+      std::memcpy(h.magic, binary_mrf_magic, sizeof(h.magic));
+      h.version = binary_mrf_version;
+      h.real_size = sizeof(REAL);
+      h.no_variables = n;
+      h.no_pairwise = m;
+      h.cardinality_offset = align(sizeof(header), binary_mrf_alignment);
+      h.unary_offsets_offset = align(h.cardinality_offset + n*sizeof(std::uint32_t), binary_mrf_alignment);
+      h.row_begin_offset = align(h.unary_offsets_offset + (n+1)*sizeof(std::uint64_t), binary_mrf_alignment);
+      h.column_offset = align(h.row_begin_offset + (n+1)*sizeof(std::uint64_t), binary_mrf_alignment);
+      h.pairwise_offsets_offset = align(h.column_offset + m*sizeof(std::uint32_t), binary_mrf_alignment);
+      h.cost_offset = align(h.pairwise_offsets_offset + (m+1)*sizeof(std::uint64_t), binary_mrf_alignment);
+      h.file_size = h.cost_offset + cost_size*sizeof(REAL);
+
+      std::ofstream f(filename, std::ios::binary);
+      if(!f) { throw std::runtime_error("could not open " + filename + " for writing"); }
+      std::uint64_t pos = 0;
+      auto write_section = [&](const std::uint64_t offset, const void* data, const std::size_t size) {
+         assert(pos <= offset);
+         static const char zeros[binary_mrf_alignment] = {};
+         f.write(zeros, offset - pos);
+         f.write(static_cast<const char*>(data), size);
+         pos = offset + size;
+      };
+      write_section(0, &h, sizeof(header));
+      write_section(h.cardinality_offset, cardinality.data(), n*sizeof(std::uint32_t));
+      write_section(h.unary_offsets_offset, unary_offsets.data(), (n+1)*sizeof(std::uint64_t));
+      write_section(h.row_begin_offset, row_begin.data(), (n+1)*sizeof(std::uint64_t));
+      write_section(h.column_offset, column.data(), m*sizeof(std::uint32_t));
+      write_section(h.pairwise_offsets_offset, pairwise_offsets.data(), (m+1)*sizeof(std::uint64_t));
+
+      // costs are written table by table, padding is filled with zeros
+      std::vector<REAL> table;
+      for(std::size_t i=0; i<n; ++i) {
+         table.assign(unary_offsets[i+1] - unary_offsets[i], 0.0);
+         std::copy(input.unary_costs_.begin() + input.unary_offsets_[i], input.unary_costs_.begin() + input.unary_offsets_[i+1], table.begin());
+         write_section(h.cost_offset + unary_offsets[i]*sizeof(REAL), table.data(), table.size()*sizeof(REAL));
+      }
+      for(std::size_t k=0; k<m; ++k) {
+         const auto& cost = input.pairwise_costs_[pairwise_order[k]];
+         table.assign(pairwise_offsets[k+1] - pairwise_offsets[k], 0.0);
+         for(INDEX x1=0; x1<cost.dim1(); ++x1) {
+            for(INDEX x2=0; x2<cost.dim2(); ++x2) {
+               table[x1*cost.dim2() + x2] = cost(x1,x2);
+            }
+         }
+         write_section(h.cost_offset + pairwise_offsets[k]*sizeof(REAL), table.data(), table.size()*sizeof(REAL));
+      }
+      assert(pos == h.file_size);
+      if(!f) { throw std::runtime_error("could not write " + filename); }
+   }
+
+   // converter from uai format
+   inline void convert_uai(const std::string& uai_filename, const std::string& binary_filename)
+   {
+      write(binary_filename, UaiMrfMmapInput::parse_file(uai_filename));
+   }
+
+   // memory mapped model. All accessors point directly into the mapping.
+   class binary_mrf {
+   public:
+      binary_mrf(const std::string& filename)
+         : file_(filename)
+      {
+         if(file_.size() < sizeof(header)) { throw std::runtime_error(filename + " is not a binary mrf file"); }
+         h_ = reinterpret_cast<const header*>(file_.begin());
+         if(std::memcmp(h_->magic, binary_mrf_magic, sizeof(h_->magic)) != 0) { throw std::runtime_error(filename + " is not a binary mrf file"); }
+         if(h_->version != binary_mrf_version) { throw std::runtime_error(filename + ": unsupported binary mrf version " + std::to_string(h_->version)); }
+         if(h_->real_size != sizeof(REAL)) { throw std::runtime_error(filename + ": binary mrf was written with different floating point type"); }
+         if(h_->file_size != file_.size()) { throw std::runtime_error(filename + ": binary mrf file is truncated"); }
+
+         cardinality_ = section<std::uint32_t>(h_->cardinality_offset, no_variables());
+         unary_offsets_ = section<std::uint64_t>(h_->unary_offsets_offset, no_variables()+1);
+         row_begin_ = section<std::uint64_t>(h_->row_begin_offset, no_variables()+1);
+         column_ = section<std::uint32_t>(h_->column_offset, no_pairwise());
+         pairwise_offsets_ = section<std::uint64_t>(h_->pairwise_offsets_offset, no_pairwise()+1);
+         costs_ = section<REAL>(h_->cost_offset, pairwise_offsets_[no_pairwise()]);
+         validate();
+      }
+
+      std::size_t no_variables() const { return h_->no_variables; }
+      std::size_t no_pairwise() const { return h_->no_pairwise; }
+      INDEX cardinality(const std::size_t i) const { assert(i < no_variables()); return cardinality_[i]; }
+
+      const REAL* unary_begin(const std::size_t i) const { assert(i < no_variables()); return costs_ + unary_offsets_[i]; }
+      const REAL* unary_end(const std::size_t i) const { return unary_begin(i) + cardinality(i); }
+
+      // pairwise factors with first variable i are pairwise_begin(i), ..., pairwise_end(i)-1
+      std::size_t pairwise_begin(const std::size_t i) const { assert(i < no_variables()); return row_begin_[i]; }
+      std::size_t pairwise_end(const std::size_t i) const { assert(i < no_variables()); return row_begin_[i+1]; }
+      INDEX pairwise_second_variable(const std::size_t k) const { assert(k < no_pairwise()); return column_[k]; }
+      const_matrix_view pairwise_cost(const std::size_t i, const std::size_t k) const
+      {
+         assert(pairwise_begin(i) <= k && k < pairwise_end(i));
+         return const_matrix_view(costs_ + pairwise_offsets_[k], cardinality(i), cardinality(pairwise_second_variable(k)));
+      }
+
+   private:
+      // size is given in elements. Checks are written such that corrupt offsets and sizes cannot overflow.
+      template<typename T>
+      const T* section(const std::uint64_t offset, const std::uint64_t size) const
+      {
+         if(offset % binary_mrf_alignment != 0 || offset > file_.size() || size > (file_.size() - offset)/sizeof(T)) { throw std::runtime_error("corrupt binary mrf file"); }
+         return reinterpret_cast<const T*>(file_.begin() + offset);
+      }
+
+      // check that the CSR structure is well formed and every cost table lies inside the cost section, so that accessors never read outside the mapping
+      void validate() const
+      {
+         const std::uint64_t n = no_variables();
+         const std::uint64_t m = no_pairwise();
+         const std::uint64_t cost_size = pairwise_offsets_[m];
+         auto table_inside = [cost_size](const std::uint64_t offset, const std::uint64_t size) {
+            return offset <= cost_size && size <= cost_size - offset;
+         };
+
+         for(std::uint64_t i=0; i<n; ++i) {
+            if(cardinality_[i] == 0) { throw std::runtime_error("corrupt binary mrf file: variable with zero labels"); }
+            if(!table_inside(unary_offsets_[i], cardinality_[i])) { throw std::runtime_error("corrupt binary mrf file: unary cost table outside of cost section"); }
+         }
+
+         if(row_begin_[0] != 0 || row_begin_[n] != m) { throw std::runtime_error("corrupt binary mrf file: pairwise row begins do not cover pairwise factors"); }
+         for(std::uint64_t i=0; i<n; ++i) {
+            if(row_begin_[i] > row_begin_[i+1]) { throw std::runtime_error("corrupt binary mrf file: pairwise row begins decrease"); }
+         }
+         // now row_begin_[i] <= m for all i
+         for(std::uint64_t i=0; i<n; ++i) {
+            for(std::uint64_t k=row_begin_[i]; k<row_begin_[i+1]; ++k) {
+               const std::uint64_t j = column_[k];
+               if(j <= i || j >= n) { throw std::runtime_error("corrupt binary mrf file: invalid second variable of pairwise factor"); }
+               if(!table_inside(pairwise_offsets_[k], std::uint64_t(cardinality_[i]) * cardinality_[j])) { throw std::runtime_error("corrupt binary mrf file: pairwise cost table outside of cost section"); }
+            }
+         }
+      }
+
+      mapped_file file_;
+      const header* h_;
+      const std::uint32_t* cardinality_;
+      const std::uint64_t* unary_offsets_;
+      const std::uint64_t* row_begin_;
+      const std::uint32_t* column_;
+      const std::uint64_t* pairwise_offsets_;
+      const REAL* costs_;
+   };
+
+   template<typename MRF_CONSTRUCTOR>
+   void build_mrf(MRF_CONSTRUCTOR& mrf, const binary_mrf& input)
+   {
+      mrf.AddUnaryFactors(input.no_variables(), [&](const INDEX i) { return std::vector<REAL>(input.unary_begin(i), input.unary_end(i)); });
+      std::vector<std::array<INDEX,2>> variables;
+      variables.reserve(input.no_pairwise());
+      for(std::size_t i=0; i<input.no_variables(); ++i) {
+         for(std::size_t k=input.pairwise_begin(i); k<input.pairwise_end(i); ++k) {
+            variables.push_back({INDEX(i), input.pairwise_second_variable(k)});
+         }
+      }
+      // pairwise factors are stored in row order, hence the k-th pairwise factor has index k
+      mrf.AddPairwiseFactors(variables, [&](const std::size_t k) { return input.pairwise_cost(variables[k][0], k); });
+   }
+
+   template<typename SOLVER>
+   bool ParseProblem(const std::string& filename, SOLVER& s)
+   {
+      std::cout << "loading " << filename << "\n";
+      const binary_mrf input(filename);
+      auto& mrf_constructor = s.template GetProblemConstructor<0>();
+      build_mrf(mrf_constructor, input);
+      return true;
+   }
+}
+
+} // end namespace LP_MP
+
+#endif // LP_MP_BINARY_MRF_INPUT_HXX
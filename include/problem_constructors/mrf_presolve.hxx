@@ -0,0 +1,528 @@
+#ifndef LP_MP_MRF_PRESOLVE_HXX
+#define LP_MP_MRF_PRESOLVE_HXX
+
+#include "config.hxx"
+#include "vector.hxx"
+#include "two_dimensional_variable_array.hxx"
+#include "uai_mmap_input.hxx"
+#include <vector>
+#include <array>
+#include <deque>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+namespace LP_MP {
+
+// presolve for pairwise graphical models: labels which provably are not needed by some optimal labeling are removed before the relaxation is built.
+// Two tests are applied in rounds until no label can be eliminated anymore:
+// (i) dead-end elimination, see Goldstein, "Efficient rotamer elimination applied to protein side-chains and related spin glasses", Biophysical Journal 1994:
+//     label a of variable i is removed if for some other label b: theta_i(a) - theta_i(b) + sum_j min_c [theta_ij(a,c) - theta_ij(b,c)] >= 0.
+// (ii) one-against-all partial optimality, see Kovtun, "Partial optimal labeling search for a NP-hard subclass of (max,+) problems", DAGM 2003:
+//     for each label alpha an auxiliary binary submodular problem is built whose values bound the energy change when switching variables to alpha.
+//     Variables on the alpha side of a minimum cut of it can be fixed to alpha. Kovtun's construction for Potts models is extended to arbitrary pairwise costs by choosing the auxiliary pairwise costs as the smallest upper bounds keeping it submodular.
+// Each step preserves at least one optimal labeling among the remaining labels. Variables with one remaining label are fixed and their pairwise costs are moved into the unaries of their neighbours.
+namespace mrf_presolve {
+
+   using UaiMrfMmapInput::mrf_input;
+
+   struct options {
+      bool dead_end_elimination = true;
+      bool one_against_all = true;
+      INDEX max_rounds = 100;
+   };
+
+   // max-flow by Dinic's algorithm for real valued capacities. Augmenting paths are searched iteratively, as recursion depth could reach the number of variables.
+   class max_flow {
+   public:
+      max_flow(const std::size_t no_nodes) : adjacency_(no_nodes) {}
+
+      void add_edge(const std::size_t i, const std::size_t j, const REAL capacity_ij, const REAL capacity_ji = 0.0)
+      {
+         assert(i != j && capacity_ij >= 0.0 && capacity_ji >= 0.0);
+         adjacency_[i].push_back({j, adjacency_[j].size(), capacity_ij});
+         adjacency_[j].push_back({i, adjacency_[i].size()-1, capacity_ji});
+      }
+
+      REAL compute(const std::size_t s, const std::size_t t)
+      {
+         REAL flow = 0.0;
+         std::vector<std::size_t> next_edge(adjacency_.size());
+         std::vector<std::array<std::size_t,2>> path; // (node, edge) pairs
+         while(compute_levels(s, t)) {
+            std::fill(next_edge.begin(), next_edge.end(), 0);
+            path.clear();
+            std::size_t u = s;
+            while(true) {
+               if(u == t) {
+                  REAL bottleneck = std::numeric_limits<REAL>::infinity();
+                  for(const auto& p : path) { bottleneck = std::min(bottleneck, adjacency_[p[0]][p[1]].residual); }
+                  for(const auto& p : path) {
+                     auto& e = adjacency_[p[0]][p[1]];
+                     e.residual -= bottleneck;
+                     adjacency_[e.head][e.reverse].residual += bottleneck;
+                  }
+                  flow += bottleneck;
+                  // retreat to tail of first saturated edge
+                  std::size_t k = 0;
+                  while(k < path.size() && adjacency_[path[k][0]][path[k][1]].residual > eps) { ++k; }
+                  u = path[k][0];
+                  path.resize(k);
+                  continue;
+               }
+               while(next_edge[u] < adjacency_[u].size()) {
+                  const auto& e = adjacency_[u][next_edge[u]];
+                  if(e.residual > eps && level_[e.head] == level_[u] + 1) { break; }
+                  ++next_edge[u];
+               }
+               if(next_edge[u] < adjacency_[u].size()) {
+                  path.push_back({u, next_edge[u]});
+                  u = adjacency_[u][next_edge[u]].head;
+               } else {
+                  level_[u] = -1; // dead end
+                  if(path.empty()) { break; }
+                  u = path.back()[0];
+                  ++next_edge[u];
+                  path.pop_back();
+               }
+            }
+         }
+         return flow;
+      }
+
+      // after compute(): nodes from which t can not be reached in the residual graph. This is the largest source side of a minimum cut.
+      std::vector<char> source_side(const std::size_t t) const
+      {
+         std::vector<char> reaches_t(adjacency_.size(), false);
+         std::deque<std::size_t> queue;
+         reaches_t[t] = true;
+         queue.push_back(t);
+         while(!queue.empty()) {
+            const std::size_t v = queue.front();
+            queue.pop_front();
+            for(const auto& e : adjacency_[v]) {
+               if(!reaches_t[e.head] && adjacency_[e.head][e.reverse].residual > eps) {
+                  reaches_t[e.head] = true;
+                  queue.push_back(e.head);
+               }
+            }
+         }
+         for(auto& r : reaches_t) { r = !r; }
+         return reaches_t;
+      }
+
+   private:
+      bool compute_levels(const std::size_t s, const std::size_t t)
+      {
+         level_.assign(adjacency_.size(), -1);
+         std::deque<std::size_t> queue;
+         level_[s] = 0;
+         queue.push_back(s);
+         while(!queue.empty()) {
+            const std::size_t u = queue.front();
+            queue.pop_front();
+            for(const auto& e : adjacency_[u]) {
+               if(level_[e.head] == -1 && e.residual > eps) {
+                  level_[e.head] = level_[u] + 1;
+                  queue.push_back(e.head);
+               }
+            }
+         }
+         return level_[t] != -1;
+      }
+
+      struct edge {
+         std::size_t head;
+         std::size_t reverse;
+         REAL residual;
+      };
+      std::vector<std::vector<edge>> adjacency_;
+      std::vector<long> level_;
+   };
+
+   struct presolve_result {
+      mrf_input reduced_input_;
+      // original_labels_(i,l) is the label in the original model of label l of variable i in the reduced model
+      two_dim_variable_array<INDEX> original_labels_;
+      INDEX no_fixed_variables_ = 0;
+      std::size_t no_labels_ = 0;
+      std::size_t no_remaining_labels_ = 0;
+
+      // fraction of labels eliminated
+      REAL reduction_ratio() const { return no_labels_ > 0 ? 1.0 - REAL(no_remaining_labels_)/REAL(no_labels_) : 0.0; }
+
+      std::vector<INDEX> original_labeling(const std::vector<INDEX>& reduced_labeling) const
+      {
+         assert(reduced_labeling.size() == original_labels_.size());
+         std::vector<INDEX> labeling(reduced_labeling.size());
+         for(INDEX i=0; i<reduced_labeling.size(); ++i) {
+            labeling[i] = original_labels_(i, reduced_labeling[i]);
+         }
+         return labeling;
+      }
+   };
+
+   class presolver {
+   public:
+      presolver(const mrf_input& input)
+         : input_(input),
+         alive_(input.unary_costs_.size(), true),
+         no_alive_(input.cardinality_)
+      {
+         std::vector<INDEX> degree(input_.number_of_variables_, 0);
+         for(const auto& v : input_.pairwise_variables_) {
+            ++degree[v[0]];
+            ++degree[v[1]];
+         }
+         incident_pairwise_.resize(degree.begin(), degree.end());
+         std::fill(degree.begin(), degree.end(), 0);
+         for(INDEX p=0; p<input_.pairwise_variables_.size(); ++p) {
+            for(const INDEX i : input_.pairwise_variables_[p]) {
+               incident_pairwise_(i, degree[i]++) = p;
+            }
+         }
+      }
+
+      INDEX no_variables() const { return input_.number_of_variables_; }
+      INDEX cardinality(const INDEX i) const { return input_.cardinality_[i]; }
+      INDEX no_alive(const INDEX i) const { return no_alive_[i]; }
+      bool alive(const INDEX i, const INDEX a) const { assert(a < cardinality(i)); return alive_[input_.unary_offsets_[i] + a]; }
+
+      // remove dominated labels of all variables, returns number of eliminated labels
+      std::size_t dead_end_elimination()
+      {
+         std::size_t no_eliminated = 0;
+         for(INDEX i=0; i<no_variables(); ++i) {
+            no_eliminated += dead_end_elimination(i);
+         }
+         return no_eliminated;
+      }
+
+      // fix variables to alpha which are persistent by the one-against-all test, returns number of eliminated labels
+      std::size_t one_against_all()
+      {
+         const INDEX max_cardinality = no_variables() > 0 ? *std::max_element(input_.cardinality_.begin(), input_.cardinality_.end()) : 0;
+         std::size_t no_eliminated = 0;
+         for(INDEX alpha=0; alpha<max_cardinality; ++alpha) {
+            no_eliminated += one_against_all(alpha);
+         }
+         return no_eliminated;
+      }
+
+      presolve_result result() const;
+
+   private:
+      REAL unary(const INDEX i, const INDEX a) const { return input_.unary_costs_[input_.unary_offsets_[i] + a]; }
+      INDEX other_variable(const INDEX p, const INDEX i) const
+      {
+         const auto& v = input_.pairwise_variables_[p];
+         return v[0] == i ? v[1] : v[0];
+      }
+      // cost of pairwise factor p when variable i takes label a and the other variable label c
+      REAL pairwise(const INDEX p, const INDEX i, const INDEX a, const INDEX c) const
+      {
+         const auto& cost = input_.pairwise_costs_[p];
+         return input_.pairwise_variables_[p][0] == i ? cost(a,c) : cost(c,a);
+      }
+      void eliminate(const INDEX i, const INDEX a)
+      {
+         assert(alive(i,a) && no_alive_[i] > 1);
+         alive_[input_.unary_offsets_[i] + a] = false;
+         --no_alive_[i];
+      }
+
+      std::size_t dead_end_elimination(const INDEX i);
+      std::size_t one_against_all(const INDEX alpha);
+
+      const mrf_input& input_;
+      std::vector<char> alive_; // indexed as unary costs
+      std::vector<INDEX> no_alive_;
+      two_dim_variable_array<INDEX> incident_pairwise_;
+   };
+
+   inline std::size_t presolver::dead_end_elimination(const INDEX i)
+   {
+      if(no_alive_[i] < 2) { return 0; }
+
+      // candidate dominating labels: the ones with smallest optimistic and smallest pessimistic bound
+      std::vector<REAL> lower(cardinality(i), std::numeric_limits<REAL>::infinity());
+      std::vector<REAL> upper(cardinality(i), std::numeric_limits<REAL>::infinity());
+      for(INDEX a=0; a<cardinality(i); ++a) {
+         if(!alive(i,a)) { continue; }
+         lower[a] = unary(i,a);
+         upper[a] = unary(i,a);
+         for(const INDEX p : incident_pairwise_[i]) {
+            const INDEX j = other_variable(p,i);
+            REAL min = std::numeric_limits<REAL>::infinity();
+            REAL max = -std::numeric_limits<REAL>::infinity();
+            for(INDEX c=0; c<cardinality(j); ++c) {
+               if(!alive(j,c)) { continue; }
+               min = std::min(min, pairwise(p,i,a,c));
+               max = std::max(max, pairwise(p,i,a,c));
+            }
+            lower[a] += min;
+            upper[a] += max;
+         }
+      }
+      std::array<INDEX,2> candidates = {
+         INDEX(std::min_element(upper.begin(), upper.end()) - upper.begin()),
+         INDEX(std::min_element(lower.begin(), lower.end()) - lower.begin())
+      };
+
+      std::size_t no_eliminated = 0;
+      for(const INDEX b : candidates) {
+         if(!alive(i,b)) { continue; }
+         for(INDEX a=0; a<cardinality(i) && no_alive_[i] > 1; ++a) {
+            if(a == b || !alive(i,a)) { continue; }
+            REAL gap = unary(i,a) - unary(i,b);
+            for(const INDEX p : incident_pairwise_[i]) {
+               const INDEX j = other_variable(p,i);
+               REAL min = std::numeric_limits<REAL>::infinity();
+               for(INDEX c=0; c<cardinality(j); ++c) {
+                  if(!alive(j,c)) { continue; }
+                  const REAL diff = pairwise(p,i,a,c) - pairwise(p,i,b,c);
+                  min = std::min(min, std::isnan(diff) ? -std::numeric_limits<REAL>::infinity() : diff);
+               }
+               gap += min;
+            }
+            if(gap >= 0.0) { // false for nan
+               eliminate(i,a);
+               ++no_eliminated;
+            }
+         }
+      }
+      return no_eliminated;
+   }
+
+   // The auxiliary problem has variables y_i = 0 (label alpha) and y_i = 1 (some other label) for all variables which may take alpha and some other label.
+   // Variables whose only label is alpha are held at 0, variables which can not take alpha are held at 1.
+   // Its unaries are theta_i(alpha) and min_{k != alpha} theta_i(k), its pairwise costs P = f(0,0), Q = f(0,1), R = f(1,0), f(1,1) = 0 are chosen such that
+   // the energy change of setting x_i = alpha for all i in a set is bounded by the corresponding change in the auxiliary problem.
+   // For a minimizing set A and any labeling x, submodularity gives E(x with x_A = alpha) <= E(x).
+   inline std::size_t presolver::one_against_all(const INDEX alpha)
+   {
+      constexpr INDEX not_free = std::numeric_limits<INDEX>::max();
+      std::vector<INDEX> node(no_variables(), not_free);
+      std::vector<INDEX> free_variables;
+      auto takes_alpha = [&](const INDEX i) { return alpha < cardinality(i) && alive(i,alpha); };
+      for(INDEX i=0; i<no_variables(); ++i) {
+         if(takes_alpha(i) && no_alive_[i] > 1) {
+            node[i] = free_variables.size();
+            free_variables.push_back(i);
+         }
+      }
+      if(free_variables.empty()) { return 0; }
+
+      std::vector<REAL> cost_alpha(free_variables.size());
+      std::vector<REAL> cost_other(free_variables.size());
+      for(INDEX n=0; n<free_variables.size(); ++n) {
+         const INDEX i = free_variables[n];
+         cost_alpha[n] = unary(i,alpha);
+         cost_other[n] = std::numeric_limits<REAL>::infinity();
+         for(INDEX k=0; k<cardinality(i); ++k) {
+            if(k != alpha && alive(i,k)) { cost_other[n] = std::min(cost_other[n], unary(i,k)); }
+         }
+      }
+
+      constexpr REAL inf = std::numeric_limits<REAL>::infinity();
+      // maximum of f(a,l) - f(k,l) over remaining labels k != alpha of variable i and remaining labels l of variable j, where l != alpha if exclude_alpha_j
+      auto max_switch_gain = [&](const INDEX p, const INDEX i, const INDEX a, const bool exclude_alpha_j) {
+         const INDEX j = other_variable(p,i);
+         REAL max = -inf;
+         for(INDEX l=0; l<cardinality(j); ++l) {
+            if(!alive(j,l) || (exclude_alpha_j && l == alpha)) { continue; }
+            REAL min = inf;
+            for(INDEX k=0; k<cardinality(i); ++k) {
+               if(k != alpha && alive(i,k)) { min = std::min(min, pairwise(p,i,k,l)); }
+            }
+            max = std::max(max, pairwise(p,i,a,l) - min);
+         }
+         return max;
+      };
+
+      struct auxiliary_pairwise { INDEX n1, n2; REAL P, Q, R; };
+      std::vector<auxiliary_pairwise> auxiliary;
+      for(INDEX p=0; p<input_.pairwise_variables_.size(); ++p) {
+         const INDEX u = input_.pairwise_variables_[p][0];
+         const INDEX v = input_.pairwise_variables_[p][1];
+         if(node[u] == not_free && node[v] == not_free) { continue; }
+         if(node[u] != not_free && node[v] != not_free) {
+            const REAL f_alpha_alpha = pairwise(p,u,alpha,alpha);
+            REAL min = inf;
+            for(INDEX k=0; k<cardinality(u); ++k) {
+               for(INDEX l=0; l<cardinality(v); ++l) {
+                  if(k != alpha && l != alpha && alive(u,k) && alive(v,l)) { min = std::min(min, pairwise(p,u,k,l)); }
+               }
+            }
+            // b1: u switches, v stays at alpha. b2: v switches, u stays at alpha. c1: u switches, v stays at l != alpha. c2: v switches, u stays at k != alpha.
+            REAL b1 = -inf;
+            for(INDEX k=0; k<cardinality(u); ++k) {
+               if(k != alpha && alive(u,k)) { b1 = std::max(b1, f_alpha_alpha - pairwise(p,u,k,alpha)); }
+            }
+            REAL b2 = -inf;
+            for(INDEX l=0; l<cardinality(v); ++l) {
+               if(l != alpha && alive(v,l)) { b2 = std::max(b2, f_alpha_alpha - pairwise(p,v,l,alpha)); }
+            }
+            const REAL c1 = max_switch_gain(p,u,alpha,true);
+            const REAL c2 = max_switch_gain(p,v,alpha,true);
+            // submodularity P <= Q + R holds iff b1 <= Q, b2 <= R and f(alpha,alpha) - min <= Q + R
+            REAL Q = std::max(c1,b1);
+            REAL R = std::max(c2,b2);
+            Q += std::max(0.0, f_alpha_alpha - min - (Q + R));
+            const REAL P = std::max({f_alpha_alpha - min, b1 + R, b2 + Q});
+            auxiliary.push_back({node[u], node[v], P, Q, R});
+         } else {
+            const INDEX i = node[u] != not_free ? u : v;
+            const INDEX j = other_variable(p,i);
+            if(takes_alpha(j)) { // j is fixed to alpha
+               REAL b = -inf;
+               for(INDEX k=0; k<cardinality(i); ++k) {
+                  if(k != alpha && alive(i,k)) { b = std::max(b, pairwise(p,i,alpha,alpha) - pairwise(p,i,k,alpha)); }
+               }
+               cost_alpha[node[i]] += b;
+            } else {
+               cost_alpha[node[i]] += max_switch_gain(p,i,alpha,false);
+            }
+         }
+      }
+
+      // infinite costs are left to dead end elimination
+      for(INDEX n=0; n<free_variables.size(); ++n) {
+         if(!std::isfinite(cost_alpha[n]) || !std::isfinite(cost_other[n])) { return 0; }
+      }
+      for(const auto& a : auxiliary) {
+         if(!std::isfinite(a.P) || !std::isfinite(a.Q) || !std::isfinite(a.R)) { return 0; }
+      }
+
+      // y = 0 is the source side. f(y1,y2) = P + (R-P) y1 - R y2 + (Q+R-P) (1-y1) y2
+      const std::size_t s = free_variables.size();
+      const std::size_t t = s+1;
+      max_flow graph(free_variables.size()+2);
+      std::vector<REAL> linear(free_variables.size());
+      for(INDEX n=0; n<free_variables.size(); ++n) { linear[n] = cost_other[n] - cost_alpha[n]; }
+      for(const auto& a : auxiliary) {
+         linear[a.n1] += a.R - a.P;
+         linear[a.n2] -= a.R;
+         assert(a.Q + a.R - a.P >= -eps);
+         graph.add_edge(a.n1, a.n2, std::max(0.0, a.Q + a.R - a.P));
+      }
+      for(INDEX n=0; n<free_variables.size(); ++n) {
+         if(linear[n] > 0.0) {
+            graph.add_edge(s, n, linear[n]);
+         } else if(linear[n] < 0.0) {
+            graph.add_edge(n, t, -linear[n]);
+         }
+      }
+      graph.compute(s,t);
+      const auto alpha_side = graph.source_side(t);
+
+      std::size_t no_eliminated = 0;
+      for(INDEX n=0; n<free_variables.size(); ++n) {
+         if(!alpha_side[n]) { continue; }
+         const INDEX i = free_variables[n];
+         for(INDEX k=0; k<cardinality(i); ++k) {
+            if(k != alpha && alive(i,k)) {
+               eliminate(i,k);
+               ++no_eliminated;
+            }
+         }
+      }
+      return no_eliminated;
+   }
+
+   // restrict costs to the remaining labels. Pairwise factors with a fixed variable are added to the unaries of the other variable.
+   inline presolve_result presolver::result() const
+   {
+      presolve_result r;
+      auto& reduced = r.reduced_input_;
+      reduced.number_of_variables_ = no_variables();
+      reduced.cardinality_ = no_alive_;
+      r.original_labels_.resize(no_alive_.begin(), no_alive_.end());
+      reduced.unary_offsets_.resize(no_variables()+1);
+      reduced.unary_offsets_[0] = 0;
+      std::partial_sum(no_alive_.begin(), no_alive_.end(), reduced.unary_offsets_.begin()+1);
+      reduced.unary_costs_.resize(reduced.unary_offsets_.back());
+      for(INDEX i=0; i<no_variables(); ++i) {
+         INDEX l = 0;
+         for(INDEX a=0; a<cardinality(i); ++a) {
+            if(!alive(i,a)) { continue; }
+            r.original_labels_(i,l) = a;
+            reduced.unary_costs_[reduced.unary_offsets_[i] + l] = unary(i,a);
+            ++l;
+         }
+         r.no_fixed_variables_ += (no_alive_[i] == 1);
+      }
+      r.no_labels_ = input_.unary_costs_.size();
+      r.no_remaining_labels_ = reduced.unary_costs_.size();
+
+      for(INDEX p=0; p<input_.pairwise_variables_.size(); ++p) {
+         const INDEX u = input_.pairwise_variables_[p][0];
+         const INDEX v = input_.pairwise_variables_[p][1];
+         if(no_alive_[u] == 1 || no_alive_[v] == 1) {
+            const INDEX i = no_alive_[v] == 1 ? u : v;
+            const INDEX j = other_variable(p,i);
+            const INDEX c = r.original_labels_(j,0);
+            for(INDEX l=0; l<no_alive_[i]; ++l) {
+               reduced.unary_costs_[reduced.unary_offsets_[i] + l] += pairwise(p, i, r.original_labels_(i,l), c);
+            }
+         } else {
+            matrix<REAL> cost(no_alive_[u], no_alive_[v]);
+            for(INDEX k=0; k<no_alive_[u]; ++k) {
+               for(INDEX l=0; l<no_alive_[v]; ++l) {
+                  cost(k,l) = input_.pairwise_costs_[p](r.original_labels_(u,k), r.original_labels_(v,l));
+               }
+            }
+            reduced.pairwise_variables_.push_back({u,v});
+            reduced.pairwise_costs_.push_back(std::move(cost));
+         }
+      }
+
+      std::vector<INDEX> scope_sizes(no_variables(), 1);
+      scope_sizes.resize(no_variables() + reduced.pairwise_variables_.size(), 2);
+      reduced.clique_scopes_.resize(scope_sizes.begin(), scope_sizes.end());
+      for(INDEX i=0; i<no_variables(); ++i) {
+         reduced.clique_scopes_(i,0) = i;
+      }
+      for(INDEX p=0; p<reduced.pairwise_variables_.size(); ++p) {
+         reduced.clique_scopes_(no_variables()+p,0) = reduced.pairwise_variables_[p][0];
+         reduced.clique_scopes_(no_variables()+p,1) = reduced.pairwise_variables_[p][1];
+      }
+      return r;
+   }
+
+   inline presolve_result presolve(const mrf_input& input, const options& o = options())
+   {
+      presolver p(input);
+      for(INDEX round=0; round<o.max_rounds; ++round) {
+         std::size_t no_eliminated = 0;
+         if(o.dead_end_elimination) { no_eliminated += p.dead_end_elimination(); }
+         if(o.one_against_all) { no_eliminated += p.one_against_all(); }
+         if(no_eliminated == 0) { break; }
+      }
+      return p.result();
+   }
+
+   inline void report(std::ostream& s, const presolve_result& r)
+   {
+      s << "presolve fixed " << r.no_fixed_variables_ << " of " << r.original_labels_.size() << " variables, " << r.no_remaining_labels_ << " of " << r.no_labels_ << " labels remain, reduction ratio = " << r.reduction_ratio() << "\n";
+   }
+
+   // parse uai file, presolve and build the reduced model. The problem constructor maps the primal back to the original labels.
+   template<typename SOLVER>
+   bool ParseProblem(const std::string& filename, SOLVER& s)
+   {
+      std::cout << "parsing " << filename << "\n";
+      const auto r = presolve(UaiMrfMmapInput::parse_file(filename));
+      report(std::cout, r);
+      auto& mrf_constructor = s.template GetProblemConstructor<0>();
+      UaiMrfMmapInput::build_mrf(mrf_constructor, r.reduced_input_);
+      mrf_constructor.set_original_labels(r.original_labels_);
+      return true;
+   }
+
+} // end namespace mrf_presolve
+
+} // end namespace LP_MP
+
+#endif // LP_MP_MRF_PRESOLVE_HXX
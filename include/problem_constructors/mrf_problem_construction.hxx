@@ -2,13 +2,19 @@
 #define LP_MP_MRF_PROBLEM_CONSTRUCTION_HXX
 
 #include "solver.hxx"
+#include "memory_allocator.hxx"
 #include "cycle_inequalities.hxx"
+#include "uai_mmap_input.hxx"
+#include "binary_mrf_input.hxx"
+#include "mrf_presolve.hxx"
 #include "parse_rules.h"
 #include "pegtl/parse.hh"
 #include "tree_decomposition.hxx"
-#include "arboricity.h"
+#include "union_find.hxx"
 
 #include <string>
+#include <deque>
+#include <numeric>
 
 namespace LP_MP {
 
@@ -102,6 +108,122 @@ public:
       lp_->AddMessage(r);
    }
 
+   // bulk construction for large models: unary factor i gets costs cost(i). Factors are constructed in parallel and registered with the LP in one batch.
+   // Each constructing thread allocates from its own block arena (see stack_allocator_scope), so that threads do not wait for a single arena's lock. Factors stay individually allocated, as the LP deletes them one by one.
+   template<typename COST_FUNC>
+   void AddUnaryFactors(const INDEX no_variables, COST_FUNC cost)
+   {
+      if(unaryFactor_.size() > 0) { throw std::runtime_error("bulk construction of unary factors expects no unary factors present"); }
+      unaryFactor_.resize(no_variables, nullptr);
+#pragma omp parallel
+      {
+         const stack_allocator_scope arena(thread_index());
+#pragma omp for schedule(static)
+         for(INDEX i=0; i<no_variables; ++i) {
+            const std::vector<REAL> c = cost(i);
+            auto* u = new UnaryFactorContainer( c.size() );
+            ConstructUnaryFactor( *(u->GetFactor()), c );
+            unaryFactor_[i] = u;
+         }
+      }
+      lp_->add_factors(unaryFactor_.begin(), unaryFactor_.end());
+
+      std::vector<std::array<FactorTypeAdapter*,2>> relations;
+      relations.reserve(no_variables);
+      for(INDEX i=1; i<no_variables; ++i) {
+         relations.push_back({unaryFactor_[i-1], unaryFactor_[i]});
+      }
+      lp_->AddFactorRelations(relations.begin(), relations.end());
+   }
+
+   // bulk construction of pairwise factors between variables[p][0] < variables[p][1] with costs cost(p), together with their messages. All unary factors must be present.
+   // Each unary factor is connected to its messages by one thread. Left and right messages are connected in separate phases, so that in each phase every pairwise factor is touched by one thread only.
+   template<typename COST_FUNC>
+   void AddPairwiseFactors(const std::vector<std::array<INDEX,2>>& variables, COST_FUNC cost)
+   {
+      const std::size_t first = pairwiseFactor_.size();
+      const std::size_t n = variables.size();
+
+      std::vector<INDEX> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(), [&](const INDEX p, const INDEX q) { return variables[p] < variables[q]; });
+      for(std::size_t k=0; k<n; ++k) {
+         const auto& v = variables[order[k]];
+         if(v[0] >= v[1] || v[1] >= unaryFactor_.size()) { throw std::runtime_error("pairwise factor between variables " + std::to_string(v[0]) + " and " + std::to_string(v[1]) + " not valid"); }
+         if((k > 0 && variables[order[k-1]] == v) || HasPairwiseFactor(v[0],v[1])) { throw std::runtime_error("pairwise factor between variables " + std::to_string(v[0]) + " and " + std::to_string(v[1]) + " already present"); }
+      }
+      // keys arrive in ascending order, hence insertion with hint is amortized constant time when no pairwise factors were present before
+      for(const INDEX p : order) {
+         pairwiseMap_.emplace_hint(pairwiseMap_.end(), std::make_tuple(variables[p][0], variables[p][1]), first + p);
+      }
+      pairwiseIndices_.insert(pairwiseIndices_.end(), variables.begin(), variables.end());
+
+      pairwiseFactor_.resize(first + n, nullptr);
+#pragma omp parallel
+      {
+         const stack_allocator_scope arena(thread_index());
+#pragma omp for schedule(static)
+         for(std::size_t p=0; p<n; ++p) {
+            const INDEX var1 = variables[p][0];
+            const INDEX var2 = variables[p][1];
+            auto* f = new PairwiseFactorContainer(GetNumberOfLabels(var1), GetNumberOfLabels(var2), cost(p));
+            ConstructPairwiseFactor(*(f->GetFactor()), var1, var2);
+            pairwiseFactor_[first + p] = f;
+         }
+      }
+      lp_->add_factors(pairwiseFactor_.begin() + first, pairwiseFactor_.end());
+
+      std::vector<INDEX> left_degree(unaryFactor_.size(), 0);
+      std::vector<INDEX> right_degree(unaryFactor_.size(), 0);
+      for(const auto& v : variables) {
+         ++left_degree[v[0]];
+         ++right_degree[v[1]];
+      }
+      two_dim_variable_array<INDEX> left_incident(left_degree.begin(), left_degree.end());
+      two_dim_variable_array<INDEX> right_incident(right_degree.begin(), right_degree.end());
+      std::fill(left_degree.begin(), left_degree.end(), 0);
+      std::fill(right_degree.begin(), right_degree.end(), 0);
+      for(INDEX p=0; p<n; ++p) {
+         left_incident(variables[p][0], left_degree[variables[p][0]]++) = p;
+         right_incident(variables[p][1], right_degree[variables[p][1]]++) = p;
+      }
+
+      std::vector<LeftMessageContainer*> left_messages(n);
+#pragma omp parallel
+      {
+         const stack_allocator_scope arena(thread_index());
+#pragma omp for schedule(dynamic,1024)
+         for(INDEX i=0; i<unaryFactor_.size(); ++i) {
+            for(const INDEX p : left_incident[i]) {
+               auto* f = pairwiseFactor_[first + p];
+               left_messages[p] = lp_->template connect_message<LeftMessageContainer>(unaryFactor_[i], f, ConstructLeftUnaryPairwiseMessage(unaryFactor_[i], f));
+            }
+         }
+      }
+      std::vector<RightMessageContainer*> right_messages(n);
+#pragma omp parallel
+      {
+         const stack_allocator_scope arena(thread_index());
+#pragma omp for schedule(dynamic,1024)
+         for(INDEX i=0; i<unaryFactor_.size(); ++i) {
+            for(const INDEX p : right_incident[i]) {
+               auto* f = pairwiseFactor_[first + p];
+               right_messages[p] = lp_->template connect_message<RightMessageContainer>(unaryFactor_[i], f, ConstructRightUnaryPairwiseMessage(unaryFactor_[i], f));
+            }
+         }
+      }
+      lp_->add_messages(left_messages.begin(), left_messages.end());
+      lp_->add_messages(right_messages.begin(), right_messages.end());
+
+      std::vector<std::array<FactorTypeAdapter*,2>> relations;
+      relations.reserve(2*n);
+      for(INDEX p=0; p<n; ++p) {
+         relations.push_back({unaryFactor_[variables[p][0]], pairwiseFactor_[first + p]});
+         relations.push_back({pairwiseFactor_[first + p], unaryFactor_[variables[p][1]]});
+      }
+      lp_->AddFactorRelations(relations.begin(), relations.end());
+   }
+
 
    UnaryFactorContainer* GetUnaryFactor(const INDEX i) const { assert(i<unaryFactor_.size()); return unaryFactor_[i]; }
    PairwiseFactorContainer* GetPairwiseFactor(const INDEX i) const { assert(i<pairwiseFactor_.size()); return pairwiseFactor_[i]; }
@@ -112,19 +234,27 @@ public:
       return pairwiseFactor_[factor_id]; 
    }
 
-   LeftMessageContainer* get_left_message(const INDEX i, const INDEX j) const
+   const LeftMessageContainer* get_left_message(const INDEX i, const INDEX j) const
    {
       assert(i < j);
-      auto* f = GetPairwiseFactor(i,j);
+      return get_left_message(GetPairwiseFactorId(i,j));
+   }
+   const LeftMessageContainer* get_left_message(const INDEX pairwise_id) const
+   {
+      auto* f = GetPairwiseFactor(pairwise_id);
       auto msgs = f->template get_messages<LeftMessageContainer>();
       assert(msgs.size() == 1);
       return msgs[0];
    }
 
-   RightMessageContainer* get_right_message(const INDEX i, const INDEX j) const
+   const RightMessageContainer* get_right_message(const INDEX i, const INDEX j) const
    {
       assert(i < j);
-      auto* f = GetPairwiseFactor(i,j);
+      return get_right_message(GetPairwiseFactorId(i,j));
+   }
+   const RightMessageContainer* get_right_message(const INDEX pairwise_id) const
+   {
+      auto* f = GetPairwiseFactor(pairwise_id);
       auto msgs = f->template get_messages<RightMessageContainer>();
       assert(msgs.size() == 1);
       return msgs[0];
@@ -177,162 +307,216 @@ public:
       assert(pairwiseIndices_.size() == pairwiseFactor_.size());
    }
 
+   // labels of the unary factors correspond to the given labels of the original model, e.g. after presolve removed labels
+   void set_original_labels(const two_dim_variable_array<INDEX>& original_labels)
+   {
+      assert(original_labels.size() == unaryFactor_.size());
+      original_labels_ = original_labels;
+   }
+
+   INDEX original_label(const INDEX i, const INDEX label) const
+   {
+      return original_labels_.size() > 0 ? original_labels_(i,label) : label;
+   }
+
    template<typename STREAM>
    void WritePrimal(STREAM& s) const 
    {
       if(unaryFactor_.size() > 0) {
          for(INDEX i=0; i<unaryFactor_.size()-1; ++i) {
-            s << unaryFactor_[i]->GetFactor()->primal() << ", ";
+            s << original_label(i, unaryFactor_[i]->GetFactor()->primal()) << ", ";
          }
          auto* f = unaryFactor_.back();
-         s << f->GetFactor()->primal() << "\n";
+         s << original_label(unaryFactor_.size()-1, f->GetFactor()->primal()) << "\n";
       }
    }
 
   // build tree of unary and pairwise factors
-  LP_tree add_tree(std::vector<PairwiseFactorContainer*> p)
+  factor_tree<FMC> add_tree(const std::vector<PairwiseFactorContainer*>& p) const
   {
-     LP_tree t;
-     assert(p.size() > 0);
-
-     // extract messages joining unaries and pairwise
-     std::set<UnaryFactorContainer*> u_set; // u_set is not strictly needed, but helps in checking correctness of algorithm
-     std::set<PairwiseFactorContainer*> p_set;
-     std::vector<std::tuple<Chirality, MessageTypeAdapter*>> ordered_msgs;
-     UnaryFactorContainer* root = nullptr;
+     // pairwise factors are given by pointer, recover their ids
+     const auto& sorted_pairwise = sorted_pairwise_factors();
+     std::vector<INDEX> pairwise_ids;
+     pairwise_ids.reserve(p.size());
      for(auto* f : p) {
-        p_set.insert(f); 
-
-        auto left_msgs = f->template get_messages<LeftMessageContainer>();
-        assert(left_msgs.size() == 1);
-        UnaryFactorContainer* left = (*left_msgs.begin())->GetLeftFactor();
-        u_set.insert(left);
-
-        auto right_msgs = f->template get_messages<RightMessageContainer>();
-        assert(right_msgs.size() == 1);
-        UnaryFactorContainer* right = (*right_msgs.begin())->GetLeftFactor(); 
-        u_set.insert(right);
-
-        assert(left != right);
-
-        root = left;
+        auto it = std::lower_bound(sorted_pairwise.begin(), sorted_pairwise.end(), std::make_tuple(f, INDEX(0)));
+        assert(it != sorted_pairwise.end() && std::get<0>(*it) == f);
+        pairwise_ids.push_back(std::get<1>(*it));
      }
+     return add_tree(pairwise_ids);
+  }
 
-     // assume some arbitrary root. build tree recursively from root
-     assert(u_set.size() == p_set.size() + 1);
-
-     std::deque<UnaryFactorContainer*> u_stack;
-     u_stack.push_back(root);
-
-     while(!u_stack.empty()) {
-        auto* f = u_stack.front();
-        u_stack.pop_front();
-        u_set.erase(f);
-
-        {
-           auto msgs = f->template get_messages<LeftMessageContainer>();
-           for(auto it=msgs.begin(); it!= msgs.end(); ++it) {
-              auto* p_cand = (*it)->GetRightFactor();
-              if(p_set.find(p_cand) != p_set.end()) {
-                 p_set.erase(p_cand);
-                 //t.AddMessage((*it), Chirality::left); // or right?
-                 ordered_msgs.push_back(std::make_tuple(Chirality::left, *it));
-                 // search for the other unary connected to p_cand
-                 auto msgs_other = p_cand->template get_messages<RightMessageContainer>();
-                 assert(msgs_other.size() == 1);
-                 auto* u_other = (*msgs_other.begin())->GetLeftFactor();
-                 assert(u_set.find(u_other) != u_set.end());
-                 //t.AddMessage(*(msgs_other.begin()), Chirality::right);
-                 ordered_msgs.push_back(std::make_tuple(Chirality::right, *(msgs_other.begin())));
-                 u_stack.push_back(u_other);
-              }
-           }
+  // pairwise factors with their ids sorted by address. Pairwise factors are only appended, hence the cache is rebuilt when their number changes.
+  const std::vector<std::tuple<PairwiseFactorContainer*, INDEX>>& sorted_pairwise_factors() const
+  {
+     if(sorted_pairwise_.size() != pairwiseFactor_.size()) {
+        sorted_pairwise_.clear();
+        sorted_pairwise_.reserve(pairwiseFactor_.size());
+        for(INDEX i=0; i<pairwiseFactor_.size(); ++i) {
+           sorted_pairwise_.push_back(std::make_tuple(pairwiseFactor_[i], i));
         }
+        std::sort(sorted_pairwise_.begin(), sorted_pairwise_.end());
+     }
+     return sorted_pairwise_;
+  }
 
-        {
-           auto msgs = f->template get_messages<RightMessageContainer>();
-           for(auto it=msgs.begin(); it!= msgs.end(); ++it) {
-              auto* p_cand = (*it)->GetRightFactor();
-              if(p_set.find(p_cand) != p_set.end()) {
-                 p_set.erase(p_cand);
-                 //t.AddMessage((*it), Chirality::left); // or right?
-                 ordered_msgs.push_back(std::make_tuple(Chirality::left, *it));
-                 // search for the other unary connected to p_cand
-                 auto msgs_other = p_cand->template get_messages<LeftMessageContainer>();
-                 assert(msgs_other.size() == 1);
-                 auto* u_other = (*msgs_other.begin())->GetLeftFactor();
-                 assert(u_set.find(u_other) != u_set.end());
-                 //t.AddMessage(*(msgs_other.begin()), Chirality::right);
-                 ordered_msgs.push_back(std::make_tuple(Chirality::right, *(msgs_other.begin())));
-                 u_stack.push_back(u_other);
-              }
-           }
+  // pairwise_ids must form a tree in the MRF graph
+  factor_tree<FMC> add_tree(const std::vector<INDEX>& pairwise_ids) const
+  {
+     factor_tree<FMC> t;
+     assert(pairwise_ids.size() > 0);
+
+     // incidence list of nodes and pairwise factors of tree, sorted by node
+     std::vector<std::array<INDEX,2>> incidence; // (node, position in pairwise_ids)
+     incidence.reserve(2*pairwise_ids.size());
+     for(INDEX k=0; k<pairwise_ids.size(); ++k) {
+        const auto vars = pairwiseIndices_[pairwise_ids[k]];
+        assert(vars[0] != vars[1]);
+        incidence.push_back({vars[0], k});
+        incidence.push_back({vars[1], k});
+     }
+     std::sort(incidence.begin(), incidence.end());
+
+     // assume some arbitrary root. build tree by breadth first search from root
+     struct tree_edge { Chirality c; bool left_msg; INDEX pairwise_id; };
+     std::vector<tree_edge> ordered_msgs;
+     ordered_msgs.reserve(2*pairwise_ids.size());
+     std::vector<char> pairwise_visited(pairwise_ids.size(), false);
+     std::deque<INDEX> u_queue;
+     u_queue.push_back(pairwiseIndices_[pairwise_ids[0]][0]);
+
+     while(!u_queue.empty()) {
+        const INDEX u = u_queue.front();
+        u_queue.pop_front();
+
+        auto it = std::lower_bound(incidence.begin(), incidence.end(), std::array<INDEX,2>({u,0}));
+        for(; it != incidence.end() && (*it)[0] == u; ++it) {
+           const INDEX k = (*it)[1];
+           if(pairwise_visited[k]) { continue; }
+           pairwise_visited[k] = true;
+           const INDEX p_id = pairwise_ids[k];
+           const auto vars = pairwiseIndices_[p_id];
+           const bool u_left = (vars[0] == u);
+           // unary u is nearer to the root than the pairwise factor, the pairwise factor is nearer to the root than the other unary
+           ordered_msgs.push_back({Chirality::left, u_left, p_id});
+           ordered_msgs.push_back({Chirality::right, !u_left, p_id});
+           u_queue.push_back(u_left ? vars[1] : vars[0]);
         }
      }
 
-     assert(p_set.empty());
+     assert(std::count(pairwise_visited.begin(), pairwise_visited.end(), false) == 0); // otherwise pairwise factors are not connected
+     assert(ordered_msgs.size() == 2*pairwise_ids.size());
 
-     std::reverse(ordered_msgs.begin(), ordered_msgs.end());
-     for(auto e : ordered_msgs) {
-        t.AddMessage(std::get<1>(e), std::get<0>(e));
+     // messages must be added from leaves to root
+     for(auto it=ordered_msgs.rbegin(); it!=ordered_msgs.rend(); ++it) {
+        if(it->left_msg) {
+           t.add_message(get_left_message(it->pairwise_id), it->c);
+        } else {
+           t.add_message(get_right_message(it->pairwise_id), it->c);
+        }
      }
 
-     t.init();
-
-     t.compute_subgradient();
-     assert(std::abs(t.lower_bound() - t.primal_cost()) <= eps);
-
-     return std::move(t);
+     t.populate_factors();
+     return t;
   }
 
-  // compute forest cover of MRF and add each resulting tree
-
-  auto compute_forest_cover()
+  // Compute forest cover of MRF and build a tree for each connected component of each forest.
+  // Forests are edge-disjoint and each one is a maximal spanning forest of the edges not covered by previous ones (greedy Kruskal with union find).
+  // Hence every pairwise factor occurs in exactly one tree, only unary factors are shared between trees and the number of forests is at most twice the arboricity.
+  // Edges are visited by decreasing number of uncovered edges at their endpoints, so that high degree nodes are covered by few forests, which keeps the number of Lagrangean variables small.
+  std::vector<factor_tree<FMC>> compute_forest_cover() const
   {
      return compute_forest_cover(pairwiseIndices_);
   }
-  std::vector<LP_tree> compute_forest_cover(const std::vector<std::array<INDEX,2>>& pairwiseIndices)
+  std::vector<factor_tree<FMC>> compute_forest_cover(const std::vector<std::array<INDEX,2>>& pairwiseIndices) const
   {
-     UndirectedGraph g = UndirectedGraph(unaryFactor_.size(), pairwiseFactor_.size());
+     const INDEX no_nodes = unaryFactor_.size();
+     std::vector<INDEX> uncovered_degree(no_nodes, 0);
      for(auto e : pairwiseIndices) {
-        const auto i = e[0];
-        const auto j = e[1];
-        g.AddEdge(i,j,1);
+        uncovered_degree[e[0]]++;
+        uncovered_degree[e[1]]++;
      }
-     
-     const INDEX forest_num = g.Solve();
-     std::cout << "decomposed mrf into " << forest_num << " trees\n";
-     std::vector<LP_tree> trees;
-
-     std::vector<int> parents(unaryFactor_.size());
-     for(INDEX k=0; k<forest_num; ++k) {
-        g.GetForestParents(k, parents.data()); // possible GetForestEdges will return pairwise ids, hence GetPairwiseFactor(id) then can be called, which is faster
-
-        UnionFind uf(unaryFactor_.size());
-        for(INDEX i=0; i<parents.size(); ++i) {
-           if(parents[i] != -1) {
-              uf.merge(i, parents[i]);
+
+     std::vector<INDEX> uncovered_edges(pairwiseIndices.size());
+     std::iota(uncovered_edges.begin(), uncovered_edges.end(), 0);
+     std::vector<INDEX> remaining_edges;
+     std::vector<INDEX> forest_edges;
+     std::vector<std::vector<INDEX>> pairwise; // pairwise factor ids of each tree of current forest
+     std::vector<factor_tree<FMC>> trees;
+     std::vector<INDEX> no_trees_per_node(no_nodes, 0);
+     std::vector<char> node_in_forest(no_nodes);
+     INDEX forest_num = 0;
+
+     while(!uncovered_edges.empty()) {
+        std::stable_sort(uncovered_edges.begin(), uncovered_edges.end(), [&](const INDEX e1, const INDEX e2) {
+              return uncovered_degree[pairwiseIndices[e1][0]] + uncovered_degree[pairwiseIndices[e1][1]] > uncovered_degree[pairwiseIndices[e2][0]] + uncovered_degree[pairwiseIndices[e2][1]];
+              });
+
+        UnionFind uf(no_nodes);
+        remaining_edges.clear();
+        forest_edges.clear();
+        for(const INDEX e : uncovered_edges) {
+           const INDEX i = pairwiseIndices[e][0];
+           const INDEX j = pairwiseIndices[e][1];
+           if(uf.connected(i,j)) {
+              remaining_edges.push_back(e);
+           } else {
+              uf.merge(i,j);
+              forest_edges.push_back(e);
            }
         }
+        for(const INDEX e : forest_edges) {
+           uncovered_degree[pairwiseIndices[e][0]]--;
+           uncovered_degree[pairwiseIndices[e][1]]--;
+        }
+
+        // split forest into its connected components
         auto contiguous_ids = uf.get_contiguous_ids();
-        
         const INDEX no_trees = uf.count();
-        std::vector<std::vector<PairwiseFactorContainer*>> pairwise(no_trees);
-
-        for(INDEX i=0; i<parents.size(); ++i) {
-           if(parents[i] != -1) {
-              const INDEX tree_id = contiguous_ids[uf.find(i)];
-              const INDEX j = parents[i];
-              assert(tree_id == contiguous_ids[uf.find(j)]);
-              PairwiseFactorContainer* p = GetPairwiseFactor(std::min(i,j), std::max(i,j));
-              pairwise[tree_id].push_back(p);
-           } 
+        pairwise.clear();
+        pairwise.resize(no_trees);
+        for(const INDEX e : forest_edges) {
+           const INDEX i = pairwiseIndices[e][0];
+           const INDEX j = pairwiseIndices[e][1];
+           const INDEX tree_id = contiguous_ids[uf.find(i)];
+           assert(tree_id == contiguous_ids[uf.find(j)]);
+           pairwise[tree_id].push_back(GetPairwiseFactorId(std::min(i,j), std::max(i,j)));
         }
         for(INDEX t=0; t<no_trees; ++t) {
            if(pairwise[t].size() > 0) {
-              trees.push_back(add_tree(pairwise[t])); 
+              trees.push_back(add_tree(pairwise[t]));
            }
         }
+        // every node is contained in at most one tree of a forest
+        std::fill(node_in_forest.begin(), node_in_forest.end(), false);
+        for(const INDEX e : forest_edges) {
+           node_in_forest[pairwiseIndices[e][0]] = true;
+           node_in_forest[pairwiseIndices[e][1]] = true;
+        }
+        for(INDEX i=0; i<no_nodes; ++i) {
+           no_trees_per_node[i] += node_in_forest[i];
+        }
+
+        std::swap(uncovered_edges, remaining_edges);
+        ++forest_num;
+     }
+
+     // unary factors without pairwise factors form trees of their own
+     for(INDEX i=0; i<no_nodes; ++i) {
+        if(no_trees_per_node[i] == 0) {
+           factor_tree<FMC> t;
+           t.add_factor(unaryFactor_[i]);
+           t.populate_factors();
+           trees.push_back(t);
+        }
+     }
+
+     if(diagnostics()) {
+        std::size_t no_unary_copies = 0;
+        for(INDEX i=0; i<no_nodes; ++i) {
+           if(no_trees_per_node[i] > 1) { no_unary_copies += no_trees_per_node[i]; }
+        }
+        std::cout << "decomposed mrf into " << forest_num << " forests with " << trees.size() << " trees, " << no_unary_copies << " copies of shared unary factors\n";
      }
 
      auto check_pairwise_factors_present = [&trees]() -> INDEX {
@@ -348,7 +532,19 @@ public:
      };
      assert(check_pairwise_factors_present() == pairwiseIndices.size());
 
-     return std::move(trees);
+     return trees;
+  }
+
+  // automatically decompose the MRF into trees and hand them to a tree decomposition based solver, e.g. LP_subgradient_ascent, LP_tree_FWMAP or LP_conic_bundle.
+  // Unary factors not adjacent to any pairwise factor are single factor trees.
+  template<typename LP_TYPE>
+  INDEX add_forest_cover(LP_TYPE& lp) const
+  {
+     auto trees = compute_forest_cover();
+     for(auto& t : trees) {
+        lp.add_tree(t);
+     }
+     return trees.size();
   }
 
 protected:
@@ -358,6 +554,9 @@ protected:
    std::vector<std::array<INDEX,2>> pairwiseIndices_;
 
    std::map<std::tuple<INDEX,INDEX>, INDEX> pairwiseMap_; // given two sorted indices, return factorId belonging to that index.
+   mutable std::vector<std::tuple<PairwiseFactorContainer*, INDEX>> sorted_pairwise_; // see sorted_pairwise_factors()
+
+   two_dim_variable_array<INDEX> original_labels_; // empty if labels are not reduced
 
    //INDEX unaryFactorIndexBegin_, unaryFactorIndexEnd_; // do zrobienia: not needed anymore
 
@@ -583,6 +782,13 @@ public:
       return tripletIndices_[factor_id];
    }
 
+   // index structures of added triplets; the triplet factors themselves are accounted for by the LP
+   void add_memory(memory_report& r) const
+   {
+      const std::size_t map_node_size = sizeof(typename decltype(tripletMap_)::value_type) + 4*sizeof(void*); // estimate of red-black tree node
+      r.add("tightening", "triplet index", tripletFactor_.size(), memory_in_bytes(tripletFactor_) + memory_in_bytes(tripletIndices_) + tripletMap_.size()*map_node_size);
+   }
+
    void AddEmptyPairwiseFactor(const INDEX var1, const INDEX var2)
    {
       assert(this->pairwiseMap_.find(std::make_tuple(var1,var2)) == this->pairwiseMap_.end()); 
@@ -0,0 +1,355 @@
+#ifndef LP_MP_UAI_MMAP_INPUT_HXX
+#define LP_MP_UAI_MMAP_INPUT_HXX
+
+#include "config.hxx"
+#include "vector.hxx"
+#include "two_dimensional_variable_array.hxx"
+#include "mapped_file.hxx"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <iostream>
+
+namespace LP_MP {
+
+// fast path for reading large graphical models in uai format (see UaiMrfInput for the PEGTL grammar).
+// The file is memory mapped, the small header (cardinalities and clique scopes) is read sequentially.
+// The function tables make up almost all of the file. Their layout is determined by the clique scopes, hence they are split into chunks on line boundaries which are parsed in parallel, directly into preallocated cost storage.
+namespace UaiMrfMmapInput {
+
+   struct mrf_input {
+      INDEX number_of_variables_;
+      std::vector<INDEX> cardinality_;
+      two_dim_variable_array<INDEX> clique_scopes_;
+      // unary costs of variable i are held contiguously in unary_costs_[unary_offsets_[i]], ..., unary_costs_[unary_offsets_[i+1]-1]. Variables without unary function table have zero costs.
+      std::vector<std::size_t> unary_offsets_;
+      std::vector<REAL> unary_costs_;
+      // pairwise costs are stored with the smaller variable as first dimension
+      std::vector<std::array<INDEX,2>> pairwise_variables_;
+      std::vector<matrix<REAL>> pairwise_costs_;
+   };
+
+   inline bool is_whitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+   inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+
+   inline const char* skip_whitespace(const char* p, const char* end)
+   {
+      while(p < end && is_whitespace(*p)) { ++p; }
+      return p;
+   }
+   inline const char* token_end(const char* p, const char* end)
+   {
+      while(p < end && !is_whitespace(*p)) { ++p; }
+      return p;
+   }
+
+   // parse nonnegative integer [begin,end)
+   inline bool parse_index(const char* begin, const char* end, INDEX& x)
+   {
+      if(begin == end) { return false; }
+      std::uint64_t val = 0;
+      for(const char* p=begin; p<end; ++p) {
+         if(!is_digit(*p)) { return false; }
+         val = 10*val + (*p - '0');
+         if(val > std::numeric_limits<INDEX>::max()) { return false; }
+      }
+      x = val;
+      return true;
+   }
+
+   // parse real number [begin,end).
+   // Numbers with at most 19 significant digits and decimal exponent of at most 22 in magnitude are converted exactly by a single floating point multiplication or division (Clinger's fast path), hence the result is the same as with std::stod.
+   // All other tokens (long mantissas, large exponents, inf) go through strtod.
+   inline bool parse_real(const char* begin, const char* end, REAL& x)
+   {
+      static constexpr double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+      auto parse_slow = [&]() {
+         const std::string token(begin, end);
+         char* token_end;
+         x = std::strtod(token.c_str(), &token_end);
+         return token_end == token.c_str() + token.size() && token.size() > 0;
+      };
+
+      const char* p = begin;
+      bool negative = false;
+      if(p < end && (*p == '-' || *p == '+')) { negative = (*p == '-'); ++p; }
+
+      std::uint64_t mantissa = 0;
+      int significant_digits = 0;
+      int exponent = 0;
+      bool has_digits = false;
+      for(; p < end && is_digit(*p); ++p) {
+         has_digits = true;
+         mantissa = 10*mantissa + (*p - '0');
+         if(mantissa != 0 && ++significant_digits > 19) { return parse_slow(); }
+      }
+      if(p < end && *p == '.') {
+         ++p;
+         for(; p < end && is_digit(*p); ++p) {
+            has_digits = true;
+            mantissa = 10*mantissa + (*p - '0');
+            --exponent;
+            if(mantissa != 0 && ++significant_digits > 19) { return parse_slow(); }
+         }
+      }
+      if(!has_digits) { return parse_slow(); }
+      if(p < end && (*p == 'e' || *p == 'E')) {
+         ++p;
+         bool negative_exponent = false;
+         if(p < end && (*p == '-' || *p == '+')) { negative_exponent = (*p == '-'); ++p; }
+         if(p == end || !is_digit(*p)) { return false; }
+         int e = 0;
+         for(; p < end && is_digit(*p); ++p) {
+            e = 10*e + (*p - '0');
+            if(e > 100000) { return parse_slow(); }
+         }
+         exponent += negative_exponent ? -e : e;
+      }
+      if(p != end) { return parse_slow(); }
+
+      if(mantissa == 0) {
+         x = negative ? -0.0 : 0.0;
+         return true;
+      }
+      if(mantissa > (std::uint64_t(1) << 53) || exponent < -22 || exponent > 22) { return parse_slow(); }
+      double val = double(mantissa);
+      val = exponent < 0 ? val / powers_of_ten[-exponent] : val * powers_of_ten[exponent];
+      x = negative ? -val : val;
+      return true;
+   }
+
+   // sequential reader for the header part
+   class header_reader {
+   public:
+      header_reader(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+      std::pair<const char*, const char*> next_token()
+      {
+         p_ = skip_whitespace(p_, end_);
+         const char* b = p_;
+         p_ = token_end(p_, end_);
+         return {b, p_};
+      }
+      INDEX read_index(const char* what)
+      {
+         const auto t = next_token();
+         INDEX x;
+         if(!parse_index(t.first, t.second, x)) {
+            throw std::runtime_error(std::string("uai input: could not read ") + what + ", got \"" + std::string(t.first, t.second) + "\"");
+         }
+         return x;
+      }
+      const char* position() const { return p_; }
+
+   private:
+      const char* p_;
+      const char* end_;
+   };
+
+   inline mrf_input parse(const char* begin, const char* end)
+   {
+      header_reader header(begin, end);
+      const auto init_line = header.next_token();
+      if(std::string(init_line.first, init_line.second) != "MARKOV") {
+         throw std::runtime_error("uai input: only MARKOV networks supported");
+      }
+
+      mrf_input input;
+      input.number_of_variables_ = header.read_index("number of variables");
+      input.cardinality_.reserve(input.number_of_variables_);
+      for(INDEX i=0; i<input.number_of_variables_; ++i) {
+         input.cardinality_.push_back(header.read_index("cardinality"));
+         if(input.cardinality_.back() == 0) { throw std::runtime_error("uai input: variable " + std::to_string(i) + " has no labels"); }
+      }
+
+      const INDEX no_cliques = header.read_index("number of cliques");
+      std::vector<INDEX> scope_sizes;
+      std::vector<INDEX> scope_variables;
+      scope_sizes.reserve(no_cliques);
+      scope_variables.reserve(2*no_cliques);
+      for(INDEX c=0; c<no_cliques; ++c) {
+         const INDEX s = header.read_index("clique size");
+         if(s != 1 && s != 2) { throw std::runtime_error("uai input: only unary and pairwise potentials supported"); }
+         scope_sizes.push_back(s);
+         for(INDEX j=0; j<s; ++j) {
+            scope_variables.push_back(header.read_index("clique scope"));
+            if(scope_variables.back() >= input.number_of_variables_) { throw std::runtime_error("uai input: clique scope variable out of range"); }
+         }
+      }
+      input.clique_scopes_.resize(scope_sizes.begin(), scope_sizes.end());
+      for(INDEX c=0, k=0; c<no_cliques; ++c) {
+         for(INDEX j=0; j<input.clique_scopes_[c].size(); ++j, ++k) {
+            input.clique_scopes_(c,j) = scope_variables[k];
+         }
+      }
+
+      // preallocate cost storage and record for each function table where its entries go
+      input.unary_offsets_.resize(input.number_of_variables_+1);
+      input.unary_offsets_[0] = 0;
+      std::partial_sum(input.cardinality_.begin(), input.cardinality_.end(), input.unary_offsets_.begin()+1);
+      input.unary_costs_.resize(input.unary_offsets_.back(), 0.0);
+
+      std::vector<INDEX> table_target(no_cliques); // variable for unary, pairwise index otherwise
+      std::vector<std::size_t> token_offsets(no_cliques+1); // each table is given by its number of entries followed by the entries
+      token_offsets[0] = 0;
+      std::vector<char> has_unary(input.number_of_variables_, 0);
+      std::size_t no_pairwise = 0;
+      for(INDEX c=0; c<no_cliques; ++c) {
+         no_pairwise += (input.clique_scopes_[c].size() == 2);
+      }
+      input.pairwise_variables_.reserve(no_pairwise);
+      input.pairwise_costs_.reserve(no_pairwise);
+      for(INDEX c=0; c<no_cliques; ++c) {
+         const auto scope = input.clique_scopes_[c];
+         if(scope.size() == 1) {
+            if(has_unary[scope[0]]) { throw std::runtime_error("uai input: duplicate unary function table for variable " + std::to_string(scope[0])); }
+            has_unary[scope[0]] = 1;
+            table_target[c] = scope[0];
+            token_offsets[c+1] = token_offsets[c] + 1 + input.cardinality_[scope[0]];
+         } else {
+            const INDEX i = std::min(scope[0], scope[1]);
+            const INDEX j = std::max(scope[0], scope[1]);
+            if(i == j) { throw std::runtime_error("uai input: pairwise clique on a single variable"); }
+            table_target[c] = input.pairwise_costs_.size();
+            input.pairwise_variables_.push_back({i,j});
+            input.pairwise_costs_.emplace_back(input.cardinality_[i], input.cardinality_[j]);
+            token_offsets[c+1] = token_offsets[c] + 1 + std::size_t(input.cardinality_[i]) * input.cardinality_[j];
+         }
+      }
+
+      // split function tables into chunks at line boundaries
+      const char* tables_begin = skip_whitespace(header.position(), end);
+      const std::size_t tables_size = end - tables_begin;
+      const std::size_t min_chunk_size = 1 << 20;
+#ifdef _OPENMP
+      const std::size_t no_threads = omp_get_max_threads();
+#else
+      const std::size_t no_threads = 1;
+#endif
+      const std::size_t no_chunks = std::max(std::size_t(1), std::min(tables_size / min_chunk_size, 8*no_threads));
+      std::vector<const char*> chunk_begin(no_chunks+1);
+      chunk_begin[0] = tables_begin;
+      chunk_begin[no_chunks] = end;
+      for(std::size_t k=1; k<no_chunks; ++k) {
+         const char* p = std::max(chunk_begin[k-1], tables_begin + k*(tables_size/no_chunks));
+         const void* eol = std::memchr(p, '\n', end - p);
+         chunk_begin[k] = eol == nullptr ? end : static_cast<const char*>(eol) + 1;
+      }
+
+      // count tokens in each chunk to know at which function table entry each chunk starts
+      std::vector<std::size_t> chunk_token_offsets(no_chunks+1, 0);
+#pragma omp parallel for schedule(static)
+      for(std::size_t k=0; k<no_chunks; ++k) {
+         std::size_t no_tokens = 0;
+         const char* p = skip_whitespace(chunk_begin[k], chunk_begin[k+1]);
+         while(p < chunk_begin[k+1]) {
+            ++no_tokens;
+            p = skip_whitespace(token_end(p, chunk_begin[k+1]), chunk_begin[k+1]);
+         }
+         chunk_token_offsets[k+1] = no_tokens;
+      }
+      std::partial_sum(chunk_token_offsets.begin(), chunk_token_offsets.end(), chunk_token_offsets.begin());
+      if(chunk_token_offsets.back() != token_offsets.back()) {
+         throw std::runtime_error("uai input: expected " + std::to_string(token_offsets.back()) + " numbers in function tables, got " + std::to_string(chunk_token_offsets.back()));
+      }
+
+      // parse tokens and write them to their place
+      std::vector<std::size_t> first_error(no_chunks, std::numeric_limits<std::size_t>::max());
+#pragma omp parallel for schedule(dynamic)
+      for(std::size_t k=0; k<no_chunks; ++k) {
+         std::size_t token = chunk_token_offsets[k];
+         if(token == chunk_token_offsets[k+1]) { continue; }
+         INDEX c = std::upper_bound(token_offsets.begin(), token_offsets.end(), token) - token_offsets.begin() - 1;
+         const char* p = skip_whitespace(chunk_begin[k], chunk_begin[k+1]);
+         while(p < chunk_begin[k+1]) {
+            const char* t_end = token_end(p, chunk_begin[k+1]);
+            while(token >= token_offsets[c+1]) { ++c; }
+            const auto scope = input.clique_scopes_[c];
+            if(token == token_offsets[c]) { // number of entries of function table
+               INDEX no_entries;
+               if(!parse_index(p, t_end, no_entries) || no_entries != token_offsets[c+1] - token_offsets[c] - 1) {
+                  first_error[k] = token;
+                  break;
+               }
+            } else {
+               const std::size_t entry = token - token_offsets[c] - 1;
+               REAL val;
+               if(!parse_real(p, t_end, val)) {
+                  first_error[k] = token;
+                  break;
+               }
+               if(scope.size() == 1) {
+                  input.unary_costs_[input.unary_offsets_[table_target[c]] + entry] = val;
+               } else {
+                  auto& cost = input.pairwise_costs_[table_target[c]];
+                  const INDEX l0 = entry / input.cardinality_[scope[1]];
+                  const INDEX l1 = entry % input.cardinality_[scope[1]];
+                  if(scope[0] < scope[1]) {
+                     cost(l0,l1) = val;
+                  } else {
+                     cost(l1,l0) = val;
+                  }
+               }
+            }
+            ++token;
+            p = skip_whitespace(t_end, chunk_begin[k+1]);
+         }
+      }
+      const std::size_t error_token = *std::min_element(first_error.begin(), first_error.end());
+      if(error_token != std::numeric_limits<std::size_t>::max()) {
+         const INDEX c = std::upper_bound(token_offsets.begin(), token_offsets.end(), error_token) - token_offsets.begin() - 1;
+         throw std::runtime_error("uai input: malformed entry " + std::to_string(error_token - token_offsets[c]) + " in function table " + std::to_string(c));
+      }
+
+      return input;
+   }
+
+   template<typename MRF_CONSTRUCTOR>
+   void build_mrf(MRF_CONSTRUCTOR& mrf, const mrf_input& input)
+   {
+      mrf.AddUnaryFactors(input.number_of_variables_, [&](const INDEX i) {
+            return std::vector<REAL>(input.unary_costs_.begin() + input.unary_offsets_[i], input.unary_costs_.begin() + input.unary_offsets_[i+1]);
+            });
+      mrf.AddPairwiseFactors(input.pairwise_variables_, [&](const std::size_t p) -> const matrix<REAL>& { return input.pairwise_costs_[p]; });
+   }
+
+   inline mrf_input parse_file(const std::string& filename)
+   {
+      mapped_file file(filename);
+      return parse(file.begin(), file.end());
+   }
+
+   template<typename SOLVER, INDEX PROBLEM_CONSTRUCTOR_NO>
+   bool ParseString(const std::string& instance, SOLVER& s)
+   {
+      std::cout << "parsing string\n";
+      const auto input = parse(instance.data(), instance.data() + instance.size());
+      auto& mrf_constructor = s.template GetProblemConstructor<PROBLEM_CONSTRUCTOR_NO>();
+      build_mrf(mrf_constructor, input);
+      return true;
+   }
+
+   template<typename SOLVER>
+   bool ParseProblem(const std::string& filename, SOLVER& s)
+   {
+      std::cout << "parsing " << filename << "\n";
+      const auto input = parse_file(filename);
+      auto& mrf_constructor = s.template GetProblemConstructor<0>();
+      build_mrf(mrf_constructor, input);
+      return true;
+   }
+}
+
+} // end namespace LP_MP
+
+#endif // LP_MP_UAI_MMAP_INPUT_HXX
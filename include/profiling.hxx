@@ -0,0 +1,192 @@
+#ifndef LP_MP_PROFILING_HXX
+#define LP_MP_PROFILING_HXX
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <iomanip>
+#include <chrono>
+
+#if defined(_MSC_VER) && ( defined(_M_IX86) || defined(_M_X64) )
+#include <intrin.h>
+#define LP_MP_RDTSC
+#elif defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+#include <x86intrin.h>
+#define LP_MP_RDTSC
+#endif
+
+// Counters of calls, cycles and bytes touched in factor updates and message operations, per factor resp. message type.
+// Counting is compiled in only when LP_MP_PROFILING is defined, otherwise LP_MP_PROFILE expands to nothing and no counters are ever filled.
+// Each thread counts into its own table, hence counting needs no synchronization. Tables are summed up when queried, which must not happen while passes are running.
+// Counters are inclusive: an update of a factor also counts the message operations and the MaximizePotential call it performs.
+
+namespace LP_MP {
+namespace profiling {
+
+enum class counter { update_factor, update_factor_primal, maximize_potential, receive_message, send_message, send_messages };
+constexpr std::size_t no_counters = 6;
+
+inline const char* counter_name(const counter c)
+{
+   switch(c) {
+      case counter::update_factor: return "update_factor";
+      case counter::update_factor_primal: return "update_factor_primal";
+      case counter::maximize_potential: return "maximize_potential";
+      case counter::receive_message: return "receive_message";
+      case counter::send_message: return "send_message";
+      case counter::send_messages: return "send_messages";
+      default: return "unknown";
+   }
+}
+
+// factor counters are indexed by FACTOR_NO, message counters by MESSAGE_NO
+inline bool counts_factor(const counter c) { return c == counter::update_factor || c == counter::update_factor_primal || c == counter::maximize_potential; }
+
+// cycles from time stamp counter if available, nanoseconds otherwise
+inline std::uint64_t cycles()
+{
+#ifdef LP_MP_RDTSC
+   return __rdtsc();
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct entry {
+   std::uint64_t calls = 0;
+   std::uint64_t cycles = 0;
+   std::uint64_t bytes = 0;
+};
+
+struct record {
+   counter c;
+   std::size_t type_no; // FACTOR_NO or MESSAGE_NO
+   entry e;
+};
+
+class thread_table {
+public:
+   entry& get(const counter c, const std::size_t type_no)
+   {
+      auto& v = entries_[std::size_t(c)];
+      if(type_no >= v.size()) { v.resize(type_no+1); }
+      return v[type_no];
+   }
+   const std::vector<entry>& entries(const counter c) const { return entries_[std::size_t(c)]; }
+   void reset() { for(auto& v : entries_) { v.clear(); } }
+private:
+   std::array<std::vector<entry>, no_counters> entries_;
+};
+
+// tables of all threads that ever counted. Tables are shared with their threads, so that counts of finished threads are kept.
+class registry {
+public:
+   static registry& instance() { static registry r; return r; }
+
+   thread_table& local_table()
+   {
+      thread_local std::shared_ptr<thread_table> table = add_table();
+      return *table;
+   }
+
+   std::vector<record> collect()
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      std::vector<record> records;
+      for(std::size_t c=0; c<no_counters; ++c) {
+         std::vector<entry> sum;
+         for(const auto& t : tables_) {
+            const auto& v = t->entries(counter(c));
+            if(v.size() > sum.size()) { sum.resize(v.size()); }
+            for(std::size_t i=0; i<v.size(); ++i) {
+               sum[i].calls += v[i].calls;
+               sum[i].cycles += v[i].cycles;
+               sum[i].bytes += v[i].bytes;
+            }
+         }
+         for(std::size_t i=0; i<sum.size(); ++i) {
+            if(sum[i].calls > 0) { records.push_back({counter(c), i, sum[i]}); }
+         }
+      }
+      return records;
+   }
+
+   void reset()
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      for(auto& t : tables_) { t->reset(); }
+   }
+
+private:
+   std::shared_ptr<thread_table> add_table()
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      tables_.push_back(std::make_shared<thread_table>());
+      return tables_.back();
+   }
+
+   std::mutex mutex_;
+   std::vector<std::shared_ptr<thread_table>> tables_;
+};
+
+inline std::vector<record> collect() { return registry::instance().collect(); }
+inline void reset() { registry::instance().reset(); }
+
+// counts one call with the cycles between construction and destruction. The bytes touched are computed after the cycles are taken.
+template<typename BYTES_FUNC>
+class scoped_counter {
+public:
+   scoped_counter(const counter c, const std::size_t type_no, BYTES_FUNC bytes) : c_(c), type_no_(type_no), bytes_(bytes), begin_(cycles()) {}
+   ~scoped_counter()
+   {
+      const std::uint64_t end = cycles();
+      auto& e = registry::instance().local_table().get(c_, type_no_);
+      e.calls++;
+      e.cycles += end - begin_;
+      e.bytes += bytes_();
+   }
+private:
+   const counter c_;
+   const std::size_t type_no_;
+   BYTES_FUNC bytes_;
+   const std::uint64_t begin_;
+};
+
+inline void print_table(std::ostream& s, const std::vector<record>& records)
+{
+   s << std::left << std::setw(22) << "operation" << std::setw(12) << "type" << std::right << std::setw(14) << "calls" << std::setw(18) << "cycles" << std::setw(14) << "cycles/call" << std::setw(18) << "bytes" << "\n";
+   for(const auto& r : records) {
+      const std::string type = (counts_factor(r.c) ? "factor " : "message ") + std::to_string(r.type_no);
+      s << std::left << std::setw(22) << counter_name(r.c) << std::setw(12) << type << std::right
+        << std::setw(14) << r.e.calls << std::setw(18) << r.e.cycles << std::setw(14) << r.e.cycles/r.e.calls << std::setw(18) << r.e.bytes << "\n";
+   }
+}
+
+inline void print_json(std::ostream& s, const std::vector<record>& records)
+{
+   s << "[";
+   for(std::size_t i=0; i<records.size(); ++i) {
+      const auto& r = records[i];
+      s << (i > 0 ? ",\n " : "\n ") << "{\"operation\": \"" << counter_name(r.c) << "\", \"" << (counts_factor(r.c) ? "factor" : "message") << "\": " << r.type_no
+        << ", \"calls\": " << r.e.calls << ", \"cycles\": " << r.e.cycles << ", \"bytes\": " << r.e.bytes << "}";
+   }
+   s << "\n]\n";
+}
+
+} // end namespace profiling
+} // end namespace LP_MP
+
+#ifdef LP_MP_PROFILING
+#define LP_MP_PROFILE_CONCAT_(A,B) A##B
+#define LP_MP_PROFILE_CONCAT(A,B) LP_MP_PROFILE_CONCAT_(A,B)
+#define LP_MP_PROFILE(COUNTER, TYPE_NO, BYTES) \
+   LP_MP::profiling::scoped_counter LP_MP_PROFILE_CONCAT(lp_mp_profile_, __LINE__)(LP_MP::profiling::counter::COUNTER, TYPE_NO, [&]() -> std::uint64_t { return BYTES; })
+#else
+#define LP_MP_PROFILE(COUNTER, TYPE_NO, BYTES)
+#endif
+
+#endif // LP_MP_PROFILING_HXX
@@ -12,6 +12,7 @@
 #include "function_existence.hxx"
 #include "template_utilities.hxx"
 #include "static_if.hxx"
+#include "profiling.hxx"
 #include "tclap/CmdLine.h"
 
 namespace LP_MP {
@@ -58,6 +59,9 @@ private:
         inputFileArg_("i","inputFile","file from which to read problem instance",false,"","file name",cmd_),
         outputFileArg_("o","outputFile","file to write solution",false,"","file name",cmd_),
         verbosity_arg_("v","verbosity","verbosity level: 0 = silent, 1 = important runtime information, 2 = further diagnostics",false,1,"0,1,2",cmd_),
+#ifdef LP_MP_PROFILING
+        profiling_format_arg_("","profilingFormat","format of profiling counters written after optimization",false,"table","{table|json}",cmd_),
+#endif
         visitor_(cmd_)
    {
       for_each_tuple(this->problemConstructor_, [this](auto& l) {
@@ -87,6 +91,9 @@ public:
          outputFile_ = outputFileArg_.getValue();
          verbosity = verbosity_arg_.getValue();
          if(verbosity > 2) { throw TCLAP::ArgException("verbosity must be 0,1 or 2"); }
+#ifdef LP_MP_PROFILING
+         if(profiling_format_arg_.getValue() != "table" && profiling_format_arg_.getValue() != "json") { throw TCLAP::ArgException("profiling format must be table or json"); }
+#endif
       } catch (TCLAP::ArgException &e) {
          std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl; 
          exit(1);
@@ -216,6 +223,36 @@ public:
    }
 
    LP_TYPE& GetLP() { return lp_; }
+
+   LP_MP_FUNCTION_EXISTENCE_CLASS(has_add_memory,add_memory)
+   template<typename PROBLEM_CONSTRUCTOR>
+   constexpr static bool
+   CanAddMemory()
+   {
+      return has_add_memory<PROBLEM_CONSTRUCTOR, void, memory_report>();
+   }
+
+   // memory held by the LP and by problem constructors
+   memory_report get_memory_report()
+   {
+      memory_report r = lp_.get_memory_report();
+      for_each_tuple(this->problemConstructor_, [&r](auto* l) {
+            using pc_type = typename std::remove_pointer<decltype(l)>::type;
+            static_if<SolverType::CanAddMemory<pc_type>()>([&](auto f) {
+                  f(*l).add_memory(r);
+            });
+      });
+      return r;
+   }
+
+   // let the visitor inspect memory usage, e.g. for choosing compact modes when near the memory limit
+   LP_MP_FUNCTION_EXISTENCE_CLASS(visitor_has_check_memory,check_memory)
+   void CheckMemory()
+   {
+      static_if<visitor_has_check_memory<VISITOR, void, LP_TYPE, const memory_report>()>([this](auto f) {
+            f(this)->visitor_.check_memory(this->lp_, this->get_memory_report());
+      });
+   }
    
    LP_MP_FUNCTION_EXISTENCE_CLASS(has_solution,solution)
    constexpr static bool
@@ -234,6 +271,7 @@ public:
 
       this->Begin();
       LpControl c = visitor_.begin(this->lp_);
+      CheckMemory();
       while(!c.end && !c.error) {
          this->PreIterate(c);
          this->Iterate(c);
@@ -252,9 +290,25 @@ public:
          });
          this->WritePrimal();
       }
+#ifdef LP_MP_PROFILING
+      WriteProfile();
+#endif
       return !c.error;
    }
 
+#ifdef LP_MP_PROFILING
+   void WriteProfile()
+   {
+      if(verbosity == 0) { return; }
+      const auto records = profiling::collect();
+      if(profiling_format_arg_.getValue() == "json") {
+         profiling::print_json(std::cout, records);
+      } else {
+         profiling::print_table(std::cout, records);
+      }
+   }
+#endif
+
 
    // called before first iterations
    virtual void Begin() 
@@ -282,6 +336,7 @@ public:
       }
       if(c.tighten) {
          Tighten(c.tightenConstraints);
+         CheckMemory();
       }
    } 
 
@@ -366,6 +421,9 @@ protected:
    std::string outputFile_;
 
    TCLAP::ValueArg<INDEX> verbosity_arg_;
+#ifdef LP_MP_PROFILING
+   TCLAP::ValueArg<std::string> profiling_format_arg_;
+#endif
 
    REAL lowerBound_;
    // while Solver does not know how to compute primal, derived solvers do know. After computing a primal, they are expected to register their primals with the base solver
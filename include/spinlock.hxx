@@ -2,35 +2,118 @@
 #define LP_MP_SPINLOCK_HXX 
 
 #include <atomic>
+#include <array>
+#include <cstdint>
+#include <cassert>
 
 #if defined(_MSC_VER) && _MSC_VER >= 1310 && ( defined(_M_IX86) || defined(_M_X64) )
 
 extern "C" void _mm_pause();
 
-#define LP_MP_SMT_PAUSE _mm_pause();
+#define LP_MP_PAUSE _mm_pause();
 
 #elif defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
 
 #define LP_MP_PAUSE __asm__ __volatile__( "rep; nop" : : : "memory" );
 
+#else
+
+#define LP_MP_PAUSE
+
 #endif
 
 
-namespace LP_MP { 
+namespace LP_MP {
 
   class spinlock {
     std::atomic_flag locked = ATOMIC_FLAG_INIT ;
     public:
     void lock() {
-      while (locked.test_and_set(std::memory_order_acquire)) { 
+      while (locked.test_and_set(std::memory_order_acquire)) {
         LP_MP_PAUSE
       }
   }
+  bool try_lock() {
+    return !locked.test_and_set(std::memory_order_acquire);
+  }
   void unlock() {
     locked.clear(std::memory_order_release);
   }
 };
 
+  // spinlock in one 32 bit word that may be acquired repeatedly by the thread holding it, as std::recursive_mutex.
+  // Upper 24 bits hold the owning thread, lower 8 bits the recursion depth.
+  // try_lock fails when the owner already holds the lock count_mask times, lock must not be called by the owner then.
+  class recursive_spinlock {
+    std::atomic<std::uint32_t> word_{0};
+
+    static constexpr std::uint32_t count_bits = 8;
+    static constexpr std::uint32_t count_mask = (1u << count_bits) - 1;
+
+    // nonzero id of calling thread
+    static std::uint32_t thread_id()
+    {
+      static std::atomic<std::uint32_t> no_threads{0};
+      thread_local const std::uint32_t id = (no_threads.fetch_add(1, std::memory_order_relaxed) % ((1u << (32-count_bits)) - 1)) + 1;
+      return id;
+    }
+
+    public:
+    bool try_lock() {
+      const std::uint32_t owner = thread_id() << count_bits;
+      std::uint32_t w = word_.load(std::memory_order_relaxed);
+      if((w & ~count_mask) == owner) { // only the owner changes the word while it is held
+        if((w & count_mask) == count_mask) { return false; } // recursion depth saturated, incrementing would change the owner
+        word_.store(w+1, std::memory_order_relaxed);
+        return true;
+      }
+      w = 0;
+      return word_.compare_exchange_strong(w, owner | 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+    void lock() {
+      while(!try_lock()) {
+        assert((word_.load(std::memory_order_relaxed) & ~count_mask) != (thread_id() << count_bits)); // owner would wait for itself
+        LP_MP_PAUSE
+      }
+    }
+    void unlock() {
+      const std::uint32_t w = word_.load(std::memory_order_relaxed);
+      assert((w >> count_bits) == thread_id() && (w & count_mask) > 0);
+      if((w & count_mask) == 1) {
+        word_.store(0, std::memory_order_release);
+      } else {
+        word_.store(w-1, std::memory_order_relaxed);
+      }
+    }
+  };
+  static_assert(sizeof(recursive_spinlock) == 4, "");
+
+  // NO_STRIPES recursive spinlocks shared by all objects, the lock of an object is chosen by its index. Objects hold no lock themselves.
+  // Different objects may share a stripe, hence try_lock may fail although the object itself is not locked.
+  template<std::size_t NO_STRIPES = 4096>
+  class striped_lock {
+    static_assert(NO_STRIPES > 0, "");
+    struct alignas(64) stripe { recursive_spinlock lock; }; // one cache line per stripe
+    static inline std::array<stripe, NO_STRIPES> stripes_;
+    public:
+    static recursive_spinlock& get(const std::size_t i) { return stripes_[(i * 0x9E3779B97F4A7C15ull >> 20) % NO_STRIPES].lock; }
+  };
+
+  // storage of the lock of an object with given index: the lock itself, or nothing for striped locks. Copies of an object are not locked.
+  template<typename LOCK>
+  struct lock_holder {
+    lock_holder() {}
+    lock_holder(const lock_holder&) {}
+    lock_holder& operator=(const lock_holder&) { return *this; }
+    LOCK& get(const std::size_t) { return lock_; }
+    LOCK lock_;
+  };
+
+  template<std::size_t NO_STRIPES>
+  struct lock_holder<striped_lock<NO_STRIPES>> {
+    recursive_spinlock& get(const std::size_t i) { return striped_lock<NO_STRIPES>::get(i); }
+  };
+
 } // end namespace LP_MP
 
 #endif // LP_MP_SPINLOCK_HXX
@@ -0,0 +1,368 @@
+#ifndef LP_MP_STREAMING_LP_EXPORT_HXX
+#define LP_MP_STREAMING_LP_EXPORT_HXX
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#ifdef LP_MP_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include "config.hxx"
+#include "vector.hxx"
+
+// Streaming export of an LP_MP problem into an ILP in (CPLEX) LP format.
+// In contrast to exporting through DD_ILP::problem_export, no model is held in memory:
+// factors are visited twice (objective, then constraints) and messages once, variable numbers are computed on the fly
+// and only one offset per factor is stored.
+// The writer acts as external solver for the construct_constraints and load_costs functions of factors and messages,
+// supporting variables, vectors, matrices and tensors together with
+//   add_simplex_constraint(begin, end), add_at_most_one_constraint(begin, end), make_equal(i,j), add_implication(i,j).
+// MPS is column oriented and cannot be streamed, hence only LP format is written.
+// File names ending in .gz are written gzip compressed if compiled with LP_MP_WITH_ZLIB.
+
+namespace LP_MP {
+
+// buffered output written to file in chunks, optionally compressed
+class chunked_file_writer {
+public:
+  chunked_file_writer(const std::string& filename, const std::size_t chunk_size = 1 << 20)
+  {
+    buffer_.reserve(chunk_size);
+    const bool compress = filename.size() >= 3 && filename.compare(filename.size()-3, 3, ".gz") == 0;
+    if(compress) {
+#ifdef LP_MP_WITH_ZLIB
+      gz_file_ = gzopen(filename.c_str(), "wb");
+      if(gz_file_ == nullptr) { throw std::runtime_error("could not open " + filename); }
+#else
+      throw std::runtime_error("compressed export requires LP_MP_WITH_ZLIB");
+#endif
+    } else {
+      file_ = std::fopen(filename.c_str(), "w");
+      if(file_ == nullptr) { throw std::runtime_error("could not open " + filename); }
+    }
+  }
+
+  // errors cannot be reported from the destructor, call close() to detect them
+  ~chunked_file_writer()
+  {
+    try {
+      close();
+    } catch(const std::exception& e) {
+      std::cerr << e.what() << "\n";
+    }
+  }
+
+  chunked_file_writer(const chunked_file_writer&) = delete;
+  chunked_file_writer& operator=(const chunked_file_writer&) = delete;
+
+  void write(const char* s, const std::size_t n)
+  {
+    if(buffer_.size() + n > buffer_.capacity()) { flush(); }
+    buffer_.insert(buffer_.end(), s, s+n);
+  }
+
+  chunked_file_writer& operator<<(const char* s) { write(s, std::strlen(s)); return *this; }
+  chunked_file_writer& operator<<(const std::string& s) { write(s.data(), s.size()); return *this; }
+  chunked_file_writer& operator<<(const char c) { write(&c, 1); return *this; }
+  chunked_file_writer& operator<<(const std::size_t i)
+  {
+    char s[24];
+    const int n = std::snprintf(s, sizeof(s), "%zu", i);
+    write(s, n);
+    return *this;
+  }
+  chunked_file_writer& operator<<(const REAL x)
+  {
+    char s[32];
+    const int n = std::snprintf(s, sizeof(s), "%.17g", x);
+    write(s, n);
+    return *this;
+  }
+
+  void flush()
+  {
+    if(buffer_.size() == 0) { return; }
+    if(file_ != nullptr) {
+      if(std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        throw std::runtime_error("could not write model file");
+      }
+    }
+#ifdef LP_MP_WITH_ZLIB
+    if(gz_file_ != nullptr) {
+      if(gzwrite(gz_file_, buffer_.data(), buffer_.size()) != int(buffer_.size())) {
+        throw std::runtime_error("could not write compressed model file");
+      }
+    }
+#endif
+    buffer_.clear();
+  }
+
+  // write remaining buffer and close file. Files are closed even if writing fails.
+  void close()
+  {
+    bool success = true;
+    try {
+      flush();
+    } catch(...) {
+      success = false;
+    }
+    buffer_.clear();
+    if(file_ != nullptr) {
+      success = (std::fclose(file_) == 0) && success;
+      file_ = nullptr;
+    }
+#ifdef LP_MP_WITH_ZLIB
+    if(gz_file_ != nullptr) {
+      success = (gzclose(gz_file_) == Z_OK) && success;
+      gz_file_ = nullptr;
+    }
+#endif
+    if(!success) {
+      throw std::runtime_error("could not write model file");
+    }
+  }
+
+private:
+  std::vector<char> buffer_;
+  std::FILE* file_ = nullptr;
+#ifdef LP_MP_WITH_ZLIB
+  gzFile gz_file_ = nullptr;
+#endif
+};
+
+class streaming_lp_export {
+public:
+  using variable = std::size_t;
+
+  struct variable_iterator {
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = variable;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const variable*;
+    using reference = variable;
+
+    variable operator*() const { return v; }
+    variable_iterator& operator++() { ++v; return *this; }
+    variable_iterator operator+(const difference_type i) const { return {variable(v+i)}; }
+    difference_type operator-(const variable_iterator o) const { return difference_type(v) - difference_type(o.v); }
+    bool operator==(const variable_iterator o) const { return v == o.v; }
+    bool operator!=(const variable_iterator o) const { return v != o.v; }
+    variable v;
+  };
+
+  // consecutively numbered variables
+  class vector {
+  public:
+    vector(const variable first, const std::size_t n) : first_(first), n_(n) {}
+    variable operator[](const std::size_t i) const { assert(i < n_); return first_ + i; }
+    std::size_t size() const { return n_; }
+    variable_iterator begin() const { return {first_}; }
+    variable_iterator end() const { return {first_ + n_}; }
+  private:
+    variable first_;
+    std::size_t n_;
+  };
+
+  class matrix : public vector {
+  public:
+    matrix(const variable first, const std::size_t dim1, const std::size_t dim2) : vector(first, dim1*dim2), dim2_(dim2) {}
+    variable operator()(const std::size_t i, const std::size_t j) const { return (*this)[i*dim2_ + j]; }
+    std::size_t dim1() const { return this->size() / dim2_; }
+    std::size_t dim2() const { return dim2_; }
+  private:
+    std::size_t dim2_;
+  };
+
+  class tensor : public vector {
+  public:
+    tensor(const variable first, const std::size_t dim1, const std::size_t dim2, const std::size_t dim3) : vector(first, dim1*dim2*dim3), dim2_(dim2), dim3_(dim3) {}
+    variable operator()(const std::size_t i, const std::size_t j, const std::size_t k) const { return (*this)[i*dim2_*dim3_ + j*dim3_ + k]; }
+    std::size_t dim1() const { return this->size() / (dim2_*dim3_); }
+    std::size_t dim2() const { return dim2_; }
+    std::size_t dim3() const { return dim3_; }
+  private:
+    std::size_t dim2_, dim3_;
+  };
+
+  template<typename LP_TYPE>
+  static void write(LP_TYPE& lp, const std::string& filename)
+  {
+    streaming_lp_export e(filename);
+    e.write_model(lp);
+    e.out_.close();
+  }
+
+  // external solver interface used by factor containers: variables are numbered consecutively from the current offset
+  variable add_variable() { return counter_++; }
+  template<typename VECTOR> vector add_vector(const VECTOR& v) { vector x(counter_, v.size()); counter_ += v.size(); return x; }
+  matrix add_matrix(const LP_MP::matrix<REAL>& m) { matrix x(counter_, m.dim1(), m.dim2()); counter_ += x.size(); return x; }
+  tensor add_tensor(const tensor3<REAL>& t) { tensor x(counter_, t.dim1(), t.dim2(), t.dim3()); counter_ += x.size(); return x; }
+
+  void add_variable_objective(const REAL cost) { add_objective_term(counter_++, cost); }
+  template<typename VECTOR>
+  void add_vector_objective(const VECTOR& cost)
+  {
+    for(std::size_t i=0; i<cost.size(); ++i) { add_objective_term(counter_++, cost[i]); }
+  }
+  void add_matrix_objective(const LP_MP::matrix<REAL>& cost)
+  {
+    for(std::size_t i=0; i<cost.dim1(); ++i) {
+      for(std::size_t j=0; j<cost.dim2(); ++j) {
+        add_objective_term(counter_++, cost(i,j));
+      }
+    }
+  }
+  void add_tensor_objective(const tensor3<REAL>& cost)
+  {
+    for(std::size_t i=0; i<cost.dim1(); ++i) {
+      for(std::size_t j=0; j<cost.dim2(); ++j) {
+        for(std::size_t k=0; k<cost.dim3(); ++k) {
+          add_objective_term(counter_++, cost(i,j,k));
+        }
+      }
+    }
+  }
+
+  template<typename ITERATOR>
+  void add_simplex_constraint(ITERATOR begin, ITERATOR end)
+  {
+    write_sum(begin, end);
+    out_ << " = 1\n";
+  }
+
+  // returns variable that is one iff one of the given variables is one
+  template<typename ITERATOR>
+  variable add_at_most_one_constraint(ITERATOR begin, ITERATOR end)
+  {
+    const variable one_active = aux_counter_++;
+    write_sum(begin, end);
+    out_ << " - ";
+    write_variable(one_active);
+    out_ << " = 0\n";
+    return one_active;
+  }
+
+  void make_equal(const variable i, const variable j)
+  {
+    out_ << ' ';
+    write_variable(i);
+    out_ << " - ";
+    write_variable(j);
+    out_ << " = 0\n";
+  }
+
+  // i => j
+  void add_implication(const variable i, const variable j)
+  {
+    out_ << ' ';
+    write_variable(i);
+    out_ << " - ";
+    write_variable(j);
+    out_ << " <= 0\n";
+  }
+
+private:
+  streaming_lp_export(const std::string& filename) : out_(filename) {}
+
+  template<typename LP_TYPE>
+  void write_model(LP_TYPE& lp)
+  {
+    // objective, determines offsets of factor variables
+    factor_offsets_.resize(lp.GetNumberOfFactors());
+    out_ << "Minimize\n obj:";
+    lp.for_each_factor([&](auto* f) {
+      factor_offsets_[lp.factor_index(f)] = counter_;
+      f->load_costs_impl(*this);
+    });
+    out_ << "\nSubject To\n";
+
+    aux_counter_ = counter_;
+    lp.for_each_factor([&](auto* f) {
+      counter_ = factor_offsets_[lp.factor_index(f)];
+      f->construct_constraints_impl(*this);
+    });
+    lp.for_each_message([&](auto* m) {
+      write_message_constraints(m, factor_offsets_[lp.factor_index(m->GetLeftFactor())], factor_offsets_[lp.factor_index(m->GetRightFactor())]);
+    });
+    for(const variable x : forbidden_) {
+      out_ << ' ';
+      write_variable(x);
+      out_ << " = 0\n";
+    }
+
+    out_ << "Binaries\n";
+    for(variable x=0; x<aux_counter_; ++x) {
+      out_ << ' ';
+      write_variable(x);
+      if(x % terms_per_line == terms_per_line-1) { out_ << '\n'; }
+    }
+    out_ << "\nEnd\n";
+  }
+
+  template<typename MESSAGE_CONTAINER>
+  void write_message_constraints(MESSAGE_CONTAINER* m, const variable left_offset, const variable right_offset)
+  {
+    auto* l = m->GetLeftFactor()->GetFactor();
+    auto* r = m->GetRightFactor()->GetFactor();
+
+    counter_ = left_offset;
+    auto left_vars = std::apply([this](auto&... x) { return std::make_tuple(this->add_variables(x)...); }, l->export_variables());
+    counter_ = right_offset;
+    auto right_vars = std::apply([this](auto&... x) { return std::make_tuple(this->add_variables(x)...); }, r->export_variables());
+
+    auto t = std::tuple_cat(std::tie(*l), left_vars, std::tie(*r), right_vars);
+    std::apply([this,m](auto&... x) { m->GetMessageOp().construct_constraints(*this, x...); }, t);
+  }
+
+  variable add_variables(const REAL) { return add_variable(); }
+  matrix add_variables(const LP_MP::matrix<REAL>& m) { return add_matrix(m); }
+  tensor add_variables(const tensor3<REAL>& t) { return add_tensor(t); }
+  template<typename VECTOR> vector add_variables(const VECTOR& v) { return add_vector(v); }
+
+  void add_objective_term(const variable x, const REAL cost)
+  {
+    if(cost == 0.0) { return; }
+    if(cost == std::numeric_limits<REAL>::infinity()) {
+      forbidden_.push_back(x);
+      return;
+    }
+    assert(std::isfinite(cost));
+    out_ << (cost < 0.0 ? " - " : " + ") << std::abs(cost) << ' ';
+    write_variable(x);
+    if(++no_terms_ % terms_per_line == 0) { out_ << '\n'; }
+  }
+
+  template<typename ITERATOR>
+  void write_sum(ITERATOR begin, ITERATOR end)
+  {
+    std::size_t n = 0;
+    for(auto it=begin; it!=end; ++it, ++n) {
+      out_ << (n == 0 ? " " : " + ");
+      write_variable(*it);
+      if(n % terms_per_line == terms_per_line-1) { out_ << '\n'; } // LP format restricts line length
+    }
+  }
+
+  void write_variable(const variable x) { out_ << 'x' << x; }
+
+  static constexpr std::size_t terms_per_line = 16;
+
+  chunked_file_writer out_;
+  std::vector<variable> factor_offsets_; // indexed by factor index
+  std::vector<variable> forbidden_; // variables with infinite cost
+  variable counter_ = 0; // next variable of current factor
+  variable aux_counter_ = 0; // next auxiliary variable, numbered after all factor variables
+  std::size_t no_terms_ = 0;
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_STREAMING_LP_EXPORT_HXX
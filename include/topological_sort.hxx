@@ -3,31 +3,45 @@
 
 // Compute topological sorting of a DAG
 #include <iostream>
-#include <list>
-#include <stack>
-#include <queue> 
+#include <vector>
+#include <array>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <assert.h>
-#include "help_functions.hxx"
 #include "config.hxx"
+#include "help_functions.hxx"
 
 namespace LP_MP {
 namespace Topological_Sort {
 
-// do zrobienia: detect, when graph is not DAG
+// Edges are collected first and converted to compressed sparse row format when sorting.
+// Sorting is Kahn's algorithm processed level by level: level 0 are the nodes without incoming edges, level l+1 the nodes all whose predecessors are in levels <= l.
+// Nodes of one level have no edges between them; levels with more than parallel_level_size nodes are computed in parallel. Each level is sorted by node index, hence the ordering does not depend on the number of threads.
+// Narrow levels are computed sequentially: chain relations as added by the MRF constructors make the depth of the DAG proportional to its number of nodes, and opening a parallel region for each of these levels costs more than it gains.
+// The level order differs from the depth first order used before only for nodes not connected by a path. Factors ordered by a relation keep their relative order, while factors without a path between them may change their order,
+// e.g. two pairwise factors of an MRF sharing a unary factor. Anisotropic weights compare positions of such factors, hence they and the update sequence of message passing may differ from the depth first order.
 class Graph
 {
     INDEX V;    // number of vertices
-    std::vector<std::list<INDEX> > adj;
+    static constexpr INDEX parallel_level_size = 1024; // minimum number of nodes of a level to process it in parallel
+    std::vector<std::array<INDEX,2>> edges_;
+    std::vector<INDEX> level_offsets_; // nodes of level l are at positions [level_offsets_[l], level_offsets_[l+1]) of the sorting
     bool sorting_valid(const std::vector<INDEX>& ordering) const;
 
 public:
-    inline Graph(INDEX V);   
+    inline Graph(INDEX V);
     inline void addEdge(INDEX v, INDEX w);
+    void reserve_edges(const std::size_t n) { edges_.reserve(n); }
     inline std::vector<INDEX> topologicalSort();
+
+    // valid after topologicalSort
+    INDEX no_levels() const { assert(level_offsets_.size() > 0); return level_offsets_.size()-1; }
+    const std::vector<INDEX>& level_offsets() const { return level_offsets_; }
 };
- 
+
 Graph::Graph(INDEX V)
-   : adj(V)
 {
    this->V = V;
 }
@@ -36,112 +50,111 @@ Graph::Graph(INDEX V)
 inline void Graph::addEdge(INDEX v, INDEX w)
 {
    assert(v<V && w<V);
-   adj[v].push_back(w); 
+   edges_.push_back({v,w});
 }
 
 inline bool Graph::sorting_valid(const std::vector<INDEX>& ordering) const
 {
   std::vector<INDEX> inverse_ordering(ordering.size());
   for(INDEX i=0; i<ordering.size(); ++i) {
-    inverse_ordering[ordering[i]] = i; 
+    inverse_ordering[ordering[i]] = i;
   }
 
    // check validity of sorting
-   for(INDEX i=0; i<adj.size(); ++i) {
-     for(const INDEX j : adj[i]) {
-       assert(inverse_ordering[i] != inverse_ordering[j]);
-       if(inverse_ordering[i] > inverse_ordering[j]) {
-         return false; 
-       }
+   for(const auto& e : edges_) {
+     assert(inverse_ordering[e[0]] != inverse_ordering[e[1]]);
+     if(inverse_ordering[e[0]] > inverse_ordering[e[1]]) {
+       return false;
      }
    }
-   return true; 
+   return true;
 }
 
-
 inline std::vector<INDEX> Graph::topologicalSort()
 {
   if(debug()) {
-    std::cout << "sort " << adj.size() << " elements subject to " << std::accumulate(adj.begin(), adj.end(), INDEX(0), [](INDEX s, auto& a) { return s + a.size(); }) << " ordering constraints\n";
+    std::cout << "sort " << V << " elements subject to " << edges_.size() << " ordering constraints\n";
+  }
+
+  // outgoing edges in compressed sparse row format and in-degrees
+  std::vector<INDEX> offsets(V+1, 0);
+  std::vector<INDEX> in_degree(V, 0);
+#pragma omp parallel for
+  for(std::size_t e=0; e<edges_.size(); ++e) {
+#pragma omp atomic
+    offsets[edges_[e][0]+1]++;
+#pragma omp atomic
+    in_degree[edges_[e][1]]++;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<INDEX> targets(edges_.size());
+  {
+    std::vector<INDEX> pos(offsets.begin(), offsets.end()-1);
+#pragma omp parallel for
+    for(std::size_t e=0; e<edges_.size(); ++e) {
+      INDEX p;
+#pragma omp atomic capture
+      p = pos[edges_[e][0]]++;
+      targets[p] = edges_[e][1];
+    }
   }
-   /*
-   std::vector<bool> visited(V,false);
-   std::vector<INDEX> order;
-   std::deque<SIGNED_INDEX> stack; // change to stack
-
-   for(SIGNED_INDEX i=0; i<V; ++i) {
-      if(visited[i] == false) {
-         visited[i] = true;
-         stack.push_back(i);
-         while(!stack.empty()) {
-            auto v = stack.back();
-            stack.pop_back();
-            if(v>=0) {
-               stack.push_back(-v-1);
-               for(SIGNED_INDEX w : adj[v]) {
-                  // if graph is acyclic, then w may not already be
-                  if(!visited[w]) {
-                     visited[w] = true;
-                     stack.push_back(w); 
-                  } 
-               }
-            } else {
-               order.push_back(-v-1); 
-            } 
-         }
+
+  std::vector<INDEX> order;
+  order.reserve(V);
+  for(INDEX i=0; i<V; ++i) {
+    if(in_degree[i] == 0) { order.push_back(i); }
+  }
+  level_offsets_.assign(1, 0);
+
+  // next level: successors of current level whose last incoming edge is removed. Gathered into slots given by prefix sums of out-degrees.
+  std::vector<INDEX> slot_offsets;
+  std::vector<INDEX> candidates;
+  while(level_offsets_.back() < order.size()) {
+    const INDEX level_begin = level_offsets_.back();
+    const INDEX level_end = order.size();
+    level_offsets_.push_back(level_end);
+
+    slot_offsets.resize(level_end - level_begin + 1);
+    slot_offsets[0] = 0;
+    for(INDEX k=level_begin; k<level_end; ++k) {
+      const INDEX v = order[k];
+      slot_offsets[k-level_begin+1] = slot_offsets[k-level_begin] + offsets[v+1] - offsets[v];
+    }
+    candidates.resize(slot_offsets.back());
+    auto remove_outgoing_edges = [&](const INDEX k) {
+      const INDEX v = order[k];
+      INDEX slot = slot_offsets[k-level_begin];
+      for(INDEX l=offsets[v]; l<offsets[v+1]; ++l, ++slot) {
+        const INDEX w = targets[l];
+        INDEX remaining;
+#pragma omp atomic capture
+        remaining = --in_degree[w];
+        candidates[slot] = remaining == 0 ? w : std::numeric_limits<INDEX>::max();
       }
-   }
-   assert(order.size() == INDEX(V));
-   assert(LP_MP::HasUniqueValues(order));
-   std::reverse(order.begin(),order.end());
-   return std::move(order);
-   */
-
-   constexpr unsigned char notMarked = 0;
-   constexpr unsigned char tempMarked = 1;
-   constexpr unsigned char permMarked = 2;
-   
-   std::vector<unsigned char> mark(V,notMarked); 
-   std::stack<std::pair<INDEX,decltype(adj[0].begin())> > dfs;
-   std::vector<INDEX> postOrder;
-
-   for(INDEX i=0;i<V;i++){
-      if(mark[i] == notMarked) {
-         dfs.push(std::make_pair(i,adj[i].begin()));
-         while(!dfs.empty()){
-            INDEX node = dfs.top().first;
-            auto& it = dfs.top().second;
-            if(mark[node] == tempMarked) {
-               throw std::runtime_error("graph not a dag");
-            }
-            if(it == adj[node].begin()) { // first visit
-               assert(mark[node] == notMarked);
-               mark[node] = permMarked;
-            }
-            while(it != adj[node].end() && mark[*it] != notMarked) {
-               ++it;
-            }
-            if(it != adj[node].end()) {
-               INDEX next = *it;
-               ++it;
-               dfs.top().second = it;
-               dfs.push(std::make_pair(next,adj[next].begin()));
-            } else {
-               dfs.pop();
-               mark[node] = permMarked;
-               postOrder.push_back(node);
-            }
-         }
+    };
+    if(level_end - level_begin > parallel_level_size) {
+#pragma omp parallel for schedule(guided)
+      for(INDEX k=level_begin; k<level_end; ++k) {
+        remove_outgoing_edges(k);
       }
-   }
+    } else {
+      for(INDEX k=level_begin; k<level_end; ++k) {
+        remove_outgoing_edges(k);
+      }
+    }
+    candidates.erase(std::remove(candidates.begin(), candidates.end(), std::numeric_limits<INDEX>::max()), candidates.end());
+    std::sort(candidates.begin(), candidates.end());
+    order.insert(order.end(), candidates.begin(), candidates.end());
+  }
 
-   assert(postOrder.size() == INDEX(V));
-   assert(LP_MP::HasUniqueValues(postOrder));
-   std::reverse(postOrder.begin(),postOrder.end());
+  if(order.size() != V) {
+    throw std::runtime_error("graph not a dag");
+  }
 
-   assert(sorting_valid(postOrder));
+  assert(LP_MP::HasUniqueValues(order));
+  assert(sorting_valid(order));
 
-   return std::move(postOrder);
+  return order;
 }
 
 } // end namespace Topological_Sort
@@ -4,10 +4,16 @@
 #include "LP_MP.h"
 #include "serialization.hxx"
 #include "union_find.hxx"
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <utility>
 
 namespace LP_MP {
 
 // given factors connected as a tree, solve it.
+// After populate_factors() the tree is compiled into a flat program: messages are stored by value in one contiguous vector per message type and each tree_op refers to its message by (type, index) and to its adjacent factors by slots into factors_.
+// solve() then runs without allocations and without variant dispatch.
 template<typename FMC>
 class factor_tree {
 public:
@@ -16,21 +22,47 @@ public:
    template<typename MESSAGE_CONTAINER_TYPE>
    void add_message( MESSAGE_CONTAINER_TYPE* msg, Chirality c)
    {
-       tree_messages_.push_back( std::make_tuple( msg->free_message(), c) ); 
+       using free_message_type = typename MESSAGE_CONTAINER_TYPE::free_message_container_type;
+       constexpr std::size_t msg_type = meta::find_index<free_message_container_type_list, free_message_type>::value;
+       static_assert(msg_type < no_message_types);
+
+       auto& msgs = std::get<msg_type>(tree_messages_);
+       tree_program_.push_back({ static_cast<unsigned char>(msg_type), c, INDEX(msgs.size()), 0, 0 });
+       msgs.push_back( msg->free_message() ); 
    }
 
+   // tree consisting of a single factor without messages, e.g. an isolated unary factor
+   void add_factor(FactorTypeAdapter* f)
+   {
+       assert(tree_program_.empty());
+       factors_.assign(1, f);
+   }
+
+   // collect factors and resolve factor slots of every tree operation
    void populate_factors()
    {
-       std::set<FactorTypeAdapter*> factor_set;
-       for(auto tree_msg : tree_messages_) {
-           std::visit([&](auto&& m) {
-               factor_set.insert(m.GetLeftFactor());
-               factor_set.insert(m.GetRightFactor()); 
-               }, std::get<0>(tree_msg) );
+       if(tree_program_.empty()) { // single factor tree
+           assert(factors_.size() == 1);
+           root_slot_ = 0;
+           return;
        }
-       factors_.assign( factor_set.begin(), factor_set.end() );
+       factors_.clear();
+       factors_.reserve(2*tree_program_.size());
+       for_each_tree_message([&](auto& m) {
+               factors_.push_back(m.GetLeftFactor());
+               factors_.push_back(m.GetRightFactor()); 
+               });
        std::sort(factors_.begin(), factors_.end());
-       assert(factors_.size() == tree_messages_.size() + 1);
+       factors_.erase( std::unique(factors_.begin(), factors_.end()), factors_.end() );
+       assert(factors_.size() == tree_messages_size() + 1);
+
+       for(auto& op : tree_program_) {
+           visit_tree_message(op, [&](auto& m) {
+                   op.left_slot = factor_slot(m.GetLeftFactor());
+                   op.right_slot = factor_slot(m.GetRightFactor());
+                   });
+       }
+       root_slot_ = upper_slot(tree_program_.back());
 
        assert(tree_valid());
    }
@@ -38,65 +70,25 @@ public:
    // check whether messages are arranged correctly
    bool tree_valid() const
    {
-     // build graph out of tree messages and check whether all edges point towards root
-     std::vector<std::vector<int>> tree(factors_.size());
-     std::unordered_map<FactorTypeAdapter*, int> factor_map;
-     for(INDEX i=0; i<factors_.size(); ++i) {
-       factor_map.insert({ factors_[i], i });
-     }
-     for(auto& tree_msg : tree_messages_) {
-         std::visit([&](auto&& msg) {
-            auto c = std::get<1>(tree_msg);
-            auto* left = msg.GetLeftFactor();
-            const int left_idx = factor_map[left];
-            auto* right = msg.GetRightFactor();
-            const int right_idx = factor_map[right];
-            // point messages here towards leaves
-            if(c == Chirality::left) {
-                tree[left_idx].push_back(right_idx); 
-            } else {
-                assert(c == Chirality::right);
-                tree[right_idx].push_back(left_idx); 
-            } 
-         }, std::get<0>(tree_msg) );
-     }
-     // determine root: it is the single index without incoming edges
+     // edges point towards leaves. Determine root: it is the single index without incoming edges
      std::vector<int> no_incoming_edges(factors_.size(), 0);
-     for(INDEX i=0; i<tree.size(); ++i) {
-       for(int j : tree[i]) {
-         no_incoming_edges[j]++;
-       }
+     UnionFind uf(factors_.size());
+     for(const auto& op : tree_program_) {
+         no_incoming_edges[lower_slot(op)]++;
+         uf.merge(op.left_slot, op.right_slot);
      }
      assert(1 == std::count(no_incoming_edges.begin(), no_incoming_edges.end(), 0));
      // check if tree is connected
-     UnionFind uf(tree.size());
-     for(INDEX i=0; i<tree.size(); ++i) {
-       for(int j : tree[i]) {
-         uf.merge(i,j);
-       }
-     }
      assert(uf.count() == 1);
 
      const int root = std::find(no_incoming_edges.begin(), no_incoming_edges.end(), 0) - no_incoming_edges.begin();
+     assert(root == int(root_slot_));
 
      // check whether messages are in correct order: from bottom to top
-     std::vector<int> visited(tree.size(), false);
-     for(auto& tree_msg : tree_messages_) {
-         std::visit([&](auto&& msg) {
-            auto c = std::get<1>(tree_msg);
-            auto* left = msg.GetLeftFactor();
-            const int left_idx = factor_map[left];
-            auto* right = msg.GetRightFactor();
-            const int right_idx = factor_map[right];
-            // point messages here towards leaves
-            if(c == Chirality::left) {
-                visited[right_idx] = true;
-                assert(visited[left_idx] == false);
-            } else {
-                visited[left_idx] = true;
-                assert(visited[right_idx] == false); 
-            }
-        }, std::get<0>(tree_msg) );
+     std::vector<int> visited(factors_.size(), false);
+     for(const auto& op : tree_program_) {
+         visited[lower_slot(op)] = true;
+         assert(visited[upper_slot(op)] == false);
      }
      assert(visited[root] == false);
 
@@ -106,49 +98,30 @@ public:
    // return cost of tree
    REAL solve()
    {
-      assert(factors_.size() == tree_messages_.size() + 1); // otherwise call init
+      assert(factors_.size() == tree_program_.size() + 1); // otherwise call init
+      static constexpr auto send_message_up_fns = send_message_up_table(std::make_index_sequence<no_message_types>{});
+      static constexpr auto track_solution_down_fns = track_solution_down_table(std::make_index_sequence<no_message_types>{});
+
       // send messages up the tree
-      for(auto it = tree_messages_.begin(); it!= tree_messages_.end(); ++it) {
-         Chirality c = std::get<1>(*it);
-          std::visit([c](auto&& msg) {
-              msg.send_message_up(c);
-          }, std::get<0>(*it) );
+      for(const auto& op : tree_program_) {
+         send_message_up_fns[op.msg_type](*this, op);
       }
       // compute primal for topmost factor
       // also init primal for top factor, all other primals were initialized already by send_message_up
       REAL value = 0.0;
       {
-          const Chirality c = std::get<1>(tree_messages_.back());
-          std::visit([&](auto&& msg) {
-              if(c == Chirality::right) {
-                // init primal for right factor!
-                msg.GetRightFactorTypeAdapter()->init_primal();
-                msg.GetRightFactorTypeAdapter()->MaximizePotentialAndComputePrimal();
-                value = msg.GetRightFactorTypeAdapter()->EvaluatePrimal();
-                assert(std::abs(msg.GetRightFactorTypeAdapter()->EvaluatePrimal() - msg.GetRightFactorTypeAdapter()->LowerBound()) <= eps);
-              } else {
-                assert(c == Chirality::left);
-                msg.GetLeftFactorTypeAdapter()->init_primal(); 
-                msg.GetLeftFactorTypeAdapter()->MaximizePotentialAndComputePrimal(); 
-                value = msg.GetLeftFactorTypeAdapter()->EvaluatePrimal();
-                assert(std::abs(msg.GetLeftFactorTypeAdapter()->EvaluatePrimal() - msg.GetLeftFactorTypeAdapter()->LowerBound()) <= eps);
-              } 
-          }, std::get<0>(tree_messages_.back()) );
+          auto* root = factors_[root_slot_];
+          root->init_primal();
+          root->MaximizePotentialAndComputePrimal();
+          value = root->EvaluatePrimal();
+          assert(std::abs(root->EvaluatePrimal() - root->LowerBound()) <= eps);
       }
       // track down optimal primal solution
-      for(auto it = tree_messages_.rbegin(); it!= tree_messages_.rend(); ++it) {
-         Chirality c = std::get<1>(*it);
-         std::visit([&](auto&& msg) {
-             msg.track_solution_down(c);
-             assert(std::abs(msg.GetLeftFactorTypeAdapter()->EvaluatePrimal() - msg.GetLeftFactorTypeAdapter()->LowerBound()) <= eps);
-             assert(std::abs(msg.GetRightFactorTypeAdapter()->EvaluatePrimal() - msg.GetRightFactorTypeAdapter()->LowerBound()) <= eps);
-             if(c == Chirality::right) {
-                value += msg.GetLeftFactorTypeAdapter()->EvaluatePrimal();
-             } else {
-                assert(c == Chirality::left);
-                value += msg.GetRightFactorTypeAdapter()->EvaluatePrimal();
-             } 
-         }, std::get<0>(*it) );
+      for(auto it = tree_program_.rbegin(); it!= tree_program_.rend(); ++it) {
+         track_solution_down_fns[it->msg_type](*this, *it);
+         assert(std::abs(factors_[it->left_slot]->EvaluatePrimal() - factors_[it->left_slot]->LowerBound()) <= eps);
+         assert(std::abs(factors_[it->right_slot]->EvaluatePrimal() - factors_[it->right_slot]->LowerBound()) <= eps);
+         value += factors_[lower_slot(*it)]->EvaluatePrimal();
       } 
 
       // check if primal cost is equal to lower bound
@@ -203,16 +176,11 @@ public:
 
    bool primal_consistent() const 
    {
-      for(auto it = tree_messages_.begin(); it!= tree_messages_.end(); ++it) {
-         const bool consistent = std::visit([&](auto&& msg) {
-            return msg.CheckPrimalConsistency();
-         }, std::get<0>(*it) );
-
-         if(!consistent) { 
-             return false;
-         }
-      }
-      return true; 
+      bool consistent = true;
+      for_each_tree_message([&](const auto& m) {
+            consistent = consistent && m.CheckPrimalConsistency();
+      });
+      return consistent; 
    }
 
    REAL primal_cost() const
@@ -241,36 +209,145 @@ public:
    {
       std::vector<FACTOR_TYPE*> factors;
       std::set<FACTOR_TYPE*> factor_present;
-      for(auto& t : tree_messages_) {
+      for_each_tree_message([&](const auto& m) {
 
-         auto* left = std::get<0>(t)->GetLeftFactorTypeAdapter();
-         auto* left_cast = dynamic_cast<FACTOR_TYPE*>(left);
+         auto* left_cast = dynamic_cast<FACTOR_TYPE*>(static_cast<FactorTypeAdapter*>(m.GetLeftFactor()));
          if(left_cast && factor_present.find(left_cast) == factor_present.end()) {
             factors.push_back(left_cast);
             factor_present.insert(left_cast);
          }
 
-         auto* right = std::get<0>(t)->GetRightFactorTypeAdapter();
-         auto* right_cast = dynamic_cast<FACTOR_TYPE*>(right);
+         auto* right_cast = dynamic_cast<FACTOR_TYPE*>(static_cast<FactorTypeAdapter*>(m.GetRightFactor()));
          if(right_cast && factor_present.find(right_cast) == factor_present.end()) {
             factors.push_back(right_cast);
             factor_present.insert(right_cast);
          } 
-      }
+      });
       return factors;
    }
 
+   // apply f to every message in the tree, grouped by message type, i.e. not in tree order.
+   template<typename LAMBDA>
+   void for_each_tree_message(LAMBDA&& f)
+   {
+      std::apply([&f](auto&... msgs) { ( for_each_in(msgs, f), ... ); }, tree_messages_);
+   }
+   template<typename LAMBDA>
+   void for_each_tree_message(LAMBDA&& f) const
+   {
+      std::apply([&f](const auto&... msgs) { ( for_each_in(msgs, f), ... ); }, tree_messages_);
+   }
+
+   // apply f to the message of the o-th tree operation
+   template<typename LAMBDA>
+   void visit_tree_op(const INDEX o, LAMBDA&& f)
+   {
+      assert(o < tree_program_.size());
+      visit_tree_message(tree_program_[o], f);
+   }
+
+   std::size_t tree_messages_size() const { return tree_program_.size(); }
+
+   // bytes held by tree messages, tree program and factor list
+   std::size_t memory() const
+   {
+      std::size_t bytes = memory_in_bytes(tree_program_) + memory_in_bytes(factors_);
+      std::apply([&bytes](const auto&... msgs) { ( (bytes += memory_in_bytes(msgs)), ... ); }, tree_messages_);
+      return bytes;
+   }
+
    struct free_message_container {
       template<class MESSAGE_CONTAINER_TYPE>
          using invoke = typename MESSAGE_CONTAINER_TYPE::free_message_container_type;
    };
    using free_message_container_type_list = meta::transform< typename FMC::MessageList, free_message_container >;
-   using free_message_variant = meta::apply<meta::quote<std::variant>, free_message_container_type_list>;
-   std::vector< std::tuple<free_message_variant, Chirality> > tree_messages_;
+   static constexpr std::size_t no_message_types = meta::size<free_message_container_type_list>::value;
+   static_assert(no_message_types <= std::numeric_limits<unsigned char>::max());
+
+   struct vector_of_free_messages {
+      template<class FREE_MESSAGE_CONTAINER_TYPE>
+         using invoke = typename std::vector<FREE_MESSAGE_CONTAINER_TYPE>;
+   };
+   using free_message_vector_list = meta::transform< free_message_container_type_list, vector_of_free_messages >;
+   using free_message_storage_type = meta::apply<meta::quote<std::tuple>, free_message_vector_list>;
+
+   // one operation of the compiled tree program. Operations are ordered from leaves to root
+   struct tree_op {
+      unsigned char msg_type; // index into free_message_container_type_list
+      Chirality c; // which factor is nearer to the root
+      INDEX msg_idx; // index into std::get<msg_type>(tree_messages_)
+      INDEX left_slot; // index into factors_
+      INDEX right_slot; // index into factors_
+   };
+
+   free_message_storage_type tree_messages_;
+   std::vector<tree_op> tree_program_;
 
-   std::vector<FactorTypeAdapter*> factors_;
+   std::vector<FactorTypeAdapter*> factors_; // sorted by address
+   INDEX root_slot_ = 0;
 
 protected:
+   static INDEX upper_slot(const tree_op& op) { return op.c == Chirality::right ? op.right_slot : op.left_slot; }
+   static INDEX lower_slot(const tree_op& op) { return op.c == Chirality::right ? op.left_slot : op.right_slot; }
+
+   INDEX factor_slot(FactorTypeAdapter* f) const
+   {
+      auto it = std::lower_bound(factors_.begin(), factors_.end(), f);
+      assert(it != factors_.end() && *it == f);
+      return std::distance(factors_.begin(), it);
+   }
+
+   template<typename VECTOR, typename LAMBDA>
+   static void for_each_in(VECTOR& msgs, LAMBDA& f)
+   {
+      for(auto& m : msgs) { f(m); }
+   }
+
+   // dispatch to the message referenced by op. Only for setup code, solve() uses the function tables below.
+   template<std::size_t MSG_TYPE = 0, typename LAMBDA>
+   void visit_tree_message(const tree_op& op, LAMBDA&& f)
+   {
+      if constexpr(MSG_TYPE < no_message_types) {
+         if(op.msg_type == MSG_TYPE) {
+            f(std::get<MSG_TYPE>(tree_messages_)[op.msg_idx]);
+         } else {
+            visit_tree_message<MSG_TYPE+1>(op, f);
+         }
+      } else {
+         assert(false);
+      }
+   }
+
+   // message types are known statically, hence call non-virtually
+   template<std::size_t MSG_TYPE>
+   static void send_message_up_op(factor_tree& t, const tree_op& op)
+   {
+      auto& m = std::get<MSG_TYPE>(t.tree_messages_)[op.msg_idx];
+      using message_type = meta::at_c<free_message_container_type_list, MSG_TYPE>;
+      m.message_type::send_message_up(op.c);
+   }
+
+   template<std::size_t MSG_TYPE>
+   static void track_solution_down_op(factor_tree& t, const tree_op& op)
+   {
+      auto& m = std::get<MSG_TYPE>(t.tree_messages_)[op.msg_idx];
+      using message_type = meta::at_c<free_message_container_type_list, MSG_TYPE>;
+      m.message_type::track_solution_down(op.c);
+   }
+
+   using tree_op_fn = void (*)(factor_tree&, const tree_op&);
+
+   template<std::size_t... MSG_TYPES>
+   static constexpr std::array<tree_op_fn, sizeof...(MSG_TYPES)> send_message_up_table(std::index_sequence<MSG_TYPES...>)
+   {
+      return {{ &send_message_up_op<MSG_TYPES>... }};
+   }
+
+   template<std::size_t... MSG_TYPES>
+   static constexpr std::array<tree_op_fn, sizeof...(MSG_TYPES)> track_solution_down_table(std::index_sequence<MSG_TYPES...>)
+   {
+      return {{ &track_solution_down_op<MSG_TYPES>... }};
+   }
 };
 
 // factors can be shared among multiple trees. Equality between shared factors is enforced via Lagrangean multipliers
@@ -295,6 +372,15 @@ public:
     f->serialize_dual(l_ar);
     ar.release_memory(); 
   }
+
+  // write dual of factor into w
+  void read_dual(double* w) const
+  {
+    serialization_archive ar(w, no_Lagrangean_vars_*sizeof(REAL));
+    save_archive s_ar(ar);
+    f->serialize_dual(s_ar);
+    ar.release_memory(); 
+  }
   //void copy_fn(double* w)
   //{
   //  f->subgradient(w, +1.0); 
@@ -337,6 +423,23 @@ public:
     }
   }
 
+  // given deviations of the copies from their mean (contiguously, in the order of init_Lagrangean_variables), write multipliers into the local weights w[i] of the tree of factors[i] such that serialize_Lagrangean adds exactly the deviation to each copy.
+  // The negative copies carry the negated deviation, the positive copy receives the sum of all blocks.
+  static void multipliers_from_deviations(const std::vector<const Lagrangean_factor_star*>& factors, const double* deviations, const std::vector<double*>& w)
+  {
+    assert(factors.size() > 1 && factors.size() == w.size());
+    assert(factors[0]->no_connected == factors.size());
+    const INDEX n = factors[0]->no_Lagrangean_vars();
+    for(INDEX i=1; i<factors.size(); ++i) {
+      assert(factors[i]->no_connected == 0);
+      for(INDEX j=0; j<n; ++j) {
+        const double x = -deviations[i*n + j];
+        w[i][factors[i]->local_Lagrangean_vars_offset_ + j] = x;
+        w[0][factors[0]->local_Lagrangean_vars_offset_ + (i-1)*n + j] = x;
+      }
+    }
+  }
+
   void add_to_mapping(std::vector<int>& mapping)
   {
     local_Lagrangean_vars_offset_ = mapping.size();
@@ -441,6 +544,17 @@ public:
     f->serialize_dual(l_ar);
     ar.release_memory(); 
   }
+
+  // the multipliers of each tree are the deviations of its copy from the mean, hence they sum to zero
+  static void multipliers_from_deviations(const std::vector<const Lagrangean_factor_FWMAP*>& factors, const double* deviations, const std::vector<double*>& w)
+  {
+    assert(factors.size() > 0 && factors.size() == w.size());
+    const INDEX n = factors[0]->no_Lagrangean_vars();
+    for(INDEX i=0; i<factors.size(); ++i) {
+      std::copy(deviations + i*n, deviations + (i+1)*n, w[i] + factors[i]->local_Lagrangean_vars_offset_);
+    }
+  }
+
   void copy_fn(double* wi)
   {
     double* w = wi + local_Lagrangean_vars_offset_;
@@ -707,6 +821,22 @@ public:
    std::vector<int> mapping_;
 
    std::vector<FactorTypeAdapter*> original_factors_;
+
+   // links of tree messages that point to copies of factors, used for restoring the original links
+   struct redirected_link {
+      INDEX op; // index into tree_program_
+      Chirality side;
+      FactorTypeAdapter* original;
+   };
+   std::vector<redirected_link> redirected_links_;
+
+   // bytes held by the tree and its copies of shared factors. Copies are counted by their dual size only, as their container type is not known here.
+   std::size_t memory() const
+   {
+      std::size_t bytes = factor_tree<FMC>::memory() + memory_in_bytes(Lagrangean_factors_) + memory_in_bytes(mapping_) + memory_in_bytes(original_factors_) + memory_in_bytes(redirected_links_);
+      for(const auto& L : Lagrangean_factors_) { bytes += L.no_Lagrangean_vars_*sizeof(REAL); }
+      return bytes;
+   }
 };
 
 // do zrobienia: templatize base class
@@ -724,26 +854,15 @@ public:
      // redirect messages back to original factors
      for(auto& t : trees_) {
        assert(t.original_factors_.size() == t.Lagrangean_factors_.size());
-       std::unordered_map<FactorTypeAdapter*, FactorTypeAdapter*> copy_to_original_factor;
-       for(INDEX i=0; i<t.Lagrangean_factors_.size(); ++i) {
-         copy_to_original_factor.insert({t.Lagrangean_factors_[i].f, t.original_factors_[i]});
-       } 
-
-       for(auto tree_msg : t.tree_messages_) {
-         std::visit([&](auto&& m) {
-             auto* left = m.GetLeftFactor();
-             auto* right = m.GetRightFactor();
-
-            if(copy_to_original_factor.find(left) != copy_to_original_factor.end()) {
-                auto* left_original = copy_to_original_factor.find(left)->second;
-                m.SetLeftFactor(left_original);
-            }
-            if(copy_to_original_factor.find(right) != copy_to_original_factor.end()) {
-                auto* right_original = copy_to_original_factor.find(right)->second;
-                m.SetRightFactor(right_original);
-            }
-         }, std::get<0>(tree_msg) );
-       } 
+       for(const auto& link : t.redirected_links_) {
+         t.visit_tree_op(link.op, [&](auto& m) {
+             if(link.side == Chirality::left) {
+               m.SetLeftFactor(link.original);
+             } else {
+               m.SetRightFactor(link.original);
+             }
+         });
+       }
      }
 
      // delete copies of factors
@@ -754,6 +873,15 @@ public:
      }
    }
 
+   memory_report get_memory_report()
+   {
+      memory_report r = LP<FMC>::get_memory_report();
+      std::size_t bytes = memory_in_bytes(trees_) + memory_in_bytes(Lagrangean_group_offsets_) + memory_in_bytes(Lagrangean_groups_);
+      for(const auto& t : trees_) { bytes += t.memory(); }
+      r.add("tree decomposition", "trees", trees_.size(), bytes);
+      return r;
+   }
+
    void add_tree(factor_tree<FMC>& t)
    { 
      LP_tree_Lagrangean<FMC,LAGRANGEAN_FACTOR> lt(t);
@@ -761,93 +889,99 @@ public:
    }
 
    // find out, which factors are shared between trees and add Lagrangean multipliers for them.
+   // Tree membership of factors is held in CSR arrays indexed by factor number, hence construction is linear in the size of the trees.
    void construct_decomposition()
    {
        if(constructed_decomposition == true) { return; }
        constructed_decomposition = true;
        for(auto& t : trees_) { t.populate_factors(); }
 
-      // first, go over all Lagrangean factors in each tree and count how often factor is shared
-      struct Lagrangean_counting {
-         std::vector<std::size_t> trees;
-         std::vector<LAGRANGEAN_FACTOR> factors;
-         std::size_t offset = 0; // offset into dual weights
-      };
-      std::unordered_map<FactorTypeAdapter*, Lagrangean_counting > Lagrangean_factors;
+      // first, go over all factors in each tree and count how often factor is shared
+      const std::size_t no_factors = this->f_.size();
+      std::vector<std::size_t> tree_offsets(no_factors+1, 0); // factor i occurs in trees tree_indices[tree_offsets[i]], ..., tree_indices[tree_offsets[i+1]-1]
+      for(auto& t : trees_) {
+         for(auto* f : t.factors_) {
+            tree_offsets[this->factor_index(f)+1]++;
+         }
+      }
+      std::partial_sum(tree_offsets.begin(), tree_offsets.end(), tree_offsets.begin());
+      assert(std::adjacent_find(tree_offsets.begin(), tree_offsets.end()) == tree_offsets.end()); // otherwise not all factors are covered by trees
 
-      for(std::size_t i=0; i<trees_.size(); ++i) {
-         for(auto* f : trees_[i].factors_) {
-            auto it = Lagrangean_factors.find(f);
-            if(it == Lagrangean_factors.end()) {
-               it = Lagrangean_factors.insert({f,Lagrangean_counting()}).first;
+      std::vector<INDEX> tree_indices(tree_offsets.back());
+      {
+         std::vector<std::size_t> fill_pos(tree_offsets.begin(), tree_offsets.end()-1);
+         for(std::size_t i=0; i<trees_.size(); ++i) {
+            for(auto* f : trees_[i].factors_) {
+               tree_indices[ fill_pos[this->factor_index(f)]++ ] = i;
             }
-            it->second.trees.push_back(i);
          }
       }
-      assert(Lagrangean_factors.size() == this->f_.size()); // otherwise not all factors are covered by trees
+      // trees are traversed in ascending order, hence tree indices of each factor are sorted
 
       // copy Lagrangean factors and insert into trees.
       Lagrangean_vars_size_ = 0;
-      std::vector<std::unordered_map<FactorTypeAdapter*, FactorTypeAdapter*>> factor_mapping(trees_.size()); // original to copied factor in each tree
-      for(auto& it : Lagrangean_factors) {
-        auto* f = it.first;
-        auto L = it.second;
-        auto& tree_indices = L.trees;
-        const auto no_occurences = tree_indices.size();
+      Lagrangean_group_offsets_.assign(1, 0);
+      Lagrangean_groups_.clear();
+      std::vector<FactorTypeAdapter*> factor_copies(tree_indices.size(), nullptr); // copy of factor for each entry of tree_indices
+      std::vector<LAGRANGEAN_FACTOR> L_factors;
+      for(std::size_t idx=0; idx<no_factors; ++idx) {
+        auto* f = this->f_[idx];
+        const auto no_occurences = tree_offsets[idx+1] - tree_offsets[idx];
         if(no_occurences > 1) { // FIXME: we should also clone factors occuring only once
           f->divide(no_occurences);
-          //L.factors.push_back(LAGRANGEAN_FACTOR(f));
 
-          for(const auto i : tree_indices) {
+          L_factors.clear();
+          for(std::size_t k=tree_offsets[idx]; k<tree_offsets[idx+1]; ++k) {
             auto* f_copy = f->clone(); // do zrobienia: possibly not all pointers to messages have to be cloned as well
-            //std::cout << "copy factor " << f << " to " << f_copy << "\n"; 
-            L.factors.push_back(LAGRANGEAN_FACTOR(f_copy));
-            factor_mapping[i].insert(std::make_pair(f, f_copy)); 
+            L_factors.push_back(LAGRANGEAN_FACTOR(f_copy));
+            factor_copies[k] = f_copy;
           }
 
-          const auto no_Lagrangean_vars = LAGRANGEAN_FACTOR::joint_no_Lagrangean_vars( L.factors );
-          LAGRANGEAN_FACTOR::init_Lagrangean_variables( L.factors, Lagrangean_vars_size_ );
+          const auto no_Lagrangean_vars = LAGRANGEAN_FACTOR::joint_no_Lagrangean_vars( L_factors );
+          LAGRANGEAN_FACTOR::init_Lagrangean_variables( L_factors, Lagrangean_vars_size_ );
 
-          assert(tree_indices.size() == L.factors.size());
-          for(std::size_t i=0; i<L.factors.size(); ++i) {
-            const auto tree_index = tree_indices[i];
-            trees_[tree_index].Lagrangean_factors_.push_back(L.factors[i]);
+          for(std::size_t k=0; k<L_factors.size(); ++k) {
+            const auto tree_index = tree_indices[tree_offsets[idx] + k];
+            Lagrangean_groups_.push_back({tree_index, INDEX(trees_[tree_index].Lagrangean_factors_.size())});
+            trees_[tree_index].Lagrangean_factors_.push_back(L_factors[k]);
             trees_[tree_index].original_factors_.push_back(f);
           }
+          Lagrangean_group_offsets_.push_back(Lagrangean_groups_.size());
           
-          //std::cout << "remove me: " << no_Lagrangean_vars << "; " << Lagrangean_vars_size_ << "\n";
           Lagrangean_vars_size_ += no_Lagrangean_vars;
         }
       }
 
-      // Redirect links to factors in relevant messages
+      // copy of factor f in tree i
+      auto factor_copy = [&](FactorTypeAdapter* f, const INDEX i) -> FactorTypeAdapter* {
+         const auto idx = this->factor_index(f);
+         auto it = std::lower_bound(tree_indices.begin() + tree_offsets[idx], tree_indices.begin() + tree_offsets[idx+1], i);
+         assert(it != tree_indices.begin() + tree_offsets[idx+1] && *it == i);
+         return factor_copies[ std::distance(tree_indices.begin(), it) ];
+      };
+
+      // Redirect links to factors in relevant messages and remember them for restoring in destructor
       for(std::size_t i=0; i<trees_.size(); ++i) {
          auto& t = trees_[i];
-         
-         // redirect links from messages in trees that are directed to current factor
-         for(auto& tree_msg : trees_[i].tree_messages_) {
-             std::visit([&](auto&& m) {
-                 auto* left = m.GetLeftFactor();
-                 auto* right = m.GetRightFactor();
-                 if(factor_mapping[i].find(left) != factor_mapping[i].end()) {
-                    auto* left_copy = factor_mapping[i].find(left)->second;
-                    //std::cout << "reset link to " << left_copy << "\n";
-                    m.SetLeftFactor(left_copy);
-                 }
-                 if(factor_mapping[i].find(right) != factor_mapping[i].end()) {
-                     assert(false); // only currently, remove
-                    auto* right_copy = factor_mapping[i].find(right)->second;
-                    m.SetRightFactor(right_copy);
-                 }
-                 }, std::get<0>(tree_msg));
+         t.redirected_links_.clear();
+         if(t.tree_program_.empty()) {
+            if(auto* f_copy = factor_copy(t.factors_[0], i)) {
+               t.factors_[0] = f_copy;
+            }
          }
-         // search for factor in tree and change it as well
-         for(auto f : t.factors_) {
-            if(factor_mapping[i].find(f) != factor_mapping[i].end()) {
-               auto* f_copy = factor_mapping[i].find(f)->second;
-                //std::cout << "reset factor " << f << " in factor list to " << f_copy << "\n";
-               f = f_copy;
-            } 
+         for(INDEX o=0; o<t.tree_program_.size(); ++o) {
+            t.visit_tree_op(o, [&](auto& m) {
+                  auto* left = m.GetLeftFactor();
+                  auto* right = m.GetRightFactor();
+                  if(auto* left_copy = factor_copy(left, i)) {
+                     m.SetLeftFactor(left_copy);
+                     t.redirected_links_.push_back({o, Chirality::left, left});
+                  }
+                  if(auto* right_copy = factor_copy(right, i)) {
+                     m.SetRightFactor(right_copy);
+                     t.redirected_links_.push_back({o, Chirality::right, right});
+                  }
+            });
          }
       }
 
@@ -962,6 +1096,56 @@ public:
       }
    }
 
+  // Exact conversion of the reparametrization of the tree decomposition into Lagrangean multipliers:
+  // the deviations of the copies of each shared factor from their mean are returned as local multipliers of each tree (indexed like mapping()). The LP is not changed.
+  // multipliers_to_reparametrization(w, -1.0) sets all copies to their mean, multipliers_to_reparametrization(w) adds the deviations back. The lower bound of the decomposition with all copies at their mean is at least the message passing lower bound of the original factors.
+  std::vector<std::vector<double>> reparametrization_to_multipliers() const
+  {
+     assert(constructed_decomposition);
+     std::vector<std::vector<double>> w(trees_.size());
+     for(INDEX i=0; i<trees_.size(); ++i) {
+        w[i].resize(trees_[i].mapping().size(), 0.0);
+     }
+
+     std::vector<double> deviations;
+     std::vector<double> mean;
+     std::vector<const LAGRANGEAN_FACTOR*> group;
+     std::vector<double*> group_w;
+     for(std::size_t g=0; g+1<Lagrangean_group_offsets_.size(); ++g) {
+        group.clear();
+        group_w.clear();
+        for(std::size_t k=Lagrangean_group_offsets_[g]; k<Lagrangean_group_offsets_[g+1]; ++k) {
+           const auto [tree_index, L_index] = Lagrangean_groups_[k];
+           group.push_back(&trees_[tree_index].Lagrangean_factors_[L_index]);
+           group_w.push_back(w[tree_index].data());
+        }
+
+        const INDEX n = group[0]->no_Lagrangean_vars();
+        deviations.resize(n*group.size());
+        mean.assign(n, 0.0);
+        for(INDEX i=0; i<group.size(); ++i) {
+           group[i]->read_dual(&deviations[i*n]);
+           for(INDEX j=0; j<n; ++j) { mean[j] += deviations[i*n+j]; }
+        }
+        for(INDEX j=0; j<n; ++j) { mean[j] /= REAL(group.size()); }
+        for(INDEX i=0; i<group.size(); ++i) {
+           for(INDEX j=0; j<n; ++j) { deviations[i*n+j] -= mean[j]; }
+        }
+
+        LAGRANGEAN_FACTOR::multipliers_from_deviations(group, deviations.data(), group_w);
+     }
+     return w;
+  }
+
+  void multipliers_to_reparametrization(const std::vector<std::vector<double>>& w, const REAL scaling = 1.0)
+  {
+     assert(w.size() == trees_.size());
+     for(INDEX i=0; i<trees_.size(); ++i) {
+        assert(w[i].size() == trees_[i].mapping().size());
+        trees_[i].add_weights(w[i].data(), scaling);
+     }
+  }
+
   // write back reparametrization of tree decomposition factor into original factors
   void write_back_reparametrization()
   {
@@ -984,42 +1168,197 @@ public:
 protected:
    std::vector<LP_tree_Lagrangean<FMC,LAGRANGEAN_FACTOR>> trees_; // store for each tree the associated Lagrangean factors.
    INDEX Lagrangean_vars_size_;
+   // copies of shared factors in CSR format: group g consists of Lagrangean_groups_[Lagrangean_group_offsets_[g]], ..., Lagrangean_groups_[Lagrangean_group_offsets_[g+1]-1], each entry given by (tree index, index into Lagrangean_factors_ of tree)
+   std::vector<std::size_t> Lagrangean_group_offsets_;
+   std::vector<std::array<INDEX,2>> Lagrangean_groups_;
    TCLAP::ValueArg<INDEX> tree_decomposition_begin_arg_; 
    bool constructed_decomposition = false;
 };
 
-// perform subgradient ascent with Polyak's step size with estimated optimum
+// dual ascent on the Lagrangean multipliers of the tree decomposition. Update rules:
+//   subgradient: diminishing step size
+//   polyak: Polyak's step size (target - lower bound)/|g|^2, the target is the best lower bound plus a gap estimate which is halved when no progress is made
+//   nesterov: Polyak steps from an extrapolated point (Nesterov momentum), momentum is restarted when the lower bound decreases
+//   adagrad, adam: per-coordinate adaptive step sizes
+// Updates are applied to the tree factors through add_weights, hence the current reparametrization always corresponds to the point at which trees are evaluated.
 template<typename FMC>
 class LP_subgradient_ascent : public LP_with_trees<FMC, Lagrangean_factor_star, LP_subgradient_ascent<FMC>> // better: perform projected subgradient ascent with Lagrangean_factor_zero_sum
 {
 public:
-   using LP_with_trees<FMC, Lagrangean_factor_star, LP_subgradient_ascent<FMC>>::LP_with_trees;
+   using base_type = LP_with_trees<FMC, Lagrangean_factor_star, LP_subgradient_ascent<FMC>>;
+   enum class dual_ascent_method {subgradient, polyak, nesterov, adagrad, adam};
+
+   LP_subgradient_ascent(TCLAP::CmdLine& cmd)
+     : base_type(cmd),
+     dual_ascent_method_arg_("","dualAscentMethod","update rule for Lagrangean multipliers, default = subgradient",false,"subgradient","{subgradient|polyak|nesterov|adagrad|adam}",cmd),
+     dual_step_size_arg_("","dualStepSize","step size for adagrad and adam, initial gap estimate relative to lower bound for polyak and nesterov, default = 0.1",false,0.1,"positive real",cmd)
+   {}
 
-   void construct_decomposition() {}
+   void construct_decomposition() 
+   {
+      const auto& m = dual_ascent_method_arg_.getValue();
+      if(m == "subgradient") {
+         method_ = dual_ascent_method::subgradient;
+      } else if(m == "polyak") {
+         method_ = dual_ascent_method::polyak;
+      } else if(m == "nesterov") {
+         method_ = dual_ascent_method::nesterov;
+      } else if(m == "adagrad") {
+         method_ = dual_ascent_method::adagrad;
+      } else if(m == "adam") {
+         method_ = dual_ascent_method::adam;
+      } else {
+         throw std::runtime_error("dual ascent method " + m + " unknown");
+      }
+      if(dual_step_size_arg_.getValue() <= 0.0) {
+         throw std::runtime_error("dual step size must be positive");
+      }
+
+      const auto n = this->no_Lagrangean_vars();
+      subgradient_.resize(n);
+      update_.resize(n);
+      if(method_ == dual_ascent_method::nesterov) {
+         multipliers_.resize(n, 0.0);
+         extrapolated_multipliers_.resize(n, 0.0);
+      }
+      if(method_ == dual_ascent_method::adagrad || method_ == dual_ascent_method::adam) {
+         second_moment_.resize(n, 0.0);
+      }
+      if(method_ == dual_ascent_method::adam) {
+         first_moment_.resize(n, 0.0);
+      }
+   }
 
    void optimize_decomposition(const INDEX iteration)
    {
       REAL current_lower_bound = 0.0;
-      std::vector<REAL> subgradient(this->no_Lagrangean_vars(), 0.0);
+      std::fill(subgradient_.begin(), subgradient_.end(), 0.0);
       for(std::size_t i=0; i<this->trees_.size(); ++i) {
          current_lower_bound += this->trees_[i].solve();
-         this->trees_[i].compute_mapped_subgradient(subgradient); // note that mapping has one extra component!
-         //trees_[i].primal_cost();
+         this->trees_[i].compute_mapped_subgradient(subgradient_); // note that mapping has one extra component!
       }
+      assert(std::find_if(subgradient_.begin(), subgradient_.end(), [](auto x) { return x != 0.0 && x != 1.0 && x != -1.0; }) == subgradient_.end());
 
-      best_lower_bound = std::max(current_lower_bound, best_lower_bound);
-      assert(std::find_if(subgradient.begin(), subgradient.end(), [](auto x) { return x != 0.0 && x != 1.0 && x != -1.0; }) == subgradient.end());
-      const REAL subgradient_one_norm = std::accumulate(subgradient.begin(), subgradient.end(), 0.0, [=](REAL s, REAL x) { return s + std::abs(x); });
+      if(current_lower_bound > best_lower_bound_) {
+         best_lower_bound_ = current_lower_bound;
+         no_improvement_iter_ = 0;
+      } else {
+         ++no_improvement_iter_;
+      }
+      ++iter_;
 
-      const REAL step_size = (best_lower_bound - current_lower_bound + subgradient.size())/REAL(subgradient.size() + iteration) / (eps + subgradient_one_norm);
+      const REAL subgradient_one_norm = std::accumulate(subgradient_.begin(), subgradient_.end(), 0.0, [](REAL s, REAL x) { return s + std::abs(x); });
+      if(subgradient_one_norm == 0.0) { // all trees agree on shared factors, hence decomposition is optimal
+         return;
+      }
 
-      std::cout << "stepsize = " << step_size << ", absolute value of subgradient = " << subgradient_one_norm << "\n";
-      this->add_weights(&subgradient[0], step_size);
+      switch(method_) {
+         case dual_ascent_method::subgradient: subgradient_step(current_lower_bound, subgradient_one_norm); break;
+         case dual_ascent_method::polyak: polyak_step(current_lower_bound); break;
+         case dual_ascent_method::nesterov: nesterov_step(current_lower_bound); break;
+         case dual_ascent_method::adagrad: adagrad_step(); break;
+         case dual_ascent_method::adam: adam_step(); break;
+      }
+      prev_lower_bound_ = current_lower_bound;
+
+      this->add_weights(&update_[0], 1.0);
    }
 
+   REAL best_lower_bound() const { return best_lower_bound_; }
+
 private:
-   REAL best_lower_bound;
-   REAL step_size;
+   void subgradient_step(const REAL current_lower_bound, const REAL subgradient_one_norm)
+   {
+      const REAL n = subgradient_.size();
+      const REAL step_size = (best_lower_bound_ - current_lower_bound + n)/REAL(n + iter_) / (eps + subgradient_one_norm);
+      if(debug()) { std::cout << "stepsize = " << step_size << ", absolute value of subgradient = " << subgradient_one_norm << "\n"; }
+      for(std::size_t i=0; i<subgradient_.size(); ++i) {
+         update_[i] = step_size * subgradient_[i];
+      }
+   }
+
+   // step size towards estimated optimum best_lower_bound_ + gap_estimate_
+   REAL polyak_step_size(const REAL current_lower_bound)
+   {
+      if(gap_estimate_ <= 0.0) {
+         gap_estimate_ = dual_step_size_arg_.getValue() * std::max(REAL(1.0), std::abs(current_lower_bound));
+      }
+      if(no_improvement_iter_ >= polyak_patience) {
+         gap_estimate_ *= 0.5;
+         no_improvement_iter_ = 0;
+      }
+      const REAL subgradient_two_norm_sqr = std::inner_product(subgradient_.begin(), subgradient_.end(), subgradient_.begin(), 0.0);
+      const REAL step_size = (best_lower_bound_ + gap_estimate_ - current_lower_bound) / subgradient_two_norm_sqr;
+      if(debug()) { std::cout << "stepsize = " << step_size << ", gap estimate = " << gap_estimate_ << "\n"; }
+      return step_size;
+   }
+
+   void polyak_step(const REAL current_lower_bound)
+   {
+      const REAL step_size = polyak_step_size(current_lower_bound);
+      for(std::size_t i=0; i<subgradient_.size(); ++i) {
+         update_[i] = step_size * subgradient_[i];
+      }
+   }
+
+   // trees are evaluated at the extrapolated multipliers y. x_{k+1} = y_k + s*g, y_{k+1} = x_{k+1} + (k-1)/(k+2)*(x_{k+1} - x_k)
+   void nesterov_step(const REAL current_lower_bound)
+   {
+      if(current_lower_bound < prev_lower_bound_) { // adaptive restart
+         momentum_iter_ = 1;
+      }
+      const REAL step_size = polyak_step_size(current_lower_bound);
+      const REAL beta = REAL(momentum_iter_ - 1)/REAL(momentum_iter_ + 2);
+      for(std::size_t i=0; i<subgradient_.size(); ++i) {
+         const REAL x_next = extrapolated_multipliers_[i] + step_size * subgradient_[i];
+         const REAL y_next = x_next + beta*(x_next - multipliers_[i]);
+         update_[i] = y_next - extrapolated_multipliers_[i];
+         multipliers_[i] = x_next;
+         extrapolated_multipliers_[i] = y_next;
+      }
+      ++momentum_iter_;
+   }
+
+   void adagrad_step()
+   {
+      const REAL step_size = dual_step_size_arg_.getValue();
+      for(std::size_t i=0; i<subgradient_.size(); ++i) {
+         second_moment_[i] += subgradient_[i]*subgradient_[i];
+         update_[i] = step_size * subgradient_[i] / (std::sqrt(second_moment_[i]) + eps);
+      }
+   }
+
+   void adam_step()
+   {
+      constexpr REAL beta_1 = 0.9;
+      constexpr REAL beta_2 = 0.999;
+      const REAL step_size = dual_step_size_arg_.getValue();
+      const REAL bias_correction_1 = 1.0 - std::pow(beta_1, iter_);
+      const REAL bias_correction_2 = 1.0 - std::pow(beta_2, iter_);
+      for(std::size_t i=0; i<subgradient_.size(); ++i) {
+         first_moment_[i] = beta_1*first_moment_[i] + (1.0-beta_1)*subgradient_[i];
+         second_moment_[i] = beta_2*second_moment_[i] + (1.0-beta_2)*subgradient_[i]*subgradient_[i];
+         update_[i] = step_size * (first_moment_[i]/bias_correction_1) / (std::sqrt(second_moment_[i]/bias_correction_2) + eps);
+      }
+   }
+
+   static constexpr INDEX polyak_patience = 10; // after how many iterations without improvement the gap estimate is halved
+
+   TCLAP::ValueArg<std::string> dual_ascent_method_arg_;
+   TCLAP::ValueArg<REAL> dual_step_size_arg_;
+   dual_ascent_method method_ = dual_ascent_method::subgradient;
+
+   std::vector<REAL> subgradient_;
+   std::vector<REAL> update_; // added to multipliers in current iteration
+   std::vector<REAL> multipliers_, extrapolated_multipliers_; // nesterov
+   std::vector<REAL> first_moment_, second_moment_; // adagrad, adam
+
+   REAL best_lower_bound_ = -std::numeric_limits<REAL>::infinity();
+   REAL prev_lower_bound_ = -std::numeric_limits<REAL>::infinity();
+   REAL gap_estimate_ = 0.0;
+   INDEX no_improvement_iter_ = 0;
+   INDEX iter_ = 0;
+   INDEX momentum_iter_ = 1;
 };
 
 } // end namespace LP_MP
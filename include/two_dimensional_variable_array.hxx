@@ -141,6 +141,8 @@ public:
    }
 
    INDEX size() const { return dim1_; }
+   // bytes allocated for pointers and data
+   std::size_t memory() const { return p_ == nullptr ? 0 : (dim1_+1)*sizeof(T*) + (p_[dim1_] - p_[0])*sizeof(T); }
 
    struct iterator : public std::iterator< std::random_access_iterator_tag, T* > {
      iterator(T** x) : x_(x) {}
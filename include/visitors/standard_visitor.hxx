@@ -4,6 +4,7 @@
 #include "LP_MP.h"
 #include "config.hxx"
 #include "mem_use.c"
+#include "profiling.hxx"
 #include "tclap/CmdLine.h"
 #include <chrono>
 
@@ -202,6 +203,21 @@ namespace LP_MP {
       TimeType GetBeginTime() const { return beginTime_; }
       //`REAL GetLowerBound() const { return curLowerBound_; }
       INDEX GetIter() const { return curIter_; }
+      // counts and cycles of factor and message operations summed over all threads, empty unless compiled with LP_MP_PROFILING
+      std::vector<profiling::record> GetProfile() const { return profiling::collect(); }
+
+      // called after the problem is constructed and after each tightening round. When the accounted memory exceeds three quarters of --maxMemory, weights of unused reparametrization modes are freed.
+      template<typename LP_TYPE>
+      void check_memory(LP_TYPE& lp, const memory_report& r)
+      {
+         if(verbosity >= 2) { r.print(std::cout); }
+         if(maxMemory_ < std::numeric_limits<INDEX>::max()) {
+            const std::size_t memory_budget = std::size_t(maxMemory_)*1024*1024;
+            const bool compact = r.total() > memory_budget/4*3;
+            if(compact && !lp.compact_memory() && verbosity >= 1) { std::cout << "Memory use near limit of " << maxMemory_ << " MB, switching to compact memory mode\n"; }
+            lp.set_compact_memory(compact);
+         }
+      }
 
       protected:
       PositiveRealConstraint posRealConstraint_;
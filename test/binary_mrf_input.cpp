@@ -0,0 +1,131 @@
+#include "problem_constructors/binary_mrf_input.hxx"
+#include "uai_test_input.hxx"
+#include "test.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <map>
+
+using namespace LP_MP;
+
+int main()
+{
+   // converted model holds the same costs as the uai model, pairwise factors sorted by first variable
+   {
+      const std::string uai_input = "MARKOV 4 2 3 2 1 4 1 0 2 1 2 2 0 3 2 1 0 2 0.5 -1.5 6 0.1 0.2 0.3 0.4 0.5 0.6 2 1 2 6 -1 -2 -3 -4 -5 inf";
+      const auto input = UaiMrfMmapInput::parse(uai_input.data(), uai_input.data() + uai_input.size());
+      BinaryMrfInput::write("binary_mrf_test.bmrf", input);
+      const BinaryMrfInput::binary_mrf b("binary_mrf_test.bmrf");
+
+      test(b.no_variables() == 4 && b.no_pairwise() == 3);
+      test(b.cardinality(0) == 2 && b.cardinality(1) == 3 && b.cardinality(2) == 2 && b.cardinality(3) == 1);
+      test(std::vector<REAL>(b.unary_begin(0), b.unary_end(0)) == std::vector<REAL>({0.5, -1.5}));
+      test(std::vector<REAL>(b.unary_begin(1), b.unary_end(1)) == std::vector<REAL>({0.0, 0.0, 0.0}));
+
+      // (0,1) given transposed, (0,3) and (1,2) in order
+      test(b.pairwise_begin(0) == 0 && b.pairwise_end(0) == 2 && b.pairwise_begin(1) == 2 && b.pairwise_end(1) == 3);
+      test(b.pairwise_second_variable(0) == 1 && b.pairwise_second_variable(1) == 3 && b.pairwise_second_variable(2) == 2);
+      const auto c01 = b.pairwise_cost(0,0);
+      test(c01.dim1() == 2 && c01.dim2() == 3);
+      test(c01(0,0) == -1 && c01(1,0) == -2 && c01(0,1) == -3 && c01(1,1) == -4 && c01(0,2) == -5 && c01(1,2) == std::numeric_limits<REAL>::infinity());
+      const auto c03 = b.pairwise_cost(0,1);
+      test(c03.dim1() == 2 && c03.dim2() == 1 && c03(0,0) == 1 && c03(1,0) == 2);
+      const auto c12 = b.pairwise_cost(1,2);
+      test(c12(0,0) == 0.1 && c12(0,1) == 0.2 && c12(2,1) == 0.6);
+
+      // every cost table is aligned
+      for(std::size_t i=0; i<b.no_variables(); ++i) {
+         test(reinterpret_cast<std::uintptr_t>(b.unary_begin(i)) % BinaryMrfInput::binary_mrf_alignment == 0);
+         for(std::size_t k=b.pairwise_begin(i); k<b.pairwise_end(i); ++k) {
+            test(reinterpret_cast<std::uintptr_t>(b.pairwise_cost(i,k).begin()) % BinaryMrfInput::binary_mrf_alignment == 0);
+         }
+      }
+   }
+
+   // truncated files are rejected
+   {
+      std::ifstream in("binary_mrf_test.bmrf", std::ios::binary);
+      std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      std::ofstream("binary_mrf_truncated.bmrf", std::ios::binary).write(content.data(), content.size() - 8);
+      bool thrown = false;
+      try {
+         BinaryMrfInput::binary_mrf b("binary_mrf_truncated.bmrf");
+      } catch(std::runtime_error&) {
+         thrown = true;
+      }
+      test(thrown);
+   }
+
+   // corrupt files are rejected
+   {
+      std::ifstream in("binary_mrf_test.bmrf", std::ios::binary);
+      const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      BinaryMrfInput::header h;
+      std::memcpy(&h, content.data(), sizeof(h));
+
+      auto rejected = [&](const std::uint64_t offset, const auto value) {
+         std::string corrupt = content;
+         std::memcpy(&corrupt[offset], &value, sizeof(value));
+         std::ofstream("binary_mrf_corrupt.bmrf", std::ios::binary).write(corrupt.data(), corrupt.size());
+         try {
+            BinaryMrfInput::binary_mrf b("binary_mrf_corrupt.bmrf");
+         } catch(std::runtime_error&) {
+            return true;
+         }
+         return false;
+      };
+
+      test(!rejected(h.column_offset, std::uint32_t(1))); // unchanged file is accepted
+      test(rejected(h.cardinality_offset, std::uint32_t(0)));
+      test(rejected(h.column_offset, std::uint32_t(4))); // second variable out of range
+      test(rejected(h.column_offset, std::uint32_t(0))); // second variable not larger than first
+      test(rejected(h.row_begin_offset + sizeof(std::uint64_t), std::uint64_t(4))); // row begin beyond pairwise factors
+      test(rejected(h.row_begin_offset + 2*sizeof(std::uint64_t), std::uint64_t(1))); // row begins decrease
+      test(rejected(h.unary_offsets_offset, std::uint64_t(1) << 62));
+      test(rejected(h.pairwise_offsets_offset, std::uint64_t(-1)));
+      test(rejected(offsetof(BinaryMrfInput::header, cost_offset), std::uint64_t(-1) - BinaryMrfInput::binary_mrf_alignment + 1));
+   }
+
+   // random grid: conversion round trip and loading time
+   {
+      const std::size_t dim = 100;
+      const std::size_t no_labels = 5;
+      write_uai_grid("binary_mrf_test.uai", dim, no_labels, 1);
+      BinaryMrfInput::convert_uai("binary_mrf_test.uai", "binary_mrf_grid.bmrf");
+      const auto input = UaiMrfMmapInput::parse_file("binary_mrf_test.uai");
+
+      const auto begin_time = std::chrono::steady_clock::now();
+      const BinaryMrfInput::binary_mrf b("binary_mrf_grid.bmrf");
+      REAL checksum = 0.0;
+      for(std::size_t i=0; i<b.no_variables(); ++i) {
+         for(std::size_t k=b.pairwise_begin(i); k<b.pairwise_end(i); ++k) {
+            const auto cost = b.pairwise_cost(i,k);
+            checksum += std::accumulate(cost.begin(), cost.end(), REAL(0.0));
+         }
+      }
+      std::cout << "binary mrf load and traversal: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count() << " seconds, checksum " << checksum << "\n";
+
+      test(b.no_variables() == input.number_of_variables_ && b.no_pairwise() == input.pairwise_costs_.size());
+      for(std::size_t i=0; i<b.no_variables(); ++i) {
+         test(std::equal(b.unary_begin(i), b.unary_end(i), input.unary_costs_.begin() + input.unary_offsets_[i]));
+      }
+      std::map<std::array<INDEX,2>, std::size_t> pairwise_index;
+      for(std::size_t p=0; p<input.pairwise_variables_.size(); ++p) {
+         pairwise_index.insert({input.pairwise_variables_[p], p});
+      }
+      std::size_t k_total = 0;
+      for(std::size_t i=0; i<b.no_variables(); ++i) {
+         for(std::size_t k=b.pairwise_begin(i); k<b.pairwise_end(i); ++k, ++k_total) {
+            const auto it = pairwise_index.find({INDEX(i), b.pairwise_second_variable(k)});
+            test(it != pairwise_index.end());
+            const auto cost = b.pairwise_cost(i,k);
+            for(INDEX x1=0; x1<no_labels; ++x1) {
+               for(INDEX x2=0; x2<no_labels; ++x2) {
+                  test(cost(x1,x2) == input.pairwise_costs_[it->second](x1,x2));
+               }
+            }
+         }
+      }
+      test(k_total == b.no_pairwise());
+   }
+}
@@ -0,0 +1,121 @@
+#include "config.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "shared_pairwise_fmc.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+using unary = typename shared_pairwise_FMC::unary;
+using pairwise = typename shared_pairwise_FMC::pairwise;
+using left_message = typename shared_pairwise_FMC::left_message;
+using right_message = typename shared_pairwise_FMC::right_message;
+
+// grid model built factor by factor and with the bulk interface: factors constructed in parallel, messages connected in parallel per unary and registered in one batch.
+int main()
+{
+  const INDEX dim = 30;
+  const INDEX no_labels = 4;
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+  std::vector<std::vector<REAL>> unary_costs(dim*dim, std::vector<REAL>(no_labels));
+  for(auto& c : unary_costs) {
+    for(auto& x : c) { x = dist(gen); }
+  }
+  std::vector<std::array<INDEX,2>> edges;
+  for(INDEX i=0; i<dim; ++i) {
+    for(INDEX j=0; j<dim; ++j) {
+      if(j+1 < dim) { edges.push_back({i*dim+j, i*dim+j+1}); }
+      if(i+1 < dim) { edges.push_back({i*dim+j, (i+1)*dim+j}); }
+    }
+  }
+  pairwise_potential_pool pool;
+  auto potential = pool.truncated_linear(no_labels, 2.0);
+  const REAL scale = 0.4;
+
+  Solver<LP<shared_pairwise_FMC>, StandardVisitor> s1({"", "--maxIter", "20"});
+  {
+    auto& lp = s1.GetLP();
+    std::vector<unary*> unaries;
+    for(const auto& c : unary_costs) {
+      unaries.push_back(lp.template add_factor<unary>(c));
+    }
+    for(INDEX i=1; i<unaries.size(); ++i) {
+      lp.AddFactorRelation(unaries[i-1], unaries[i]);
+    }
+    for(const auto& e : edges) {
+      auto* p = lp.template add_factor<pairwise>(potential, scale);
+      lp.template add_message<left_message>(unaries[e[0]], p);
+      lp.template add_message<right_message>(unaries[e[1]], p);
+      lp.AddFactorRelation(unaries[e[0]], p);
+      lp.AddFactorRelation(p, unaries[e[1]]);
+    }
+  }
+
+  Solver<LP<shared_pairwise_FMC>, StandardVisitor> s2({"", "--maxIter", "20"});
+  {
+    auto& lp = s2.GetLP();
+    std::vector<unary*> unaries(unary_costs.size());
+#pragma omp parallel for
+    for(INDEX i=0; i<unaries.size(); ++i) {
+      unaries[i] = new unary(unary_costs[i]);
+    }
+    lp.add_factors(unaries.begin(), unaries.end());
+    std::vector<pairwise*> pairwise_factors(edges.size());
+#pragma omp parallel for
+    for(INDEX e=0; e<edges.size(); ++e) {
+      pairwise_factors[e] = new pairwise(potential, scale);
+    }
+    lp.add_factors(pairwise_factors.begin(), pairwise_factors.end());
+
+    // each unary is connected by one thread, left and right messages in separate phases
+    std::vector<left_message*> left_messages(edges.size());
+    std::vector<right_message*> right_messages(edges.size());
+#pragma omp parallel for
+    for(INDEX i=0; i<unaries.size(); ++i) {
+      for(INDEX e=0; e<edges.size(); ++e) {
+        if(edges[e][0] == i) { left_messages[e] = lp.template connect_message<left_message>(unaries[i], pairwise_factors[e]); }
+      }
+    }
+#pragma omp parallel for
+    for(INDEX i=0; i<unaries.size(); ++i) {
+      for(INDEX e=0; e<edges.size(); ++e) {
+        if(edges[e][1] == i) { right_messages[e] = lp.template connect_message<right_message>(unaries[i], pairwise_factors[e]); }
+      }
+    }
+    lp.add_messages(left_messages.begin(), left_messages.end());
+    lp.add_messages(right_messages.begin(), right_messages.end());
+
+    std::vector<std::array<FactorTypeAdapter*,2>> relations;
+    for(INDEX i=1; i<unaries.size(); ++i) {
+      relations.push_back({unaries[i-1], unaries[i]});
+    }
+    for(INDEX e=0; e<edges.size(); ++e) {
+      relations.push_back({unaries[edges[e][0]], pairwise_factors[e]});
+      relations.push_back({pairwise_factors[e], unaries[edges[e][1]]});
+    }
+    lp.AddFactorRelations(relations.begin(), relations.end());
+  }
+
+  auto& lp1 = s1.GetLP();
+  auto& lp2 = s2.GetLP();
+  test(lp1.GetNumberOfFactors() == lp2.GetNumberOfFactors());
+  test(lp1.GetNumberOfMessages() == lp2.GetNumberOfMessages());
+  for(INDEX i=0; i<lp1.GetNumberOfFactors(); ++i) {
+    test(lp2.factor_index(lp2.GetFactor(i)) == i);
+    test(lp2.GetFactor(i)->factor_index() == i);
+  }
+  // messages are registered per edge resp. first all left and then all right messages
+  auto same_message = [&](const INDEX m1, const INDEX m2) {
+    return lp1.GetMessage(m1).left == lp2.GetMessage(m2).left && lp1.GetMessage(m1).right == lp2.GetMessage(m2).right;
+  };
+  for(INDEX e=0; e<edges.size(); ++e) {
+    test(same_message(2*e, e));
+    test(same_message(2*e+1, edges.size() + e));
+  }
+
+  s1.Solve();
+  s2.Solve();
+  test(std::abs(lp1.LowerBound() - lp2.LowerBound()) <= eps*std::abs(lp1.LowerBound()));
+}
@@ -0,0 +1,79 @@
+#include "test_model.hxx"
+#include "LP_FWMAP.hxx"
+#include "LP_conic_bundle.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include <chrono>
+#include <iomanip>
+
+using namespace LP_MP;
+
+// benchmark: time for the subgradient update rules, FWMAP and conic bundle to reach a relative gap to the optimum of a random test model
+
+// all factors of the random test model are coupled by equality messages, hence the optimum takes the same label everywhere
+template<typename LP_TYPE>
+REAL test_model_optimum(const LP_TYPE& lp)
+{
+  std::array<REAL,2> cost = {0.0, 0.0};
+  for(INDEX i=0; i<lp.GetNumberOfFactors(); ++i) {
+    auto* f = dynamic_cast<typename test_FMC::factor*>(lp.GetFactor(i));
+    assert(f != nullptr);
+    cost[0] += f->GetFactor()->cost[0];
+    cost[1] += f->GetFactor()->cost[1];
+  }
+  return std::min(cost[0], cost[1]);
+}
+
+// lower bound over time for a tree decomposition based solver on a random test model
+template<typename LP_TYPE>
+std::vector<std::tuple<double, REAL>> dual_ascent_trajectory(std::vector<std::string> options, const INDEX no_iterations, REAL& optimum)
+{
+  Solver<LP_TYPE, StandardVisitor> s(options);
+  auto& lp = s.GetLP();
+  build_random_test_model(lp, 10, 50, 1);
+  optimum = test_model_optimum(lp);
+
+  std::vector<std::tuple<double, REAL>> trajectory;
+  const auto begin_time = std::chrono::steady_clock::now();
+  s.Begin();
+  for(INDEX iter=0; iter<no_iterations; ++iter) {
+    lp.ComputePass(iter);
+    const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+    trajectory.push_back({time, lp.LowerBound()});
+  }
+  return trajectory;
+}
+
+// first time at which lower bound is within relative gap of the optimum
+double time_to_gap(const std::vector<std::tuple<double, REAL>>& trajectory, const REAL optimum, const REAL gap)
+{
+  for(auto [time, lb] : trajectory) {
+    if(optimum - lb <= gap * std::max(REAL(1.0), std::abs(optimum))) {
+      return time;
+    }
+  }
+  return std::numeric_limits<double>::infinity();
+}
+
+int main(int argc, char** argv)
+{
+  const INDEX no_iterations = 200;
+  REAL optimum;
+  std::vector<std::tuple<std::string, std::vector<std::tuple<double, REAL>>>> trajectories;
+  for(const std::string method : {"subgradient", "polyak", "nesterov", "adagrad", "adam"}) {
+    trajectories.push_back({method, dual_ascent_trajectory<LP_subgradient_ascent<test_FMC>>({"", "--dualAscentMethod", method}, no_iterations, optimum)});
+  }
+  trajectories.push_back({"FWMAP", dual_ascent_trajectory<LP_tree_FWMAP<test_FMC>>({""}, no_iterations, optimum)});
+  trajectories.push_back({"conic bundle", dual_ascent_trajectory<LP_conic_bundle<test_FMC>>({""}, no_iterations, optimum)});
+
+  std::cout << "optimum " << optimum << "\n";
+  std::cout << std::setw(14) << "method" << std::setw(14) << "gap 1e-2" << std::setw(14) << "gap 1e-4" << std::setw(14) << "best lb" << "\n";
+  for(const auto& t : trajectories) {
+    const auto& trajectory = std::get<1>(t);
+    const REAL best_lb = std::get<1>(*std::max_element(trajectory.begin(), trajectory.end(), [](auto a, auto b) { return std::get<1>(a) < std::get<1>(b); }));
+    std::cout << std::setw(14) << std::get<0>(t)
+      << std::setw(14) << time_to_gap(trajectory, optimum, 1e-2)
+      << std::setw(14) << time_to_gap(trajectory, optimum, 1e-4)
+      << std::setw(14) << best_lb << "\n";
+  }
+}
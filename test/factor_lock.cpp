@@ -0,0 +1,94 @@
+#include "config.hxx"
+#include "spinlock.hxx"
+#include "test.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iostream>
+
+using namespace LP_MP;
+
+// grid of factors updated in parallel like in UpdateFactorSynchronized: wait for the lock of the factor itself, try to lock its neighbours and reparametrize the locked ones.
+// Reparametrizations are plain increments, they are lost if locking is not exclusive.
+template<typename LOCK>
+void benchmark(const std::string& name, const std::size_t dim, const std::size_t no_iterations)
+{
+   const std::size_t n = dim*dim;
+   std::vector<lock_holder<LOCK>> locks(n);
+   std::vector<std::size_t> repam(n, 0);
+
+   const auto begin_time = std::chrono::steady_clock::now();
+   std::size_t no_updates = 0;
+   for(std::size_t iter=0; iter<no_iterations; ++iter) {
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:no_updates)
+      for(std::size_t i=0; i<n; ++i) {
+         auto& l = locks[i].get(i);
+         std::lock_guard<std::remove_reference_t<decltype(l)>> lck(l);
+         ++repam[i];
+         ++no_updates;
+         const std::size_t neighbours[] = {i%dim > 0 ? i-1 : i, i%dim+1 < dim ? i+1 : i, i >= dim ? i-dim : i, i+dim < n ? i+dim : i};
+         for(const std::size_t j : neighbours) { // the factor itself is among the neighbours at the border and must be acquired again
+            auto& m = locks[j].get(j);
+            if(m.try_lock()) {
+               ++repam[j];
+               ++no_updates;
+               m.unlock();
+            }
+         }
+      }
+   }
+   const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+
+   std::size_t sum = 0;
+   for(const auto r : repam) { sum += r; }
+   test(sum == no_updates);
+   test(no_updates >= n*no_iterations);
+   std::cout << name << ": " << time << " seconds, " << sizeof(lock_holder<LOCK>) << " bytes per factor\n";
+}
+
+int main(int argc, char** argv)
+{
+   const std::size_t dim = argc > 1 ? std::stoul(argv[1]) : 200;
+   const std::size_t no_iterations = argc > 2 ? std::stoul(argv[2]) : 10;
+
+   // recursive spinlock is reentrant for the owning thread only
+   {
+      recursive_spinlock l;
+      test(l.try_lock());
+      test(l.try_lock());
+      l.unlock();
+      bool other_thread_locked = true;
+      std::thread t([&]() {
+         other_thread_locked = l.try_lock();
+         if(other_thread_locked) { l.unlock(); }
+      });
+      t.join();
+      test(!other_thread_locked);
+      l.unlock();
+      test(l.try_lock());
+      l.unlock();
+   }
+   // recursion depth saturates instead of overflowing into the owner
+   {
+      recursive_spinlock l;
+      std::size_t depth = 0;
+      while(l.try_lock()) { ++depth; }
+      test(depth == 255);
+      for(std::size_t i=0; i<depth; ++i) { l.unlock(); }
+      bool other_thread_locked = false;
+      std::thread t([&]() {
+         other_thread_locked = l.try_lock();
+         if(other_thread_locked) { l.unlock(); }
+      });
+      t.join();
+      test(other_thread_locked);
+   }
+   test(sizeof(recursive_spinlock) == 4);
+   test(&striped_lock<>::get(7) == &striped_lock<>::get(7));
+
+   benchmark<std::recursive_mutex>("std::recursive_mutex", dim, no_iterations);
+   benchmark<recursive_spinlock>("recursive_spinlock", dim, no_iterations);
+   benchmark<striped_lock<4096>>("striped_lock<4096>", dim, no_iterations);
+}
@@ -0,0 +1,40 @@
+#include "memory_report.hxx"
+#include "two_dimensional_variable_array.hxx"
+#include "packed_mask_array.hxx"
+#include "test.h"
+#include <sstream>
+
+using namespace LP_MP;
+
+int main()
+{
+   // entries with same subsystem and name accumulate
+   memory_report r;
+   r.add("factors", "factor 0", 10, 1000);
+   r.add("messages", "message 0", 5, 200);
+   r.add("factors", "factor 0", 2, 100);
+   r.add("factors", "factor 1", 1, 50);
+   test(r.entries().size() == 3);
+   test(r.entries()[0].count == 12 && r.entries()[0].bytes == 1100);
+   test(r.total() == 1350);
+   test(r.subsystem_total("factors") == 1150);
+   test(r.subsystem_total("messages") == 200);
+   test(r.subsystem_total("orderings") == 0);
+
+   // printing does not change stream formatting
+   std::stringstream s;
+   s.precision(3);
+   r.print(s);
+   test(s.precision() == 3);
+   test(s.str().find("message 0") != std::string::npos);
+
+   // arrays report their data and pointers
+   std::vector<INDEX> sizes = {3,0,5};
+   two_dim_variable_array<double> a(sizes);
+   test(a.memory() == 4*sizeof(double*) + 8*sizeof(double));
+   test(two_dim_variable_array<double>().memory() == 0);
+
+   packed_mask_array full_mask(sizes, true);
+   packed_mask_array mask(sizes);
+   test(mask.memory() > full_mask.memory());
+}
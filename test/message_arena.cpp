@@ -0,0 +1,93 @@
+#include "config.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "shared_pairwise_fmc.hxx"
+#include "message_arena.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+using unary = typename shared_pairwise_FMC::unary;
+using pairwise = typename shared_pairwise_FMC::pairwise;
+using left_message = typename shared_pairwise_FMC::left_message;
+using right_message = typename shared_pairwise_FMC::right_message;
+
+// grid model whose pairwise reparametrizations are allocated per factor or, if arenas are given, in one arena per message type
+template<typename SOLVER>
+void build_grid(SOLVER& s, const INDEX dim, const INDEX no_labels, pairwise_potential_pool& pool, message_arena* arena1 = nullptr, message_arena* arena2 = nullptr)
+{
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+  auto& lp = s.GetLP();
+  std::vector<unary*> unaries;
+  for(INDEX i=0; i<dim*dim; ++i) {
+    std::vector<REAL> cost(no_labels);
+    for(auto& x : cost) { x = dist(gen); }
+    unaries.push_back(lp.template add_factor<unary>(cost));
+  }
+  auto potential = pool.truncated_linear(no_labels, 2.0);
+  auto add_edge = [&](const INDEX i, const INDEX j) {
+    auto* p = arena1 == nullptr ? lp.template add_factor<pairwise>(potential, 0.4) : lp.template add_factor<pairwise>(potential, 0.4, arena1, arena2);
+    lp.template add_message<left_message>(unaries[i], p);
+    lp.template add_message<right_message>(unaries[j], p);
+    lp.AddFactorRelation(unaries[i], p);
+    lp.AddFactorRelation(p, unaries[j]);
+  };
+  for(INDEX i=0; i<dim; ++i) {
+    for(INDEX j=0; j<dim; ++j) {
+      if(j+1 < dim) { add_edge(i*dim+j, i*dim+j+1); }
+      if(i+1 < dim) { add_edge(i*dim+j, (i+1)*dim+j); }
+    }
+  }
+}
+
+int main()
+{
+  // slots are laid out consecutively
+  {
+    message_arena a;
+    a.reserve(3, 9);
+    test(a.add_slot(2) == 0);
+    test(a.add_slot(3) == 1);
+    test(a.add_slot(4) == 2);
+    test(a.no_slots() == 3 && a.no_values() == 9);
+    test(a.size(1) == 3 && a.offset(1) == 2 && a.data(1) == a.data(0) + 2 && a.data(2) == a.data(1) + 3);
+    test(a[2].size() == 4 && a[2][3] == 0.0);
+    a[1][2] = 1.0;
+    test(a.data(2)[-1] == 1.0);
+  }
+
+  // copies of factors in arena mode hold their own reparametrization
+  pairwise_potential_pool pool;
+  {
+    message_arena a1, a2;
+    shared_pairwise_factor f(pool.potts(3,4), 1.0, &a1, &a2);
+    test(f.arena_mode() && a1.no_values() == 3 && a2.no_values() == 4);
+    f.msg2(1) = 2.0;
+    test(a2[0][1] == 2.0);
+    shared_pairwise_factor g(f);
+    test(!g.arena_mode() && g.msg2(1) == 2.0);
+    g.msg2(1) = 3.0;
+    test(f.msg2(1) == 2.0);
+    f = g;
+    test(a2[0][1] == 3.0);
+  }
+
+  // message passing gives the same lower bound in both storage modes
+  const INDEX dim = 20;
+  const INDEX no_labels = 5;
+  Solver<LP<shared_pairwise_FMC>, StandardVisitor> s_factor({"", "--maxIter", "15"});
+  build_grid(s_factor, dim, no_labels, pool);
+  s_factor.Solve();
+
+  message_arena arena1, arena2;
+  Solver<LP<shared_pairwise_FMC>, StandardVisitor> s_arena({"", "--maxIter", "15"});
+  build_grid(s_arena, dim, no_labels, pool, &arena1, &arena2);
+  test(arena1.no_slots() == 2*dim*(dim-1) && arena1.no_values() == no_labels*arena1.no_slots());
+  s_arena.Solve();
+
+  const REAL lb_factor = s_factor.GetLP().LowerBound();
+  const REAL lb_arena = s_arena.GetLP().LowerBound();
+  test(std::abs(lb_factor - lb_arena) <= eps*std::max(REAL(1.0), std::abs(lb_factor)));
+}
@@ -0,0 +1,88 @@
+#include "min_convolution/min_convolution.hxx"
+#include "test.h"
+#include <random>
+#include <functional>
+
+using namespace LP_MP;
+
+// out[x] = min_y f[y] + d(x,y) by enumeration
+std::vector<REAL> distance_transform_naive(const std::vector<REAL>& f, const std::size_t n, std::function<REAL(std::size_t,std::size_t)> d)
+{
+  std::vector<REAL> out(n, std::numeric_limits<REAL>::infinity());
+  for(std::size_t x=0; x<n; ++x) {
+    for(std::size_t y=0; y<f.size(); ++y) {
+      out[x] = std::min(out[x], f[y] + d(x,y));
+    }
+  }
+  return out;
+}
+
+void test_equal(const std::vector<REAL>& a, const std::vector<REAL>& b)
+{
+  test(a.size() == b.size());
+  for(std::size_t i=0; i<a.size(); ++i) {
+    test(a[i] == b[i] || std::abs(a[i] - b[i]) <= eps*std::max(REAL(1.0), std::abs(a[i])));
+  }
+}
+
+int main()
+{
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<std::size_t> size(1, 40);
+  std::uniform_real_distribution<REAL> value(-2.0, 2.0);
+  std::uniform_real_distribution<REAL> weight(0.0, 1.5);
+  std::bernoulli_distribution forbidden(0.1);
+
+  // distance transforms agree with enumeration, also for infinite entries and differing dimensions
+  for(std::size_t run=0; run<500; ++run) {
+    std::vector<REAL> f(size(gen));
+    for(auto& x : f) { x = forbidden(gen) ? std::numeric_limits<REAL>::infinity() : value(gen); }
+    const std::size_t n = size(gen);
+    const REAL w = weight(gen);
+    const REAL t = 4.0*weight(gen);
+    auto dist = [](std::size_t x, std::size_t y) { return REAL(x > y ? x - y : y - x); };
+    std::vector<REAL> out(n);
+
+    min_convolution::potts_distance_transform(f, out, w);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return x == y ? 0.0 : w; }));
+    min_convolution::potts_distance_transform(f, out, -w);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return x == y ? 0.0 : -w; }));
+
+    min_convolution::l1_distance_transform(f, out, w);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return w*dist(x,y); }));
+    min_convolution::truncated_l1_distance_transform(f, out, w, t);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return w*std::min(dist(x,y), t); }));
+
+    min_convolution::l2_distance_transform(f, out, w);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return w*dist(x,y)*dist(x,y); }));
+    min_convolution::truncated_l2_distance_transform(f, out, w, t);
+    test_equal(out, distance_transform_naive(f, n, [&](auto x, auto y) { return w*std::min(dist(x,y)*dist(x,y), t); }));
+  }
+
+  // Bussieck et al. computes the same min-sum convolution as enumeration
+  {
+    std::vector<REAL> a {0.1, 0.2, 0.05, 1};
+    std::vector<REAL> b(a.rbegin(), a.rend());
+    test(min_convolution::min_conv_naive(a.begin(), a.end(), b.begin(), b.end()) == min_convolution::min_conv_Bussieck_et_al(a.begin(), a.end(), b.begin(), b.end()));
+  }
+  std::uniform_int_distribution<std::size_t> conv_size(1, 100);
+  std::uniform_int_distribution<int> small_value(0, 3); // many ties
+  for(std::size_t run=0; run<500; ++run) {
+    std::vector<REAL> a(conv_size(gen));
+    std::vector<REAL> b(conv_size(gen));
+    for(auto& x : a) { x = run % 2 ? value(gen) : small_value(gen); }
+    for(auto& x : b) { x = run % 2 ? value(gen) : small_value(gen); }
+    const auto naive = min_convolution::min_conv_naive(a.begin(), a.end(), b.begin(), b.end());
+    test(naive == min_convolution::min_conv_Bussieck_et_al(a.begin(), a.end(), b.begin(), b.end()));
+
+    // truncated result with argmins
+    const std::size_t result_size = std::min(naive.size(), conv_size(gen));
+    const auto [c, c_a, c_b] = min_convolution::arg_min_conv_Bussieck_et_al(a.begin(), a.end(), b.begin(), b.end(), result_size);
+    test(c.size() == result_size);
+    for(std::size_t k=0; k<result_size; ++k) {
+      test(c[k] == naive[k]);
+      test(c_a[k] + c_b[k] == k);
+      test(a[c_a[k]] + b[c_b[k]] == c[k]);
+    }
+  }
+}
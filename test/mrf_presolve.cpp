@@ -0,0 +1,158 @@
+#include "problem_constructors/mrf_presolve.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+using namespace LP_MP::mrf_presolve;
+
+// random model on given edges. Potts models have pairwise costs w*[k != l] with w >= 0, otherwise pairwise costs are arbitrary
+mrf_input random_model(const INDEX no_variables, const INDEX no_labels, const std::vector<std::array<INDEX,2>>& edges, const bool potts, std::mt19937& gen)
+{
+   std::uniform_real_distribution<REAL> dist(-1.0, 1.0);
+   std::uniform_int_distribution<INDEX> card_dist(1, no_labels);
+   mrf_input input;
+   input.number_of_variables_ = no_variables;
+   for(INDEX i=0; i<no_variables; ++i) {
+      input.cardinality_.push_back(potts ? no_labels : card_dist(gen));
+   }
+   input.unary_offsets_.resize(no_variables+1, 0);
+   std::partial_sum(input.cardinality_.begin(), input.cardinality_.end(), input.unary_offsets_.begin()+1);
+   for(std::size_t k=0; k<input.unary_offsets_.back(); ++k) {
+      input.unary_costs_.push_back(dist(gen));
+   }
+   for(const auto& e : edges) {
+      matrix<REAL> cost(input.cardinality_[e[0]], input.cardinality_[e[1]]);
+      const REAL w = 0.5*std::abs(dist(gen));
+      for(INDEX k=0; k<cost.dim1(); ++k) {
+         for(INDEX l=0; l<cost.dim2(); ++l) {
+            cost(k,l) = potts ? (k != l ? w : 0.0) : dist(gen);
+         }
+      }
+      input.pairwise_variables_.push_back(e);
+      input.pairwise_costs_.push_back(std::move(cost));
+   }
+   return input;
+}
+
+REAL energy(const mrf_input& input, const std::vector<INDEX>& labeling)
+{
+   REAL cost = 0.0;
+   for(INDEX i=0; i<input.number_of_variables_; ++i) {
+      cost += input.unary_costs_[input.unary_offsets_[i] + labeling[i]];
+   }
+   for(INDEX p=0; p<input.pairwise_variables_.size(); ++p) {
+      cost += input.pairwise_costs_[p](labeling[input.pairwise_variables_[p][0]], labeling[input.pairwise_variables_[p][1]]);
+   }
+   return cost;
+}
+
+// optimal labeling by enumeration
+std::vector<INDEX> brute_force(const mrf_input& input)
+{
+   std::vector<INDEX> labeling(input.number_of_variables_, 0);
+   std::vector<INDEX> best = labeling;
+   REAL best_cost = energy(input, labeling);
+   while(true) {
+      INDEX i=0;
+      for(; i<input.number_of_variables_; ++i) {
+         if(++labeling[i] < input.cardinality_[i]) { break; }
+         labeling[i] = 0;
+      }
+      if(i == input.number_of_variables_) { break; }
+      const REAL cost = energy(input, labeling);
+      if(cost < best_cost) {
+         best_cost = cost;
+         best = labeling;
+      }
+   }
+   return best;
+}
+
+// reduced model keeps an optimal labeling of the original model and has the same energy for corresponding labelings
+void test_presolve(const mrf_input& input, const options& o)
+{
+   const auto r = presolve(input, o);
+   test(r.reduced_input_.number_of_variables_ == input.number_of_variables_);
+   test(r.no_labels_ == input.unary_costs_.size());
+   test(r.reduction_ratio() >= 0.0 && r.reduction_ratio() < 1.0);
+
+   const REAL optimum = energy(input, brute_force(input));
+   const auto reduced_optimal = brute_force(r.reduced_input_);
+   const REAL reduced_optimum = energy(r.reduced_input_, reduced_optimal);
+   test(std::abs(optimum - reduced_optimum) <= 1e-6);
+   test(std::abs(energy(input, r.original_labeling(reduced_optimal)) - reduced_optimum) <= 1e-6);
+}
+
+int main()
+{
+   std::mt19937 gen(1);
+
+   // max-flow on small graph with two paths and a cross edge
+   {
+      mrf_presolve::max_flow g(4);
+      g.add_edge(0,1,3.0);
+      g.add_edge(0,2,2.0);
+      g.add_edge(1,2,1.0);
+      g.add_edge(1,3,1.5);
+      g.add_edge(2,3,4.0);
+      test(std::abs(g.compute(0,3) - 4.5) <= eps);
+      const auto source_side = g.source_side(3);
+      test(source_side[0] && source_side[1] && !source_side[2] && !source_side[3]);
+   }
+
+   // dominated label is removed, variable with one remaining label is fixed and its pairwise costs are moved into the unary of its neighbour
+   {
+      mrf_input input = random_model(2, 2, {{0,1}}, true, gen);
+      input.unary_costs_[0] = 10.0;
+      input.unary_costs_[1] = 0.0;
+      const auto r = presolve(input);
+      test(r.no_fixed_variables_ >= 1);
+      test(r.original_labels_[0].size() == 1 && r.original_labels_(0,0) == 1);
+      test(r.reduced_input_.pairwise_variables_.empty());
+      test(r.reduced_input_.clique_scopes_.size() == 2);
+   }
+
+   // strong unaries in Potts model are persistent by the one-against-all test, but not by dead-end elimination
+   {
+      std::vector<std::array<INDEX,2>> edges = {{0,1},{1,2},{0,2}};
+      mrf_input input = random_model(3, 3, edges, true, gen);
+      for(INDEX p=0; p<3; ++p) {
+         for(INDEX k=0; k<3; ++k) {
+            for(INDEX l=0; l<3; ++l) {
+               input.pairwise_costs_[p](k,l) = k != l ? 1.0 : 0.0;
+            }
+         }
+      }
+      std::fill(input.unary_costs_.begin(), input.unary_costs_.end(), 0.0);
+      for(INDEX i=0; i<3; ++i) {
+         input.unary_costs_[input.unary_offsets_[i]] = -1.0;
+      }
+      options o;
+      o.dead_end_elimination = false;
+      const auto r = presolve(input, o);
+      test(r.no_fixed_variables_ == 3);
+      test(r.reduction_ratio() == 1.0 - 3.0/9.0);
+      o.dead_end_elimination = true;
+      o.one_against_all = false;
+      test(presolve(input, o).no_fixed_variables_ == 0);
+   }
+
+   // random models checked against enumeration, with each test alone and combined
+   for(INDEX trial=0; trial<300; ++trial) {
+      const INDEX no_variables = 2 + trial%5;
+      std::vector<std::array<INDEX,2>> edges;
+      for(INDEX i=0; i<no_variables; ++i) {
+         for(INDEX j=i+1; j<no_variables; ++j) {
+            if(gen()%2) { edges.push_back({i,j}); }
+         }
+      }
+      const mrf_input input = random_model(no_variables, 3, edges, trial%2, gen);
+      options o;
+      test_presolve(input, o);
+      o.one_against_all = false;
+      test_presolve(input, o);
+      o.one_against_all = true;
+      o.dead_end_elimination = false;
+      test_presolve(input, o);
+   }
+}
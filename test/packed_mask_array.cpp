@@ -0,0 +1,44 @@
+#include "packed_mask_array.hxx"
+#include "test.h"
+#include <random>
+#include <algorithm>
+#include <numeric>
+
+using namespace LP_MP;
+
+int main()
+{
+   // random masks with rows crossing word boundaries agree with unpacked ones
+   std::mt19937 gen(0);
+   std::vector<INDEX> sizes(500);
+   for(auto& s : sizes) { s = gen()%150; }
+   std::vector<std::vector<unsigned char>> reference;
+   packed_mask_array mask(sizes);
+   test(mask.size() == sizes.size());
+   for(INDEX i=0; i<sizes.size(); ++i) {
+      reference.push_back(std::vector<unsigned char>(sizes[i], 0));
+      for(INDEX j=0; j<sizes[i]; ++j) {
+         if(gen()%3 == 0) {
+            reference[i][j] = 1;
+            mask.set(i,j);
+         }
+      }
+   }
+   auto it = mask.begin();
+   for(INDEX i=0; i<sizes.size(); ++i) {
+      const auto s = *(it + i);
+      test(s.size() == sizes[i]);
+      test(std::equal(s.begin(), s.end(), reference[i].begin(), reference[i].end()));
+      for(INDEX j=0; j<sizes[i]; ++j) { test(mask(i,j) == reference[i][j]); }
+   }
+   const std::size_t no_bits = std::accumulate(sizes.begin(), sizes.end(), std::size_t(0));
+   test(mask.no_words() == (no_bits + 63)/64);
+
+   // full masks hold no bits
+   packed_mask_array full(sizes, true);
+   test(full.full() && full.no_words() == 0);
+   for(INDEX i=0; i<sizes.size(); ++i) {
+      test(full[i].size() == sizes[i]);
+      test(std::all_of(full[i].begin(), full[i].end(), [](const unsigned char x) { return x == 1; }));
+   }
+}
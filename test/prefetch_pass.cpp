@@ -0,0 +1,70 @@
+#include "config.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "shared_pairwise_fmc.hxx"
+#include "test.h"
+#include <random>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+
+using namespace LP_MP;
+
+using unary = typename shared_pairwise_FMC::unary;
+using pairwise = typename shared_pairwise_FMC::pairwise;
+using left_message = typename shared_pairwise_FMC::left_message;
+using right_message = typename shared_pairwise_FMC::right_message;
+
+// grid model whose unaries are added in random order, so that factors adjacent in the update ordering are scattered in memory
+template<typename SOLVER>
+void build_grid(SOLVER& s, const INDEX dim, const INDEX no_labels, pairwise_potential_pool& pool)
+{
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+  auto& lp = s.GetLP();
+  std::vector<INDEX> allocation_order(dim*dim);
+  std::iota(allocation_order.begin(), allocation_order.end(), 0);
+  std::shuffle(allocation_order.begin(), allocation_order.end(), gen);
+  std::vector<unary*> unaries(dim*dim);
+  for(const INDEX i : allocation_order) {
+    std::vector<REAL> cost(no_labels);
+    for(auto& x : cost) { x = dist(gen); }
+    unaries[i] = lp.template add_factor<unary>(cost);
+  }
+  auto potential = pool.truncated_linear(no_labels, 2.0);
+  auto add_edge = [&](const INDEX i, const INDEX j) {
+    auto* p = lp.template add_factor<pairwise>(potential, 0.4);
+    lp.template add_message<left_message>(unaries[i], p);
+    lp.template add_message<right_message>(unaries[j], p);
+    lp.AddFactorRelation(unaries[i], p);
+    lp.AddFactorRelation(p, unaries[j]);
+  };
+  for(INDEX i=0; i<dim; ++i) {
+    for(INDEX j=0; j<dim; ++j) {
+      if(j+1 < dim) { add_edge(i*dim+j, i*dim+j+1); }
+      if(i+1 < dim) { add_edge(i*dim+j, (i+1)*dim+j); }
+    }
+  }
+}
+
+// prefetching does not change the result of a pass. Grid dimension can be given as argument for measuring on larger instances.
+int main(int argc, char** argv)
+{
+  const INDEX dim = argc > 1 ? std::stoi(argv[1]) : 30;
+  const INDEX no_labels = 5;
+  pairwise_potential_pool pool;
+
+  REAL lb_no_prefetch = 0.0;
+  for(const std::string distance : {"0", "1", "2", "4", "8", "16"}) {
+    Solver<LP<shared_pairwise_FMC>, StandardVisitor> s({"", "--maxIter", "10", "--prefetchDistance", distance});
+    build_grid(s, dim, no_labels, pool);
+    const auto begin_time = std::chrono::steady_clock::now();
+    s.Solve();
+    const auto end_time = std::chrono::steady_clock::now();
+    std::cout << "prefetch distance " << distance << ": " << std::chrono::duration<double>(end_time - begin_time).count() << " s\n";
+
+    const REAL lb = s.GetLP().LowerBound();
+    if(distance == "0") { lb_no_prefetch = lb; }
+    test(lb == lb_no_prefetch);
+  }
+}
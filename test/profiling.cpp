@@ -0,0 +1,45 @@
+#define LP_MP_PROFILING
+#include "profiling.hxx"
+#include "test.h"
+#include <thread>
+#include <sstream>
+
+using namespace LP_MP;
+
+void update(const std::size_t factor_no)
+{
+   LP_MP_PROFILE(update_factor, factor_no, 8);
+   LP_MP_PROFILE(maximize_potential, factor_no, 4);
+}
+
+// counts of all threads are summed up, also of threads that have finished
+int main()
+{
+   const std::size_t no_threads = 4;
+   const std::size_t no_calls = 1000;
+   std::vector<std::thread> threads;
+   for(std::size_t t=0; t<no_threads; ++t) {
+      threads.emplace_back([=]() {
+         for(std::size_t i=0; i<no_calls; ++i) { update(i%2 == 0 ? 0 : 3); }
+      });
+   }
+   for(auto& t : threads) { t.join(); }
+
+   const auto records = profiling::collect();
+   test(records.size() == 4);
+   for(const auto& r : records) {
+      test(r.c == profiling::counter::update_factor || r.c == profiling::counter::maximize_potential);
+      test(r.type_no == 0 || r.type_no == 3);
+      test(r.e.calls == no_threads*no_calls/2);
+      test(r.e.bytes == r.e.calls*(r.c == profiling::counter::update_factor ? 8 : 4));
+   }
+
+   std::stringstream table, json;
+   profiling::print_table(table, records);
+   profiling::print_json(json, records);
+   test(table.str().find("maximize_potential") != std::string::npos);
+   test(json.str().find("\"factor\": 3") != std::string::npos);
+
+   profiling::reset();
+   test(profiling::collect().empty());
+}
@@ -0,0 +1,111 @@
+#include "config.hxx"
+#include "factors_messages.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "factors/shared_pairwise_factor.hxx"
+#include "shared_pairwise_fmc.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+// specialized min-marginals agree with the ones of the explicitly stored table
+void test_min_marginals(const shared_pairwise_potential& implicit, pairwise_potential_pool& pool, const REAL scale, std::mt19937& gen)
+{
+  std::uniform_real_distribution<REAL> dist(-2.0, 2.0);
+  matrix<REAL> table(implicit->dim1(), implicit->dim2());
+  for(INDEX x1=0; x1<table.dim1(); ++x1) {
+    for(INDEX x2=0; x2<table.dim2(); ++x2) {
+      table(x1,x2) = (*implicit)(x1,x2);
+    }
+  }
+  shared_pairwise_factor f(implicit, scale);
+  shared_pairwise_factor g(pool.general(table), scale);
+  test(g.potential().potential_type() == pairwise_potential::type::general);
+  for(INDEX x1=0; x1<f.dim1(); ++x1) { f.msg1(x1) = g.msg1(x1) = dist(gen); }
+  for(INDEX x2=0; x2<f.dim2(); ++x2) { f.msg2(x2) = g.msg2(x2) = dist(gen); }
+
+  test(std::abs(f.LowerBound() - g.LowerBound()) <= eps);
+  const auto f1 = f.min_marginal_1();
+  const auto g1 = g.min_marginal_1();
+  for(INDEX x1=0; x1<f.dim1(); ++x1) { test(std::abs(f1[x1] - g1[x1]) <= eps); }
+  const auto f2 = f.min_marginal_2();
+  const auto g2 = g.min_marginal_2();
+  for(INDEX x2=0; x2<f.dim2(); ++x2) { test(std::abs(f2[x2] - g2[x2]) <= eps); }
+}
+
+int main()
+{
+  std::mt19937 gen(0);
+  pairwise_potential_pool pool;
+
+  // identical potentials are shared
+  {
+    auto p1 = pool.potts(4,4);
+    auto p2 = pool.potts(4,4);
+    test(p1 == p2);
+    test(pool.truncated_linear(5, 2.0) == pool.truncated_linear(5, 2.0));
+    test(pool.truncated_linear(5, 2.0) != pool.truncated_linear(5, 3.0));
+    matrix<REAL> c(2,3, 1.0);
+    auto g1 = pool.general(c);
+    auto g2 = pool.general(c);
+    c(1,2) = 0.0;
+    auto g3 = pool.general(c);
+    test(g1 == g2 && g1 != g3);
+    test(pool.size() == 5);
+
+    shared_pairwise_factor f(p1, 2.0);
+    shared_pairwise_factor g(p1, 3.0);
+    test(p1.use_count() == 5);
+  }
+
+  for(INDEX i=0; i<20; ++i) {
+    test_min_marginals(pool.potts(5,5), pool, 1.5, gen);
+    test_min_marginals(pool.potts(5,5), pool, -0.5, gen);
+    test_min_marginals(pool.potts(3,6), pool, 0.7, gen);
+    test_min_marginals(pool.potts(1,4), pool, 0.7, gen);
+    test_min_marginals(pool.truncated_linear(7, 2.0), pool, 0.8, gen);
+    test_min_marginals(pool.truncated_linear(7, 0.0), pool, 0.8, gen);
+    test_min_marginals(pool.linear(4, 6), pool, 0.3, gen);
+    test_min_marginals(pool.quadratic(6, 4), pool, 0.2, gen);
+    test_min_marginals(pool.truncated_quadratic(8, 5.0), pool, 0.4, gen);
+  }
+
+  // on a chain message passing attains the optimum, all pairwise factors share one potential
+  {
+    Solver<LP<shared_pairwise_FMC>, StandardVisitor> s({"", "--maxIter", "50"});
+    auto& lp = s.GetLP();
+    const INDEX n = 6;
+    const INDEX no_labels = 3;
+    std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+    std::vector<std::vector<REAL>> unary_costs(n, std::vector<REAL>(no_labels));
+    std::vector<typename shared_pairwise_FMC::unary*> unaries;
+    for(INDEX i=0; i<n; ++i) {
+      for(auto& c : unary_costs[i]) { c = dist(gen); }
+      unaries.push_back(lp.template add_factor<typename shared_pairwise_FMC::unary>(unary_costs[i]));
+    }
+    const REAL scale = 0.3;
+    auto potential = pool.truncated_linear(no_labels, 1.0);
+    for(INDEX i=0; i+1<n; ++i) {
+      auto* p = lp.template add_factor<typename shared_pairwise_FMC::pairwise>(potential, scale);
+      lp.template add_message<typename shared_pairwise_FMC::left_message>(unaries[i], p);
+      lp.template add_message<typename shared_pairwise_FMC::right_message>(unaries[i+1], p);
+      lp.AddFactorRelation(unaries[i], p);
+      lp.AddFactorRelation(p, unaries[i+1]);
+    }
+    s.Solve();
+
+    // brute force optimum
+    REAL optimum = std::numeric_limits<REAL>::infinity();
+    std::vector<INDEX> labeling(n, 0);
+    for(INDEX k=0; k<std::pow(no_labels, n); ++k) {
+      for(INDEX i=0, r=k; i<n; ++i, r/=no_labels) { labeling[i] = r % no_labels; }
+      REAL cost = 0.0;
+      for(INDEX i=0; i<n; ++i) { cost += unary_costs[i][labeling[i]]; }
+      for(INDEX i=0; i+1<n; ++i) { cost += scale*(*potential)(labeling[i], labeling[i+1]); }
+      optimum = std::min(optimum, cost);
+    }
+    test(std::abs(lp.LowerBound() - optimum) <= eps);
+    test(potential.use_count() == n+1);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef LP_MP_TEST_SHARED_PAIRWISE_FMC_HXX
+#define LP_MP_TEST_SHARED_PAIRWISE_FMC_HXX
+
+#include "config.hxx"
+#include "factors_messages.hxx"
+#include "factors/shared_pairwise_factor.hxx"
+
+namespace LP_MP {
+
+// minimal pairwise model with shared pairwise potentials for tests
+struct unary_factor {
+  unary_factor(const std::vector<REAL>& c) : cost(c.begin(), c.end()) {}
+  REAL LowerBound() const { return cost.min(); }
+  REAL EvaluatePrimal() const { return primal_ < size() ? cost[primal_] : std::numeric_limits<REAL>::infinity(); }
+  void MaximizePotentialAndComputePrimal()
+  {
+    if(primal_ >= size()) { primal_ = std::min_element(cost.begin(), cost.end()) - cost.begin(); }
+  }
+  void init_primal() { primal_ = std::numeric_limits<INDEX>::max(); }
+  REAL& operator[](const INDEX i) { return cost[i]; }
+  REAL operator[](const INDEX i) const { return cost[i]; }
+  INDEX size() const { return cost.size(); }
+  void prefetch() const { cost.prefetch(); }
+  INDEX& primal() { return primal_; }
+  INDEX primal() const { return primal_; }
+
+  template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); }
+  template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar(primal_); }
+  auto export_variables() { return std::tie(cost); }
+  template<typename SOLVER>
+  void construct_constraints(SOLVER& s, typename SOLVER::vector v) { s.add_simplex_constraint(v.begin(), v.end()); }
+  template<typename SOLVER>
+  void convert_primal(SOLVER& s, typename SOLVER::vector v)
+  {
+    for(INDEX i=0; i<v.size(); ++i) { if(s.solution(v[i])) { primal_ = i; } }
+  }
+
+  vector<REAL> cost;
+  INDEX primal_;
+};
+
+struct shared_pairwise_FMC {
+  constexpr static const char* name = "shared pairwise potentials";
+  using unary = FactorContainer<unary_factor, shared_pairwise_FMC, 0>;
+  using pairwise = FactorContainer<shared_pairwise_factor, shared_pairwise_FMC, 1>;
+  using left_message = MessageContainer<shared_pairwise_message<0>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, shared_pairwise_FMC, 0>;
+  using right_message = MessageContainer<shared_pairwise_message<1>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, shared_pairwise_FMC, 1>;
+  using FactorList = meta::list<unary, pairwise>;
+  using MessageList = meta::list<left_message, right_message>;
+  using ProblemDecompositionList = meta::list<>;
+};
+
+} // end namespace LP_MP
+
+#endif // LP_MP_TEST_SHARED_PAIRWISE_FMC_HXX
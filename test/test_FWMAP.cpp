@@ -8,17 +8,44 @@ using namespace LP_MP;
 
 int main(int argc, char** argv)
 {
-  Solver<LP_tree_FWMAP<test_FMC>, StandardVisitor> s;
-  auto& lp = s.GetLP();
+  {
+    Solver<LP_tree_FWMAP<test_FMC>, StandardVisitor> s;
+    auto& lp = s.GetLP();
 
-  build_test_model(lp);
+    build_test_model(lp);
 
-  s.Solve();
+    s.Solve();
 
-  test( std::abs(s.GetLP().decomposition_lower_bound() - 1.0) <= eps );
+    test( std::abs(s.GetLP().decomposition_lower_bound() - 1.0) <= eps );
 
-  s.GetLP().write_back_reparametrization();
-  test(std::abs(s.GetLP().original_factors_lower_bound() - 1.0) <= eps);
-}
+    s.GetLP().write_back_reparametrization();
+    test(std::abs(s.GetLP().original_factors_lower_bound() - 1.0) <= eps);
+  }
+
+  // the shared factor is the right factor of its messages, hence links to the right side are redirected to copies
+  {
+    Solver<LP_tree_FWMAP<test_FMC>, StandardVisitor> s;
+    auto& lp = s.GetLP();
+
+    build_test_model_shared_right(lp);
+
+    s.Solve();
+
+    test( std::abs(s.GetLP().decomposition_lower_bound() - 1.0) <= eps );
 
+    s.GetLP().write_back_reparametrization();
+    test(std::abs(s.GetLP().original_factors_lower_bound() - 1.0) <= eps);
+  }
 
+  // message passing first, then hand off reparametrization to FWMAP
+  {
+    Solver<LP_tree_FWMAP<test_FMC>, StandardVisitor> s({"", "--maxIter", "20", "--treeDecompositionBegin", "5"});
+    auto& lp = s.GetLP();
+
+    build_test_model(lp);
+
+    s.Solve();
+
+    test( std::abs(s.GetLP().decomposition_lower_bound() - 1.0) <= eps );
+  }
+}
@@ -0,0 +1,77 @@
+#include "test_model.hxx"
+#include "branch_and_bound.hxx"
+#include "factors/labeling_list_factor.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+using test_labelings = labelings<labeling<1,0>, labeling<0,1>>;
+
+// the zero labeling of implicit origin factors has no explicit cost and cannot be forbidden, hence they do not branch
+static_assert(!FunctionExistence::has_branch_left<labeling_factor<test_labelings, true>, void>());
+static_assert(!FunctionExistence::has_branch_right<labeling_factor<test_labelings, true>, void>());
+static_assert(FunctionExistence::has_branch_left<labeling_factor<test_labelings, false>, void>());
+static_assert(FunctionExistence::has_branch_right<labeling_factor<test_labelings, false>, void>());
+
+int main()
+{
+  // branching on the current labeling of a labeling factor
+  {
+    labeling_factor<test_labelings, false> f;
+    f[0] = 1.0;
+    f[1] = 2.0;
+    f.primal() = std::bitset<2>("01"); // labeling<1,0>
+
+    auto f_left = f;
+    f_left.branch_left();
+    test(f_left[0] == 1.0 && f_left[1] == std::numeric_limits<REAL>::infinity());
+
+    auto f_right = f;
+    f_right.branch_right();
+    test(f_right[0] == std::numeric_limits<REAL>::infinity() && f_right[1] == 2.0);
+  }
+
+  // cycle of factors coupled by equality messages. Optimal labeling takes the same label everywhere.
+  for(const INDEX no_bounding_passes : {0, 1, 5}) {
+    Solver<LP<test_FMC>, StandardVisitor> s;
+    auto& lp = s.GetLP();
+    std::mt19937 gen(no_bounding_passes);
+    std::uniform_real_distribution<REAL> cost(-1.0, 1.0);
+
+    const INDEX n = 8;
+    REAL cost_0 = 0.0;
+    REAL cost_1 = 0.0;
+    std::vector<typename test_FMC::factor*> factors;
+    for(INDEX i=0; i<n; ++i) {
+      const REAL c0 = cost(gen);
+      const REAL c1 = cost(gen);
+      cost_0 += c0;
+      cost_1 += c1;
+      factors.push_back( lp.template add_factor<typename test_FMC::factor>(c0, c1) );
+    }
+    for(INDEX i=0; i<n; ++i) {
+      lp.template add_message<typename test_FMC::message>(factors[i], factors[(i+1)%n]);
+    }
+    const REAL lb_before = lp.LowerBound();
+
+    branch_and_bound bb(1000, no_bounding_passes);
+    lp.for_each_factor([&](auto* f) { bb.add_factor(f); });
+    bb.add_messages(lp);
+    test(bb.GetNumberOfFactors() == n);
+    test(bb.GetNumberOfMessages() == n);
+
+    test(bb.solve());
+    test(bb.optimal());
+    test(!bb.dirty());
+    test(std::abs(bb.upper_bound() - std::min(cost_0, cost_1)) <= eps);
+    test(std::abs(bb.lower_bound() - bb.upper_bound()) <= eps);
+
+    // reparametrization is restored, best labeling is written into factors
+    test(std::abs(lp.LowerBound() - lb_before) <= eps);
+    test(lp.CheckPrimalConsistency());
+    test(std::abs(lp.EvaluatePrimal() - bb.upper_bound()) <= eps);
+  }
+}
@@ -0,0 +1,46 @@
+#include "test_model.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "test.h"
+
+using namespace LP_MP;
+
+int main(int argc, char** argv)
+{
+  // each update rule reaches the known optimum of the test model
+  for(const std::string method : {"subgradient", "polyak", "nesterov", "adagrad", "adam"}) {
+    Solver<LP_subgradient_ascent<test_FMC>, StandardVisitor> s({"", "--maxIter", "50", "--dualAscentMethod", method});
+    auto& lp = s.GetLP();
+    build_test_model(lp);
+    s.Solve();
+    test( std::abs(s.GetLP().decomposition_lower_bound() - 1.0) <= eps );
+  }
+
+  // reparametrization of the tree decomposition converts exactly into Lagrangean multipliers and back
+  {
+    Solver<LP_subgradient_ascent<test_FMC>, StandardVisitor> s({"", "--maxIter", "20", "--dualAscentMethod", "polyak"});
+    auto& lp = s.GetLP();
+    build_random_test_model(lp, 5, 20, 2);
+    s.Solve();
+
+    const REAL lb = lp.decomposition_lower_bound();
+    const auto w = lp.reparametrization_to_multipliers();
+    test(std::abs(lp.decomposition_lower_bound() - lb) <= eps); // querying the multipliers does not change the LP
+
+    // removing the deviations sets all copies to their mean
+    lp.multipliers_to_reparametrization(w, -1.0);
+    for(const auto& w_centered : lp.reparametrization_to_multipliers()) {
+      for(const double x : w_centered) { test(std::abs(x) <= eps); }
+    }
+
+    lp.multipliers_to_reparametrization(w);
+    test(std::abs(lp.decomposition_lower_bound() - lb) <= eps);
+
+    const auto w_restored = lp.reparametrization_to_multipliers();
+    for(std::size_t i=0; i<w.size(); ++i) {
+      for(std::size_t j=0; j<w[i].size(); ++j) {
+        test(std::abs(w[i][j] - w_restored[i][j]) <= eps);
+      }
+    }
+  }
+}
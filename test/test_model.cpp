@@ -5,7 +5,10 @@
 #include "test.h"
 #include "LP_external_interface.hxx"
 #include "test_model.hxx"
+#include "partial_external_solver.hxx"
 #include <random>
+#include <fstream>
+#include <algorithm>
 
 using namespace LP_MP; 
 
@@ -46,7 +49,72 @@ int main()
         std::cout << "lower bound after optimization = " << s.GetLP().LowerBound() << "\n";
         test(std::abs(s.GetLP().LowerBound() - 1.0) <= eps);
         s.GetLP().get_external_solver().write_to_file("test_problem.lp");
+
+        // streaming export writes 3 simplex constraints, 2*2 equalities and 6 binaries
+        s.GetLP().stream_to_file("test_problem_streamed.lp");
+        std::ifstream f("test_problem_streamed.lp");
+        std::string line;
+        std::vector<std::string> lines;
+        while(std::getline(f, line)) { lines.push_back(line); }
+        test(lines.front() == "Minimize");
+        test(lines.back() == "End");
+        test(std::count(lines.begin(), lines.end(), "Subject To") == 1);
+        test(std::count_if(lines.begin(), lines.end(), [](const std::string& l) { return l.size() > 4 && l.substr(l.size()-4) == " = 1"; }) == 3);
+        test(std::count_if(lines.begin(), lines.end(), [](const std::string& l) { return l.size() > 4 && l.substr(l.size()-4) == " = 0"; }) == 4);
+        test(std::find(lines.begin(), lines.end(), " x0 x1 x2 x3 x4 x5") != lines.end());
+    }
+
+#ifdef __linux__
+    // write errors are reported by close(), the destructor does not throw
+    {
+        bool close_failed = false;
+        {
+            chunked_file_writer out("/dev/full");
+            out << "Minimize\n";
+            try {
+                out.close();
+            } catch(const std::runtime_error&) {
+                close_failed = true;
+            }
+        }
+        test(close_failed);
+
+        bool destructor_threw = false;
+        try {
+            chunked_file_writer out("/dev/full");
+            out << "Minimize\n";
+        } catch(...) {
+            destructor_threw = true;
+        }
+        test(!destructor_threw);
     }
+#endif
+
+#ifdef DD_ILP_WITH_GUROBI
+    // changed costs are loaded and the model is solved again. Only gurobi optimizes with respect to the loaded costs.
+    {
+        Solver<LP<test_FMC>, StandardVisitor> s;
+        auto& lp = s.GetLP();
+        auto* f1 = lp.template add_factor<typename test_FMC::factor>(0,2);
+        auto* f2 = lp.template add_factor<typename test_FMC::factor>(1,0);
+        auto* m12 = lp.template add_message<typename test_FMC::message>(f1,f2);
+
+        partial_external_solver<DD_ILP::gurobi_interface> external_solver;
+        external_solver.add_factor(f1);
+        external_solver.add_factor(f2);
+        external_solver.add_message(m12);
+        test(external_solver.solve());
+        test(f1->GetFactor()->primal == 0 && f2->GetFactor()->primal == 0);
+        test(!external_solver.dirty());
+
+        f1->GetFactor()->cost[0] = 2;
+        f1->GetFactor()->cost[1] = 0;
+        external_solver.update_costs(f1);
+        test(external_solver.dirty());
+        test(external_solver.solve());
+        test(f1->GetFactor()->primal == 1 && f2->GetFactor()->primal == 1);
+    }
+#endif
 
    {
        //Solver<LP<test_FMC>, StandardVisitor> s;
@@ -57,4 +125,42 @@ int main()
        //s.Solve();
 
    }
+
+   // inconsistent factors are fattened by their neighbors up to the given distance
+   {
+       Solver<LP<test_FMC>, StandardVisitor> s;
+       auto& lp = s.GetLP();
+       std::vector<typename test_FMC::factor*> chain;
+       for(INDEX i=0; i<6; ++i) {
+           chain.push_back(lp.template add_factor<typename test_FMC::factor>(0,1));
+       }
+       for(INDEX i=0; i+1<chain.size(); ++i) {
+           lp.template add_message<typename test_FMC::message>(chain[i], chain[i+1]);
+       }
+       for(auto* f : chain) { f->GetFactor()->primal = 0; }
+       chain[0]->GetFactor()->primal = 1; // locally non-optimal and violates message to chain[1]
+
+       test(lp.get_inconsistent_mask(0) == std::vector<bool>({true, true, false, false, false, false}));
+       test(lp.get_inconsistent_mask(2) == std::vector<bool>({true, true, true, true, false, false}));
+
+       const auto& adjacency = lp.get_factor_adjacency();
+       test(adjacency.size() == chain.size());
+       test(adjacency[0].size() == 1 && adjacency[1].size() == 2);
+       test(adjacency(0,0).adjacent_factor == 1 && adjacency(0,0).chirality == Chirality::left);
+       test(adjacency(0,0).sends_to_adjacent_factor && adjacency(0,0).adjacent_factor_receives);
+       for(INDEX i=0; i<chain.size(); ++i) {
+           const auto msgs = chain[i]->get_messages();
+           test(msgs.size() == adjacency[i].size());
+           for(INDEX k=0; k<msgs.size(); ++k) {
+               test(lp.factor_index(msgs[k].adjacent_factor) == adjacency(i,k).adjacent_factor);
+               test(msgs[k].chirality == adjacency(i,k).chirality);
+           }
+       }
+
+       // adding a factor invalidates the adjacency
+       auto* f = lp.template add_factor<typename test_FMC::factor>(0,1);
+       lp.template add_message<typename test_FMC::message>(chain.back(), f);
+       test(lp.get_factor_adjacency().size() == chain.size()+1);
+       test(lp.get_factor_adjacency()[chain.size()-1].size() == 2);
+   }
 }
@@ -2,6 +2,7 @@
 #define LP_MP_TEST_MODEL_HXX 
 
 #include <array>
+#include <random>
 #include "config.hxx"
 #include "factors_messages.hxx"
 #include "tree_decomposition.hxx"
@@ -34,6 +35,9 @@ struct test_factor {
 
   void init_primal() { primal = std::numeric_limits<INDEX>::max(); }
 
+  void branch_left() { assert(primal < 2); cost[1-primal] = std::numeric_limits<REAL>::infinity(); }
+  void branch_right() { assert(primal < 2); cost[primal] = std::numeric_limits<REAL>::infinity(); }
+
   template<typename ARCHIVE> void serialize_dual(ARCHIVE& ar) { ar(cost); };
   template<typename ARCHIVE> void serialize_primal(ARCHIVE& ar) { ar(primal); }; 
 
@@ -175,6 +179,62 @@ void build_test_model(LP_TYPE& lp)
   }
 }
 
+// same model as above, but the factor shared by all trees is the right factor of its messages
+template<typename LP_TYPE>
+void build_test_model_shared_right(LP_TYPE& lp)
+{
+  auto* f1 = lp.template add_factor<typename test_FMC::factor>(0,1);
+  {
+    factor_tree<test_FMC> t1;
+    auto* f2 = lp.template add_factor<typename test_FMC::factor>(1,0);
+    auto* f3 = lp.template add_factor<typename test_FMC::factor>(0,0);
+    auto* m21 = lp.template add_message<typename test_FMC::message>(f2,f1);
+    auto* m31 = lp.template add_message<typename test_FMC::message>(f3,f1);
+    t1.add_message(m21, Chirality::right);
+    t1.add_message(m31, Chirality::right);
+    lp.add_tree(t1);
+  }
+
+  for(INDEX i=0; i<2; ++i) {
+    factor_tree<test_FMC> t;
+    auto* f2 = lp.template add_factor<typename test_FMC::factor>(1,0);
+    auto* f3 = lp.template add_factor<typename test_FMC::factor>(0,0);
+    auto* m21 = lp.template add_message<typename test_FMC::message>(f2,f1);
+    auto* m23 = lp.template add_message<typename test_FMC::message>(f2,f3);
+    t.add_message(m21, Chirality::left);
+    t.add_message(m23, Chirality::left);
+    lp.add_tree(t);
+  }
+}
+
+// random model with no_trees trees of tree_size factors each. All trees share their root factor.
+template<typename LP_TYPE>
+void build_random_test_model(LP_TYPE& lp, const INDEX no_trees, const INDEX tree_size, const unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<REAL> cost(-1.0, 1.0);
+  std::vector<typename test_FMC::factor*> tree_factors;
+  std::vector<typename test_FMC::message*> tree_messages;
+
+  auto* root = lp.template add_factor<typename test_FMC::factor>(cost(gen), cost(gen));
+  for(INDEX t=0; t<no_trees; ++t) {
+    factor_tree<test_FMC> tree;
+    tree_factors.clear();
+    tree_messages.clear();
+    tree_factors.push_back(root);
+    for(INDEX i=1; i<tree_size; ++i) {
+      auto* f = lp.template add_factor<typename test_FMC::factor>(cost(gen), cost(gen));
+      std::uniform_int_distribution<INDEX> parent(0, i-1);
+      tree_messages.push_back( lp.template add_message<typename test_FMC::message>(tree_factors[parent(gen)], f) );
+      tree_factors.push_back(f);
+    }
+    // parents were added before children, hence reverse order goes from leaves to root
+    for(auto it=tree_messages.rbegin(); it!=tree_messages.rend(); ++it) {
+      tree.add_message(*it, Chirality::left);
+    }
+    lp.add_tree(tree);
+  }
+}
 
 } // namespace LP_MP 
 
@@ -0,0 +1,100 @@
+#include "topological_sort.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+// ordering respects all edges, levels are longest path lengths from the sources
+void test_sorting(const INDEX no_nodes, const std::vector<std::array<INDEX,2>>& edges)
+{
+   Topological_Sort::Graph g(no_nodes);
+   g.reserve_edges(edges.size());
+   for(const auto& e : edges) { g.addEdge(e[0], e[1]); }
+   const auto order = g.topologicalSort();
+   test(order.size() == no_nodes);
+
+   std::vector<INDEX> position(no_nodes);
+   for(INDEX i=0; i<order.size(); ++i) { position[order[i]] = i; }
+   for(const auto& e : edges) { test(position[e[0]] < position[e[1]]); }
+
+   const auto& offsets = g.level_offsets();
+   test(offsets.front() == 0 && offsets.back() == no_nodes);
+   std::vector<INDEX> level(no_nodes);
+   for(INDEX l=0; l<g.no_levels(); ++l) {
+      test(offsets[l] < offsets[l+1]);
+      test(std::is_sorted(order.begin() + offsets[l], order.begin() + offsets[l+1]));
+      for(INDEX i=offsets[l]; i<offsets[l+1]; ++i) { level[order[i]] = l; }
+   }
+   std::vector<INDEX> longest_path(no_nodes, 0);
+   for(const INDEX v : order) {
+      for(const auto& e : edges) {
+         if(e[1] == v) { longest_path[v] = std::max(longest_path[v], longest_path[e[0]] + 1); }
+      }
+   }
+   test(level == longest_path);
+}
+
+int main()
+{
+   // anti-diagonals of a grid with edges to the right and downwards are its levels
+   {
+      const INDEX dim = 20;
+      std::vector<std::array<INDEX,2>> edges;
+      for(INDEX i=0; i<dim; ++i) {
+         for(INDEX j=0; j<dim; ++j) {
+            if(j+1 < dim) { edges.push_back({i*dim+j, i*dim+j+1}); }
+            if(i+1 < dim) { edges.push_back({i*dim+j, (i+1)*dim+j}); }
+         }
+      }
+      test_sorting(dim*dim, edges);
+      Topological_Sort::Graph g(dim*dim);
+      for(const auto& e : edges) { g.addEdge(e[0], e[1]); }
+      g.topologicalSort();
+      test(g.no_levels() == 2*dim-1);
+   }
+
+   // levels wider than the parallel threshold next to a long chain
+   {
+      const INDEX width = 3000;
+      const INDEX chain = 100;
+      std::vector<std::array<INDEX,2>> edges;
+      for(INDEX i=0; i<width; ++i) {
+         edges.push_back({i, width + i});
+         edges.push_back({i, width + (i+1)%width});
+      }
+      for(INDEX i=0; i+1<chain; ++i) {
+         edges.push_back({2*width + i, 2*width + i + 1});
+      }
+      test_sorting(2*width + chain, edges);
+   }
+
+   // random DAGs with duplicate edges
+   std::mt19937 gen(0);
+   for(INDEX trial=0; trial<50; ++trial) {
+      const INDEX no_nodes = 1 + gen()%200;
+      std::vector<INDEX> permutation(no_nodes);
+      std::iota(permutation.begin(), permutation.end(), 0);
+      std::shuffle(permutation.begin(), permutation.end(), gen);
+      std::vector<std::array<INDEX,2>> edges;
+      const INDEX no_edges = gen()%(3*no_nodes);
+      for(INDEX e=0; e<no_edges && no_nodes > 1; ++e) {
+         INDEX i = gen()%no_nodes;
+         INDEX j = gen()%no_nodes;
+         if(i == j) { continue; }
+         if(i > j) { std::swap(i,j); }
+         edges.push_back({permutation[i], permutation[j]});
+      }
+      test_sorting(no_nodes, edges);
+   }
+
+   // cycles are detected
+   {
+      Topological_Sort::Graph g(3);
+      g.addEdge(0,1);
+      g.addEdge(1,2);
+      g.addEdge(2,0);
+      bool thrown = false;
+      try { g.topologicalSort(); } catch(const std::runtime_error&) { thrown = true; }
+      test(thrown);
+   }
+}
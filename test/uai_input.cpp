@@ -0,0 +1,80 @@
+#include "problem_constructors/uai_mmap_input.hxx"
+#include "uai_test_input.hxx"
+#include "test.h"
+#include <chrono>
+
+using namespace LP_MP;
+
+int main()
+{
+   // not all unaries present, one pairwise scope in decreasing order
+   {
+      const std::string uai_input =
+R"(MARKOV
+3
+2 2 3
+3
+1 0
+2 0 1
+2 2 1
+
+2
+ 0.436 0.564
+
+4
+ 0.128 0.872
+ 0.920 0.080
+
+6
+ 0.210 0.333
+ 0.457 1e-3
+ inf -2.5E+2
+)";
+      const auto input = UaiMrfMmapInput::parse(uai_input.data(), uai_input.data() + uai_input.size());
+      test(input.number_of_variables_ == 3);
+      test(input.unary_costs_ == std::vector<REAL>({0.436, 0.564, 0.0, 0.0, 0.0, 0.0, 0.0}));
+      test(input.pairwise_costs_.size() == 2);
+      test(input.pairwise_variables_[0] == std::array<INDEX,2>({0,1}));
+      test(input.pairwise_costs_[0](0,1) == 0.872 && input.pairwise_costs_[0](1,0) == 0.920);
+      test(input.pairwise_variables_[1] == std::array<INDEX,2>({1,2}));
+      const auto& transposed = input.pairwise_costs_[1];
+      test(transposed(0,0) == 0.210 && transposed(1,0) == 0.333 && transposed(0,1) == 0.457);
+      test(transposed(1,1) == 1e-3 && transposed(0,2) == std::numeric_limits<REAL>::infinity() && transposed(1,2) == -250.0);
+   }
+
+   // malformed function tables are rejected
+   for(const std::string uai_input : {"MARKOV 1 2 1 1 0 2 0.5", "MARKOV 1 2 1 1 0 3 0.5 0.5", "MARKOV 1 2 1 1 0 2 0.5 x"}) {
+      bool thrown = false;
+      try {
+         UaiMrfMmapInput::parse(uai_input.data(), uai_input.data() + uai_input.size());
+      } catch(std::runtime_error&) {
+         thrown = true;
+      }
+      test(thrown);
+   }
+
+   // entries on random grid are read exactly as with std::stod
+   {
+      const std::size_t dim = 100;
+      const std::size_t no_labels = 4;
+      const auto tables = write_uai_grid("uai_input_test.uai", dim, no_labels, 0);
+      const auto begin_time = std::chrono::steady_clock::now();
+      const auto input = UaiMrfMmapInput::parse_file("uai_input_test.uai");
+      std::cout << "memory mapped uai parser: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count() << " seconds\n";
+
+      test(input.number_of_variables_ == dim*dim);
+      test(input.pairwise_costs_.size() + dim*dim == tables.size());
+      for(std::size_t i=0; i<dim*dim; ++i) {
+         for(std::size_t x=0; x<no_labels; ++x) {
+            test(input.unary_costs_[input.unary_offsets_[i] + x] == std::stod(tables[i][x]));
+         }
+      }
+      for(std::size_t p=0; p<input.pairwise_costs_.size(); ++p) {
+         for(std::size_t x1=0; x1<no_labels; ++x1) {
+            for(std::size_t x2=0; x2<no_labels; ++x2) {
+               test(input.pairwise_costs_[p](x1,x2) == std::stod(tables[dim*dim + p][x1*no_labels + x2]));
+            }
+         }
+      }
+   }
+}
@@ -0,0 +1,50 @@
+#include "problem_constructors/mrf_problem_construction.hxx"
+#include "problem_constructors/uai_mmap_input.hxx"
+#include "uai_test_input.hxx"
+#include "test.h"
+#include <chrono>
+
+using namespace LP_MP;
+
+// compare PEGTL grammar and memory mapped parallel parser for uai files
+int main(int argc, char** argv)
+{
+   const std::size_t dim = argc > 1 ? std::stoul(argv[1]) : 300;
+   const std::size_t no_labels = argc > 2 ? std::stoul(argv[2]) : 8;
+   write_uai_grid("uai_input_benchmark.uai", dim, no_labels, 0);
+
+   auto begin_time = std::chrono::steady_clock::now();
+   pegtl::file_parser problem("uai_input_benchmark.uai");
+   UaiMrfInput::MrfInput pegtl_input;
+   test(problem.parse< UaiMrfInput::grammar, UaiMrfInput::action >(pegtl_input));
+   const double pegtl_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+
+   begin_time = std::chrono::steady_clock::now();
+   const auto mmap_input = UaiMrfMmapInput::parse_file("uai_input_benchmark.uai");
+   const double mmap_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+
+   std::cout << "PEGTL grammar: " << pegtl_time << " seconds\n";
+#ifdef _OPENMP
+   std::cout << "memory mapped parser: " << mmap_time << " seconds (" << omp_get_max_threads() << " threads)\n";
+#else
+   std::cout << "memory mapped parser: " << mmap_time << " seconds (1 thread)\n";
+#endif
+
+   // both parsers must agree exactly
+   test(pegtl_input.number_of_variables_ == mmap_input.number_of_variables_);
+   test(pegtl_input.number_of_cliques_ == mmap_input.clique_scopes_.size());
+   for(INDEX c=0, p=0; c<pegtl_input.number_of_cliques_; ++c) {
+      const auto& table = pegtl_input.function_tables_[c];
+      if(pegtl_input.clique_scopes_[c].size() == 1) {
+         const INDEX i = pegtl_input.clique_scopes_[c][0];
+         for(INDEX x=0; x<table.size(); ++x) {
+            test(table[x] == mmap_input.unary_costs_[mmap_input.unary_offsets_[i] + x]);
+         }
+      } else {
+         const auto& cost = mmap_input.pairwise_costs_[p++];
+         for(INDEX x=0; x<table.size(); ++x) {
+            test(table[x] == cost(x/cost.dim2(), x%cost.dim2()));
+         }
+      }
+   }
+}
@@ -0,0 +1,53 @@
+#ifndef LP_MP_UAI_TEST_INPUT_HXX
+#define LP_MP_UAI_TEST_INPUT_HXX
+
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+
+// write random grid graphical model in uai format with the given number of labels for all variables.
+// Returns the function table entries as written, in order of cliques.
+inline std::vector<std::vector<std::string>> write_uai_grid(const std::string& filename, const std::size_t dim, const std::size_t no_labels, const std::size_t seed)
+{
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<double> dist(-100.0, 100.0);
+   std::uniform_int_distribution<int> precision(1, 17);
+
+   const std::size_t no_vars = dim*dim;
+   std::vector<std::array<std::size_t,2>> edges;
+   for(std::size_t i=0; i<dim; ++i) {
+      for(std::size_t j=0; j<dim; ++j) {
+         if(i+1 < dim) { edges.push_back({i*dim + j, (i+1)*dim + j}); }
+         if(j+1 < dim) { edges.push_back({i*dim + j, i*dim + j + 1}); }
+      }
+   }
+
+   std::ofstream f(filename);
+   f << "MARKOV\n" << no_vars << "\n";
+   for(std::size_t i=0; i<no_vars; ++i) { f << no_labels << " "; }
+   f << "\n" << no_vars + edges.size() << "\n";
+   for(std::size_t i=0; i<no_vars; ++i) { f << "1 " << i << "\n"; }
+   for(const auto& e : edges) { f << "2 " << e[0] << " " << e[1] << "\n"; }
+
+   std::vector<std::vector<std::string>> tables;
+   auto write_table = [&](const std::size_t no_entries) {
+      f << "\n" << no_entries << "\n";
+      tables.push_back({});
+      for(std::size_t k=0; k<no_entries; ++k) {
+         std::ostringstream s;
+         s << std::setprecision(precision(gen)) << dist(gen);
+         tables.back().push_back(s.str());
+         f << " " << s.str();
+         if((k+1) % no_labels == 0) { f << "\n"; }
+      }
+   };
+   for(std::size_t i=0; i<no_vars; ++i) { write_table(no_labels); }
+   for(std::size_t e=0; e<edges.size(); ++e) { write_table(no_labels*no_labels); }
+   return tables;
+}
+
+#endif // LP_MP_UAI_TEST_INPUT_HXX
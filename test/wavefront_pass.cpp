@@ -0,0 +1,141 @@
+#include "config.hxx"
+#include "solver.hxx"
+#include "visitors/standard_visitor.hxx"
+#include "shared_pairwise_fmc.hxx"
+#include "problem_constructors/mrf_problem_construction.hxx"
+#include "test.h"
+#include <random>
+
+using namespace LP_MP;
+
+using unary = typename shared_pairwise_FMC::unary;
+using pairwise = typename shared_pairwise_FMC::pairwise;
+using left_message = typename shared_pairwise_FMC::left_message;
+using right_message = typename shared_pairwise_FMC::right_message;
+
+// grid model whose factor relations point to the right and downwards, hence the levels of the relation DAG are anti-diagonals
+template<typename SOLVER>
+void build_grid(SOLVER& s, const INDEX dim, const INDEX no_labels, pairwise_potential_pool& pool)
+{
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+  auto& lp = s.GetLP();
+  std::vector<unary*> unaries;
+  for(INDEX i=0; i<dim*dim; ++i) {
+    std::vector<REAL> cost(no_labels);
+    for(auto& x : cost) { x = dist(gen); }
+    unaries.push_back(lp.template add_factor<unary>(cost));
+  }
+  auto potential = pool.truncated_linear(no_labels, 2.0);
+  auto add_edge = [&](const INDEX i, const INDEX j) {
+    auto* p = lp.template add_factor<pairwise>(potential, 0.4);
+    lp.template add_message<left_message>(unaries[i], p);
+    lp.template add_message<right_message>(unaries[j], p);
+    lp.AddFactorRelation(unaries[i], p);
+    lp.AddFactorRelation(p, unaries[j]);
+  };
+  for(INDEX i=0; i<dim; ++i) {
+    for(INDEX j=0; j<dim; ++j) {
+      if(j+1 < dim) { add_edge(i*dim+j, i*dim+j+1); }
+      if(i+1 < dim) { add_edge(i*dim+j, (i+1)*dim+j); }
+    }
+  }
+}
+
+// factors and constructor for building the same kind of model with MRFProblemConstructor, which adds a chain of relations between consecutive unary factors
+struct mrf_unary_factor : public unary_factor {
+  mrf_unary_factor(const INDEX no_labels) : unary_factor(std::vector<REAL>(no_labels, 0.0)) {}
+};
+
+struct mrf_pairwise_factor : public shared_pairwise_factor {
+  mrf_pairwise_factor(const INDEX dim1, const INDEX dim2, shared_pairwise_potential potential) : shared_pairwise_factor(potential, 0.4)
+  {
+    assert(dim1 == this->dim1() && dim2 == this->dim2());
+  }
+};
+
+struct mrf_FMC {
+  constexpr static const char* name = "shared pairwise potentials built by mrf constructor";
+  using unary = FactorContainer<mrf_unary_factor, mrf_FMC, 0>;
+  using pairwise = FactorContainer<mrf_pairwise_factor, mrf_FMC, 1>;
+  using left_message = MessageContainer<shared_pairwise_message<0>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, mrf_FMC, 0>;
+  using right_message = MessageContainer<shared_pairwise_message<1>, 0, 1, message_passing_schedule::left, variableMessageNumber, 1, mrf_FMC, 1>;
+  using FactorList = meta::list<unary, pairwise>;
+  using MessageList = meta::list<left_message, right_message>;
+  using ProblemDecompositionList = meta::list<>;
+};
+
+class mrf_constructor : public MRFProblemConstructor<mrf_FMC, 0, 1, 0, 1> {
+public:
+  using MRFProblemConstructor<mrf_FMC, 0, 1, 0, 1>::MRFProblemConstructor;
+
+  void ConstructUnaryFactor(mrf_unary_factor& u, const std::vector<REAL>& cost) override
+  {
+    for(INDEX i=0; i<cost.size(); ++i) { u[i] = cost[i]; }
+  }
+  void ConstructPairwiseFactor(mrf_pairwise_factor& p, const INDEX leftDim, const INDEX rightDim) override {}
+  shared_pairwise_message<1> ConstructRightUnaryPairwiseMessage(typename mrf_FMC::unary* const right, typename mrf_FMC::pairwise* const p) override { return shared_pairwise_message<1>(); }
+  shared_pairwise_message<0> ConstructLeftUnaryPairwiseMessage(typename mrf_FMC::unary* const left, typename mrf_FMC::pairwise* const p) override { return shared_pairwise_message<0>(); }
+};
+
+template<typename SOLVER>
+void build_mrf_grid(SOLVER& s, const INDEX dim, const INDEX no_labels, pairwise_potential_pool& pool)
+{
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<REAL> dist(0.0, 1.0);
+  std::vector<std::vector<REAL>> unary_costs(dim*dim, std::vector<REAL>(no_labels));
+  for(auto& c : unary_costs) {
+    for(auto& x : c) { x = dist(gen); }
+  }
+  std::vector<std::array<INDEX,2>> edges;
+  for(INDEX i=0; i<dim; ++i) {
+    for(INDEX j=0; j<dim; ++j) {
+      if(j+1 < dim) { edges.push_back({i*dim+j, i*dim+j+1}); }
+      if(i+1 < dim) { edges.push_back({i*dim+j, (i+1)*dim+j}); }
+    }
+  }
+  auto potential = pool.truncated_linear(no_labels, 2.0);
+  mrf_constructor mrf(s);
+  mrf.AddUnaryFactors(dim*dim, [&](const INDEX i) { return unary_costs[i]; });
+  mrf.AddPairwiseFactors(edges, [&](const INDEX p) { return potential; });
+}
+
+// wavefront passes update conflicting factors in the sequential order, hence both schedules give the same lower bound
+int main()
+{
+  const INDEX dim = 25;
+  const INDEX no_labels = 5;
+  pairwise_potential_pool pool;
+
+  for(const std::string repam : {"shared", "residual"}) {
+    Solver<LP<shared_pairwise_FMC>, StandardVisitor> s_seq({"", "--maxIter", "15", "--passSchedule", "sequential", "--reparametrizationType", repam});
+    build_grid(s_seq, dim, no_labels, pool);
+    s_seq.Solve();
+
+    Solver<LP<shared_pairwise_FMC>, StandardVisitor> s_wavefront({"", "--maxIter", "15", "--passSchedule", "wavefront", "--reparametrizationType", repam});
+    build_grid(s_wavefront, dim, no_labels, pool);
+    s_wavefront.Solve();
+
+    const REAL lb_seq = s_seq.GetLP().LowerBound();
+    const REAL lb_wavefront = s_wavefront.GetLP().LowerBound();
+    test(std::abs(lb_seq - lb_wavefront) <= eps*std::max(REAL(1.0), std::abs(lb_seq)));
+  }
+
+  // the unary chain relation of the MRF constructor makes every level of the factor relation DAG O(1) wide. Batches are computed from conflicts between factors, hence they are still wide enough for a parallel pass.
+  for(const std::string repam : {"shared", "residual"}) {
+    Solver<LP<mrf_FMC>, StandardVisitor> s_seq({"", "--maxIter", "15", "--passSchedule", "sequential", "--reparametrizationType", repam});
+    build_mrf_grid(s_seq, dim, no_labels, pool);
+    s_seq.Solve();
+
+    Solver<LP<mrf_FMC>, StandardVisitor> s_wavefront({"", "--maxIter", "15", "--passSchedule", "wavefront", "--reparametrizationType", repam});
+    build_mrf_grid(s_wavefront, dim, no_labels, pool);
+    s_wavefront.Solve();
+
+    auto& lp = s_wavefront.GetLP();
+    test(!lp.get_wavefront_schedule(Direction::forward).sequential);
+    test(!lp.get_wavefront_schedule(Direction::backward).sequential);
+    const REAL lb_seq = s_seq.GetLP().LowerBound();
+    const REAL lb_wavefront = lp.LowerBound();
+    test(std::abs(lb_seq - lb_wavefront) <= eps*std::max(REAL(1.0), std::abs(lb_seq)));
+  }
+}